@@ -2,18 +2,91 @@
  *     word.h
  *     Sophie Zhou (szhou13), Angela Yan (yyan08)
  *     11/19/2024
- *     CS40 HW6 
- * 
- *     Purpose: word.h defines functions that extracts the opcode, register 
- *              values (and value in the case of load val). 
+ *     CS40 HW6
+ *
+ *     Purpose: word.h defines functions that extracts the opcode, register
+ *              values (and value in the case of load val). Every field of
+ *              a UM instruction has a fixed width and position, so each
+ *              function is inline and compiles to one shift and one mask;
+ *              Bitpack_getu() (bitpack.h) stays for fields that are only
+ *              known at run time.
  */
 
+#ifndef WORD_INCLUDED
+#define WORD_INCLUDED
 #include <stdbool.h>
 #include <stdint.h>
 
-int get_opcode(uint32_t word);
-int get_ra(uint32_t word);
-int get_rb(uint32_t word);
-int get_rc(uint32_t word);
-int get_lv_ra(uint32_t word); 
-int get_lv_val(uint32_t word);
\ No newline at end of file
+/* widths and least significant bits of the fields of an instruction */
+#define OPCODE_WIDTH 4
+#define OPCODE_LSB 28
+#define REGISTER_WIDTH 3
+#define RA_LSB 6
+#define RB_LSB 3
+#define RC_LSB 0
+#define LV_RA_LSB 25
+#define LV_VAL_WIDTH 25
+#define LV_VAL_LSB 0
+
+/*
+ * the width-bit field of word at lsb; width must be less than 32. With
+ * constant width and lsb, this is a shift and a mask
+ */
+#define WORD_FIELD(word, width, lsb)                                    \
+        (((uint32_t)(word) >> (lsb)) & (((uint32_t)1 << (width)) - 1))
+
+/********** get_opcode ********
+ *
+ * Returns the opcode of an instruction: its 4 most significant bits
+ ************************/
+static inline int get_opcode(uint32_t word)
+{
+        return WORD_FIELD(word, OPCODE_WIDTH, OPCODE_LSB);
+}
+
+/********** get_ra ********
+ *
+ * Returns register A of an instruction other than load value
+ ************************/
+static inline int get_ra(uint32_t word)
+{
+        return WORD_FIELD(word, REGISTER_WIDTH, RA_LSB);
+}
+
+/********** get_rb ********
+ *
+ * Returns register B of an instruction other than load value
+ ************************/
+static inline int get_rb(uint32_t word)
+{
+        return WORD_FIELD(word, REGISTER_WIDTH, RB_LSB);
+}
+
+/********** get_rc ********
+ *
+ * Returns register C of an instruction other than load value
+ ************************/
+static inline int get_rc(uint32_t word)
+{
+        return WORD_FIELD(word, REGISTER_WIDTH, RC_LSB);
+}
+
+/********** get_lv_ra ********
+ *
+ * Returns register A of a load value instruction
+ ************************/
+static inline int get_lv_ra(uint32_t word)
+{
+        return WORD_FIELD(word, REGISTER_WIDTH, LV_RA_LSB);
+}
+
+/********** get_lv_val ********
+ *
+ * Returns the 25-bit value of a load value instruction
+ ************************/
+static inline int get_lv_val(uint32_t word)
+{
+        return WORD_FIELD(word, LV_VAL_WIDTH, LV_VAL_LSB);
+}
+
+#endif
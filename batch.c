@@ -0,0 +1,338 @@
+/*
+ *     batch.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: batch.c contains the implementation of the batch runner
+ *     defined in batch.h. Jobs are numbered by their line in the list
+ *     file. Each worker thread owns a range of job numbers behind its own
+ *     lock: it takes jobs from the front of its range, and a thief takes
+ *     the back half, so the owner and a thief rarely want the same lock
+ *     for long. Jobs run on run_engine_bounded() with no limit, so an
+ *     invalid opcode fails only its own job.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "assert.h"
+#include "batch.h"
+#include "engine.h"
+#include "io.h"
+#include "loader.h"
+
+/* a worker thread and the jobs queued for it */
+struct worker {
+        pthread_mutex_t lock;           /* guards next and end */
+        uint32_t next;                  /* first job still queued here */
+        uint32_t end;                   /* one past the last */
+        pthread_t thread;
+        unsigned index;
+        struct batch *batch;
+        struct input *in;               /* reused by every job */
+        struct output *out;
+        uint64_t jobs;
+        uint64_t failed;
+        uint64_t instructions;
+        uint64_t steals;
+};
+
+struct batch {
+        const struct shared_program *shared;
+        const struct batch_options *options;
+        char **inputs;                  /* input file of each job */
+        uint32_t count;
+        struct worker *workers;
+        unsigned threads;
+};
+
+/* what take_job() returns once every job has been taken */
+#define NO_JOB UINT32_MAX
+
+/********** read_list ********
+ *
+ * Function that reads the input file names in the list file, one per line;
+ * empty lines are skipped
+ *
+ * Parameters:
+ *      const char *path:     the list file
+ *      uint32_t *count:      set to the number of names
+ *
+ * Return: the names, each and the array malloced
+ ************************/
+static char **read_list(const char *path, uint32_t *count)
+{
+        FILE *file = fopen(path, "r");
+        if (file == NULL) {
+                fprintf(stderr, "um: cannot open batch list %s\n", path);
+                exit(EXIT_FAILURE);
+        }
+        uint32_t capacity = 64;
+        char **names = malloc(capacity * sizeof(char *));
+        assert(names != NULL);
+        *count = 0;
+
+        char *line = NULL;
+        size_t size = 0;
+        ssize_t length;
+        while ((length = getline(&line, &size, file)) >= 0) {
+                while (length > 0 && (line[length - 1] == '\n' ||
+                                      line[length - 1] == '\r')) {
+                        line[--length] = '\0';
+                }
+                if (length == 0) {
+                        continue;
+                }
+                if (*count == capacity) {
+                        capacity *= 2;
+                        names = realloc(names, capacity * sizeof(char *));
+                        assert(names != NULL);
+                }
+                names[*count] = strdup(line);
+                assert(names[*count] != NULL);
+                (*count)++;
+        }
+        free(line);
+        fclose(file);
+        return names;
+}
+
+/********** output_path ********
+ *
+ * Returns the name of the file a job's output goes to, malloced: the
+ * input's name with .out added, in the output directory if there is one
+ ************************/
+static char *output_path(const char *input, const char *dir)
+{
+        const char *base = input;
+        if (dir != NULL) {
+                const char *slash = strrchr(input, '/');
+                base = slash != NULL ? slash + 1 : input;
+        }
+        size_t size = (dir != NULL ? strlen(dir) + 1 : 0) + strlen(base) + 5;
+        char *path = malloc(size);
+        assert(path != NULL);
+        if (dir != NULL) {
+                snprintf(path, size, "%s/%s.out", dir, base);
+        } else {
+                snprintf(path, size, "%s.out", base);
+        }
+        return path;
+}
+
+/********** run_job ********
+ *
+ * Function that runs the program with one job's input, writing its output
+ * to the job's output file, on a fresh segment table that borrows the
+ * shared segment 0
+ *
+ * Parameters:
+ *      struct worker *worker: the worker running the job
+ *      uint32_t job:         the job's number
+ *
+ * Return: void
+ ************************/
+static void run_job(struct worker *worker, uint32_t job)
+{
+        struct batch *batch = worker->batch;
+        const char *input = batch->inputs[job];
+        worker->jobs++;
+
+        int in_fd = open(input, O_RDONLY);
+        if (in_fd < 0) {
+                fprintf(stderr, "um: cannot open batch input %s\n", input);
+                worker->failed++;
+                return;
+        }
+        char *path = output_path(input, batch->options->output_dir);
+        int out_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out_fd < 0) {
+                fprintf(stderr, "um: cannot create batch output %s\n", path);
+                worker->failed++;
+                close(in_fd);
+                free(path);
+                return;
+        }
+
+        struct segment_table *table = make_table(&batch->options->memory);
+        borrow_program(batch->shared, table);
+        uint32_t registers[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        uint32_t counter = 0;
+        input_init(worker->in, in_fd);
+        output_init(worker->out, out_fd, false);
+
+        enum engine_stop stop;
+        worker->instructions += run_engine_bounded(registers, &counter, table,
+                                                   worker->in, worker->out,
+                                                   UINT64_MAX, &stop);
+        output_flush(worker->out);
+        if (stop == ENGINE_INVALID) {
+                fprintf(stderr, "um: %s: invalid opcode at %u\n", input,
+                        counter);
+                worker->failed++;
+        } else if (stop == ENGINE_CAP) {
+                fprintf(stderr, "um: %s: over the segment caps at %u\n",
+                        input, counter);
+                worker->failed++;
+        }
+
+        free_all(table);
+        input_close(worker->in);
+        close(in_fd);
+        close(out_fd);
+        free(path);
+}
+
+/********** take_job ********
+ *
+ * Function that takes the next job for a worker: the first of its own, or
+ * else the first of the back half of the jobs another worker has left,
+ * the rest of which become the worker's own
+ *
+ * Parameters:
+ *      struct worker *worker: the worker
+ *
+ * Return: the job's number, or NO_JOB if no worker has any left
+ ************************/
+static uint32_t take_job(struct worker *worker)
+{
+        uint32_t job = NO_JOB;
+        pthread_mutex_lock(&worker->lock);
+        if (worker->next < worker->end) {
+                job = worker->next++;
+        }
+        pthread_mutex_unlock(&worker->lock);
+        if (job != NO_JOB) {
+                return job;
+        }
+
+        struct batch *batch = worker->batch;
+        for (unsigned i = 1; i < batch->threads; i++) {
+                struct worker *victim = &batch->workers[(worker->index + i) %
+                                                        batch->threads];
+                pthread_mutex_lock(&victim->lock);
+                uint32_t left = victim->end - victim->next;
+                uint32_t first = victim->end - (left + 1) / 2;
+                uint32_t end = victim->end;
+                victim->end = first;
+                pthread_mutex_unlock(&victim->lock);
+                if (left == 0) {
+                        continue;
+                }
+
+                worker->steals++;
+                pthread_mutex_lock(&worker->lock);
+                worker->next = first + 1;
+                worker->end = end;
+                pthread_mutex_unlock(&worker->lock);
+                return first;
+        }
+        return NO_JOB;
+}
+
+/********** work ********
+ *
+ * The body of a worker thread: runs jobs until there are none left
+ ************************/
+static void *work(void *arg)
+{
+        struct worker *worker = arg;
+        uint32_t job;
+        while ((job = take_job(worker)) != NO_JOB) {
+                run_job(worker, job);
+        }
+        return NULL;
+}
+
+/********** run_batch ********
+ *
+ * Function that runs a program once for each input file named in a list
+ *
+ * Parameters:
+ *      const char *program:  the pathname of the .um file
+ *      const char *list:     a file naming one input file per line
+ *      const struct batch_options *options: how to run the jobs
+ *      struct batch_stats *stats: filled in with what the jobs did
+ *
+ * Return: void
+ *
+ * Expects
+ *     the program and list can be read. A job whose input cannot be read
+ *     or whose output cannot be created is reported and counted as
+ *     failed, as is one that reaches an invalid opcode.
+ *
+ * Notes:
+ *     a job that divides by zero or uses an unmapped segment still fails
+ *     the whole UM, as it would run alone
+ ************************/
+void run_batch(const char *program, const char *list,
+               const struct batch_options *options,
+               struct batch_stats *stats)
+{
+        assert(options != NULL && stats != NULL);
+        struct batch batch;
+        batch.options = options;
+        batch.inputs = read_list(list, &batch.count);
+
+        struct segment_table *table = make_table(&options->memory);
+        uint32_t length;
+        uint32_t *words = read_image(program, &length, &table->pool);
+        initialize_zero(words, length, table);
+        struct shared_program *shared = share_program(table);
+        batch.shared = shared;
+
+        batch.threads = options->threads;
+        if (batch.threads == 0) {
+                long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+                batch.threads = cpus > 0 ? cpus : 1;
+        }
+        batch.workers = calloc(batch.threads, sizeof(struct worker));
+        assert(batch.workers != NULL);
+
+        /* an even share of the jobs each, to start with */
+        for (unsigned i = 0; i < batch.threads; i++) {
+                struct worker *worker = &batch.workers[i];
+                pthread_mutex_init(&worker->lock, NULL);
+                worker->next = (uint64_t)batch.count * i / batch.threads;
+                worker->end = (uint64_t)batch.count * (i + 1) /
+                              batch.threads;
+                worker->index = i;
+                worker->batch = &batch;
+                worker->in = malloc(sizeof(struct input));
+                worker->out = malloc(sizeof(struct output));
+                assert(worker->in != NULL && worker->out != NULL);
+        }
+        for (unsigned i = 1; i < batch.threads; i++) {
+                int status = pthread_create(&batch.workers[i].thread, NULL,
+                                            work, &batch.workers[i]);
+                assert(status == 0);
+        }
+        work(&batch.workers[0]);
+
+        memset(stats, 0, sizeof(*stats));
+        stats->threads = batch.threads;
+        for (unsigned i = 0; i < batch.threads; i++) {
+                struct worker *worker = &batch.workers[i];
+                if (i > 0) {
+                        pthread_join(worker->thread, NULL);
+                }
+                stats->jobs += worker->jobs;
+                stats->failed += worker->failed;
+                stats->instructions += worker->instructions;
+                stats->steals += worker->steals;
+                pthread_mutex_destroy(&worker->lock);
+                free(worker->in);
+                free(worker->out);
+        }
+
+        free(batch.workers);
+        free_shared(shared);
+        for (uint32_t i = 0; i < batch.count; i++) {
+                free(batch.inputs[i]);
+        }
+        free(batch.inputs);
+}
@@ -0,0 +1,42 @@
+/*
+ *     batch.h
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: batch.h defines the batch runner, which runs one .um program
+ *              once for each of a list of input files, on a pool of
+ *              threads. The program is read and decoded once; every job's
+ *              segment table borrows that segment 0 (see shared_program in
+ *              memory.h) and copies it only if the job stores to it. Each
+ *              thread starts with an even share of the jobs and, when it
+ *              runs out, steals half of what another thread has left, so
+ *              a few long jobs do not leave the other threads idle.
+ *              Each job's output goes to its own file.
+ */
+
+#ifndef BATCH_INCLUDED
+#define BATCH_INCLUDED
+#include <stdint.h>
+#include "memory.h"
+
+struct batch_options {
+        unsigned threads;               /* 0 for one per online CPU */
+        const char *output_dir;         /* or NULL: next to each input */
+        struct memory_options memory;   /* for every job's segments */
+};
+
+struct batch_stats {
+        unsigned threads;               /* threads the jobs ran on */
+        uint64_t jobs;                  /* jobs run */
+        uint64_t failed;                /* jobs that could not run or
+                                           stopped at an invalid opcode */
+        uint64_t instructions;          /* executed by all jobs */
+        uint64_t steals;                /* times a thread stole jobs */
+};
+
+void run_batch(const char *program, const char *list,
+               const struct batch_options *options,
+               struct batch_stats *stats);
+
+#endif
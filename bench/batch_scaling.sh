@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+#     batch_scaling.sh
+#
+#     Runs um --batch on the same list of jobs with 1 to MAX threads and
+#     reports the wall time of each and its speedup over one thread. Each
+#     job runs the arith workload for ITERATIONS iterations on an input of
+#     its own, so the jobs are all CPU-bound and equally long. Speedup
+#     should grow with the threads up to the number of cores and flatten
+#     after.
+#
+#     Usage: UM=path/to/um bench/batch_scaling.sh [MAX [JOBS [ITERATIONS]]]
+#            (defaults: one thread per online CPU, 64 jobs, 1000000)
+#
+
+UM=${UM:-./um}
+CC=${CC:-cc}
+MAX=${1:-$(getconf _NPROCESSORS_ONLN)}
+JOBS=${2:-64}
+ITERATIONS=${3:-1000000}
+BENCH=$(dirname "$0")
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+$CC -O2 -o "$WORK/umgen" "$BENCH/umgen.c" || exit 1
+"$WORK/umgen" arith "$ITERATIONS" 1 > "$WORK/arith.um"
+mkdir "$WORK/in" "$WORK/out"
+job=1
+while [ "$job" -le "$JOBS" ]; do
+        echo "$job" > "$WORK/in/$job"
+        echo "$WORK/in/$job"
+        job=$((job + 1))
+done > "$WORK/list"
+
+printf "%8s %10s %8s %8s\n" threads wall_ms speedup steals
+threads=1
+while [ "$threads" -le "$MAX" ]; do
+        start=$(date +%s%N)
+        steals=$("$UM" --stats --batch "$WORK/list" --threads "$threads" \
+                        --output-dir "$WORK/out" "$WORK/arith.um" 2>&1 |
+                 sed -n 's/^batch_steals=//p')
+        end=$(date +%s%N)
+        ms=$(((end - start) / 1000000))
+        [ "$threads" -eq 1 ] && one=$ms
+        awk -v t="$threads" -v ms="$ms" -v one="$one" -v s="$steals" \
+                'BEGIN { printf "%8d %10d %8.2f %8d\n",
+                         t, ms, (ms > 0 ? one / ms : 0), s }'
+        threads=$((threads + 1))
+done
@@ -0,0 +1,147 @@
+/*
+ *     decode.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: decode.c measures what it costs to decode one instruction
+ *     into its fields, the way decode_instruction() in memory.c does it,
+ *     two ways: with the out-of-line accessors Word.c used to have, each a
+ *     call to Bitpack_getu(), and with the inline extractors in Word.h.
+ *     The words are random, so about 1 in 16 is a load value, as in a real
+ *     decode of arbitrary data.
+ *
+ *     Usage (from the top of the repository, with Hanson's CII):
+ *
+ *      cc -O2 -I. -I/comp/40/build/include bench/decode.c bitpack.c \
+ *              -L/comp/40/build/lib -lcii40 -o decode && ./decode [N]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "bitpack.h"
+#include "Word.h"
+
+/* the decoded fields of one instruction, summed so none can be dropped */
+struct fields {
+        uint64_t opcode, ra, rb, rc, value;
+};
+
+/* the accessors of the old Word.c, one Bitpack_getu() call each */
+#ifdef __GNUC__
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+static NOINLINE int old_get_opcode(uint32_t word)
+{
+        return Bitpack_getu(word, 4, 28);
+}
+
+static NOINLINE int old_get_ra(uint32_t word)
+{
+        return Bitpack_getu(word, 3, 6);
+}
+
+static NOINLINE int old_get_rb(uint32_t word)
+{
+        return Bitpack_getu(word, 3, 3);
+}
+
+static NOINLINE int old_get_rc(uint32_t word)
+{
+        return Bitpack_getu(word, 3, 0);
+}
+
+static NOINLINE int old_get_lv_ra(uint32_t word)
+{
+        return Bitpack_getu(word, 3, 25);
+}
+
+static NOINLINE int old_get_lv_val(uint32_t word)
+{
+        return Bitpack_getu(word, 25, 0);
+}
+
+/*
+ * DECODE defines a function that decodes every word with the given
+ * accessors, in the same shape as decode_instruction() in memory.c
+ */
+#define DECODE(name, OPCODE, RA, RB, RC, LV_RA, LV_VAL)                 \
+static void name(const uint32_t *words, size_t n, struct fields *sum)   \
+{                                                                       \
+        for (size_t i = 0; i < n; i++) {                                \
+                uint32_t word = words[i];                               \
+                unsigned op = OPCODE(word);                             \
+                sum->opcode += op;                                      \
+                if (op == 13) {                                         \
+                        sum->ra += LV_RA(word);                         \
+                        sum->value += LV_VAL(word);                     \
+                } else {                                                \
+                        sum->ra += RA(word);                            \
+                        sum->rb += RB(word);                            \
+                        sum->rc += RC(word);                            \
+                }                                                       \
+        }                                                               \
+}
+
+DECODE(decode_bitpack, old_get_opcode, old_get_ra, old_get_rb, old_get_rc,
+       old_get_lv_ra, old_get_lv_val)
+DECODE(decode_inline, get_opcode, get_ra, get_rb, get_rc, get_lv_ra,
+       get_lv_val)
+
+/********** time_ns ********
+ *
+ * Returns the nanoseconds decode takes to decode every word, and adds the
+ * fields to sum
+ ************************/
+static double time_ns(void (*decode)(const uint32_t *, size_t,
+                                     struct fields *),
+                      const uint32_t *words, size_t n, struct fields *sum)
+{
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        decode(words, n, sum);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        return (end.tv_sec - start.tv_sec) * 1e9 +
+               (end.tv_nsec - start.tv_nsec);
+}
+
+int main(int argc, char *argv[])
+{
+        size_t n = argc > 1 ? strtoul(argv[1], NULL, 0) : 1 << 24;
+        uint32_t *words = malloc(n * sizeof(uint32_t));
+        if (words == NULL || n == 0) {
+                fprintf(stderr, "usage: %s [N]\n", argv[0]);
+                return 1;
+        }
+        uint32_t x = 2463534242u; /* xorshift32 */
+        for (size_t i = 0; i < n; i++) {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                words[i] = x;
+        }
+
+        struct fields old = { 0, 0, 0, 0, 0 };
+        struct fields new = { 0, 0, 0, 0, 0 };
+        decode_bitpack(words, n, &old); /* warm up, and check */
+        decode_inline(words, n, &new);
+        if (old.opcode != new.opcode || old.ra != new.ra ||
+            old.rb != new.rb || old.rc != new.rc || old.value != new.value) {
+                fprintf(stderr, "%s: the decoders disagree\n", argv[0]);
+                return 1;
+        }
+
+        double bitpack = time_ns(decode_bitpack, words, n, &old);
+        double inlined = time_ns(decode_inline, words, n, &new);
+        printf("%-8s %14s\n", "decoder", "ns_per_word");
+        printf("%-8s %14.2f\n", "bitpack", bitpack / n);
+        printf("%-8s %14.2f\n", "inline", inlined / n);
+        printf("speedup  %14.1fx\n", bitpack / inlined);
+        free(words);
+        return 0;
+}
@@ -0,0 +1,45 @@
+#!/bin/sh
+#
+#     hugepages.sh
+#
+#     Runs the random workload (loads and stores at random indices of one
+#     segment) at growing segment sizes, once on small pages and once with
+#     --hugepages, and reports the time per access of each and how much
+#     memory the kernel backed with huge pages. Small segments fit the TLB
+#     either way; the gap should open up once a segment spans more memory
+#     than the TLB covers with 4KB pages. Huge pages depend on the kernel:
+#     /sys/kernel/mm/transparent_hugepage/enabled must be "always" or
+#     "madvise", or the second column only measures the alignment.
+#
+#     Usage: UM=path/to/um bench/hugepages.sh [ITERATIONS]
+#            (default 1000000, 16 accesses each)
+#
+
+UM=${UM:-./um}
+CC=${CC:-cc}
+ITERATIONS=${1:-1000000}
+BENCH=$(dirname "$0")
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+$CC -O2 -o "$WORK/umgen" "$BENCH/umgen.c" || exit 1
+
+# prints run_ns and anon_huge_kb from a run with the given options
+run() {
+        "$UM" --stats "$@" "$WORK/random.um" 2>&1 >/dev/null |
+                sed -n 's/^run_ns=//p; s/^anon_huge_kb=//p' | tr '\n' ' '
+}
+
+printf "%10s %12s %12s %8s %10s\n" words ns_small ns_huge speedup huge_kb
+for size in 65536 1048576 4194304 16777216 67108864; do
+        "$WORK/umgen" random "$ITERATIONS" "$size" > "$WORK/random.um"
+        set -- $(run)
+        small=$1
+        set -- $(run --hugepages)
+        huge=$1
+        kb=$2
+        awk -v s="$size" -v n="$((ITERATIONS * 16))" -v a="$small" \
+                -v b="$huge" -v kb="$kb" \
+                'BEGIN { printf "%10d %12.2f %12.2f %8.2f %10d\n",
+                         s, a / n, b / n, (b > 0 ? a / b : 0), kb }'
+done
@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+#     id_reuse.sh
+#
+#     Runs the phases workload (fill a table of slots with segments, unmap
+#     them all in a scattered order, map a quarter again) at growing sizes
+#     and reports the time per map or unmap and how densely the segment
+#     ids still mapped at halt fill the table: live segments over the span
+#     up to the highest mapped id. Lowest-id-first reuse keeps that at
+#     100%; most-recently-unmapped-first would leave the quarter scattered
+#     over the whole table. The last line times the churn workload, which
+#     maps and unmaps three small segments over and over.
+#
+#     Usage: UM=path/to/um bench/id_reuse.sh [ITERATIONS]
+#            (default 8)
+#
+
+UM=${UM:-./um}
+CC=${CC:-cc}
+ITERATIONS=${1:-8}
+BENCH=$(dirname "$0")
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+$CC -O2 -o "$WORK/umgen" "$BENCH/umgen.c" || exit 1
+
+# prints run_ns, segments_live, segment_maps, segment_unmaps and
+# segment_id_span, in the order --stats prints them, from a run of the
+# given program
+run() {
+        "$UM" --stats "$1" 2>&1 >/dev/null |
+                sed -n 's/^run_ns=//p; s/^segment_maps=//p;
+                        s/^segment_unmaps=//p; s/^segments_live=//p;
+                        s/^segment_id_span=//p' | tr '\n' ' '
+}
+
+printf "%10s %12s %10s %10s %8s\n" slots ns_per_op live span density
+for size in 4096 65536 1048576; do
+        "$WORK/umgen" phases "$ITERATIONS" "$size" > "$WORK/phases.um"
+        set -- $(run "$WORK/phases.um")
+        awk -v s="$size" -v ns="$1" -v live="$2" -v ops="$(($3 + $4))" \
+                -v span="$5" \
+                'BEGIN { printf "%10d %12.1f %10d %10d %7.1f%%\n",
+                         s, ns / ops, live, span, 100 * live / span }'
+done
+
+"$WORK/umgen" churn 2000000 16 > "$WORK/churn.um"
+set -- $(run "$WORK/churn.um")
+awk -v ns="$1" -v ops="$(($3 + $4))" \
+        'BEGIN { printf "churn: %.1f ns per map or unmap\n", ns / ops }'
@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+#     jump_scaling.sh
+#
+#     Runs the jump workload (repeated load program from one code segment)
+#     at growing code segment sizes. Each size is run with N and 10N jumps,
+#     so the one-time cost of building the segment cancels out of the
+#     per-jump cost. With copy-on-write load program, ns_per_jump should
+#     stay flat as the segment grows.
+#
+#     Usage: UM=path/to/um bench/jump_scaling.sh [N]
+#
+
+UM=${UM:-./um}
+CC=${CC:-cc}
+ITERATIONS=${1:-2000}
+BENCH=$(dirname "$0")
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+$CC -O2 -o "$WORK/umgen" "$BENCH/umgen.c" || exit 1
+
+run_ns() {
+        "$WORK/umgen" jump "$1" "$2" > "$WORK/jump.um"
+        "$UM" --stats "$WORK/jump.um" 2>&1 >/dev/null |
+                sed -n 's/^run_ns=//p'
+}
+
+printf "%10s %12s %12s %12s\n" words run_ms_N run_ms_10N ns_per_jump
+for size in 1000 10000 100000 1000000; do
+        short=$(run_ns "$ITERATIONS" "$size")
+        long=$(run_ns $((ITERATIONS * 10)) "$size")
+        awk -v s="$size" -v n="$ITERATIONS" -v a="$short" -v b="$long" \
+                'BEGIN { printf "%10d %12.2f %12.2f %12.1f\n",
+                         s, a / 1e6, b / 1e6, (b - a) / (9 * n) }'
+done
@@ -0,0 +1,35 @@
+#!/bin/sh
+#
+#     mmap_threshold.sh
+#
+#     Runs the sparse workload (map a segment, touch 16 of its words, unmap
+#     it) at growing segment sizes, once with every segment zeroed by the
+#     allocator (--mmap-threshold 0) and once with every segment given its
+#     own anonymous mapping (--mmap-threshold 1). The crossover between the
+#     two columns is where the default threshold belongs.
+#
+#     Usage: UM=path/to/um bench/mmap_threshold.sh [N]
+#
+
+UM=${UM:-./um}
+CC=${CC:-cc}
+ITERATIONS=${1:-1000}
+BENCH=$(dirname "$0")
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+$CC -O2 -o "$WORK/umgen" "$BENCH/umgen.c" || exit 1
+
+run_ns() {
+        "$UM" --stats --mmap-threshold "$1" "$WORK/sparse.um" 2>&1 \
+                >/dev/null | sed -n 's/^run_ns=//p'
+}
+
+printf "%10s %14s %14s\n" words ns_per_zeroed ns_per_mapped
+for size in 4096 16384 65536 262144 1048576 4194304; do
+        "$WORK/umgen" sparse "$ITERATIONS" "$size" > "$WORK/sparse.um"
+        zeroed=$(run_ns 0)
+        mapped=$(run_ns 1)
+        awk -v s="$size" -v n="$ITERATIONS" -v a="$zeroed" -v b="$mapped" \
+                'BEGIN { printf "%10d %14.0f %14.0f\n", s, a / n, b / n }'
+done
@@ -0,0 +1,145 @@
+#!/bin/sh
+#
+#     run.sh
+#
+#     Runs the UM on one synthetic program of each workload shape umgen
+#     makes, and reports for each the instructions executed, MIPS, wall
+#     time, run time (first instruction to halt), peak resident set size
+#     and segment allocations (pooled, malloced and mapped).
+#
+#     --save FILE writes the results to FILE as a baseline. --baseline FILE
+#     compares them with one: a shape whose MIPS fell, or whose wall time,
+#     peak RSS or allocations grew, by more than --threshold percent
+#     (default 10) is flagged as a regression, and the script exits with
+#     status 1 (peak RSS must also have grown by over 1MB). A baseline
+#     only means something on the machine that made it; bench/baseline.txt
+#     is the stored one. --scale multiplies every iteration count, and
+#     each program is run --repeat times (default 3), keeping the fastest
+#     time. Anything after -- is passed to the UM, e.g. -- --jit.
+#
+#     Usage: UM=path/to/um bench/run.sh [--scale N] [--repeat N]
+#                [--save FILE] [--baseline FILE] [--threshold PERCENT]
+#                [-- um options]
+#
+
+UM=${UM:-./um}
+CC=${CC:-cc}
+BENCH=$(dirname "$0")
+SCALE=1
+REPEAT=3
+SAVE=
+BASELINE=
+THRESHOLD=10
+
+while [ $# -gt 0 ]; do
+        case "$1" in
+        --scale) SCALE=$2; shift 2 ;;
+        --repeat) REPEAT=$2; shift 2 ;;
+        --save) SAVE=$2; shift 2 ;;
+        --baseline) BASELINE=$2; shift 2 ;;
+        --threshold) THRESHOLD=$2; shift 2 ;;
+        --) shift; break ;;
+        *) echo "usage: $0 [--scale N] [--repeat N] [--save FILE]" \
+                "[--baseline FILE] [--threshold PERCENT] [-- um options]" >&2
+           exit 2 ;;
+        esac
+done
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+$CC -O2 -o "$WORK/umgen" "$BENCH/umgen.c" || exit 1
+
+# shape, iterations (before --scale) and size of each workload
+WORKLOADS="arith 2000000 16
+loadstore 500000 65536
+churn 1000000 64
+branch 200000 64
+jump 6000000 1000
+io 2000000 8
+sparse 2000 1048576"
+
+# stat KEY: the value of KEY in the --stats output of the last run
+stat() {
+        sed -n "s/^$1=//p" "$WORK/stats"
+}
+
+RESULTS="$WORK/results"
+echo "# shape instructions mips wall_ms run_ms max_rss_kb allocations" \
+        > "$RESULTS"
+echo "$WORKLOADS" | while read -r shape iterations size; do
+        iterations=$((iterations * SCALE))
+        "$WORK/umgen" "$shape" "$iterations" "$size" > "$WORK/$shape.um"
+        head -c "$iterations" /dev/zero > "$WORK/input"
+        best_wall=
+        best_run=
+        repeat=0
+        while [ $repeat -lt "$REPEAT" ]; do
+                start=$(date +%s%N)
+                "$UM" --stats "$@" "$WORK/$shape.um" < "$WORK/input" \
+                        > /dev/null 2> "$WORK/stats" || exit 1
+                end=$(date +%s%N)
+                if [ -z "$best_wall" ] || [ $((end - start)) -lt "$best_wall" ]
+                then
+                        best_wall=$((end - start))
+                fi
+                if [ -z "$best_run" ] || [ "$(stat run_ns)" -lt "$best_run" ]
+                then
+                        best_run=$(stat run_ns)
+                fi
+                repeat=$((repeat + 1))
+        done
+        count=$(stat instructions)
+        allocations=$(($(stat pool_hits) + $(stat pool_misses) +
+                       $(stat pool_large) + $(stat pool_mapped)))
+        awk -v shape="$shape" -v count="$count" -v run="$best_run" \
+            -v wall="$best_wall" -v rss="$(stat max_rss_kb)" \
+            -v allocations="$allocations" 'BEGIN {
+                printf "%s %d %.2f %.1f %.1f %d %d\n", shape, count,
+                       (run > 0 ? count * 1000 / run : 0), wall / 1e6,
+                       run / 1e6, rss, allocations
+        }' >> "$RESULTS"
+done || exit 1
+
+awk '/^#/ { printf "%-10s %12s %9s %9s %9s %10s %11s\n", "shape",
+            "instructions", "mips", "wall_ms", "run_ms", "max_rss_kb",
+            "allocations"; next }
+     { printf "%-10s %12d %9.2f %9.1f %9.1f %10d %11d\n",
+              $1, $2, $3, $4, $5, $6, $7 }' "$RESULTS"
+
+if [ -n "$SAVE" ]; then
+        cp "$RESULTS" "$SAVE"
+fi
+if [ -z "$BASELINE" ]; then
+        exit 0
+fi
+
+# a regression is a change for the worse of more than THRESHOLD percent
+awk -v t="$THRESHOLD" '
+        /^#/ { next }
+        FNR == NR { mips[$1] = $3; wall[$1] = $4; rss[$1] = $6;
+                    allocations[$1] = $7; count[$1] = $2; next }
+        !($1 in mips) { print $1 ": not in the baseline"; next }
+        {
+                if ($2 != count[$1]) {
+                        print $1 ": ran " $2 " instructions, baseline " \
+                              count[$1]
+                }
+                worse($1, "mips", mips[$1], $3, -1, 0)
+                worse($1, "wall_ms", wall[$1], $4, 1, 0)
+                worse($1, "max_rss_kb", rss[$1], $6, 1, 1024)
+                worse($1, "allocations", allocations[$1], $7, 1, 0)
+        }
+        # slack: a change of at most this much is never a regression
+        function worse(shape, what, old, new, sign, slack,    change) {
+                if (old == 0 || sign * (new - old) <= slack) {
+                        return
+                }
+                change = sign * (new - old) * 100 / old
+                if (change > t) {
+                        printf "REGRESSION %s: %s %s -> %s (%+.1f%%)\n",
+                               shape, what, old, new, (new - old) * 100 / old
+                        failed = 1
+                }
+        }
+        END { exit failed }
+' "$BASELINE" "$RESULTS"
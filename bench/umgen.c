@@ -0,0 +1,509 @@
+/*
+ *     umgen.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: umgen writes synthetic .um benchmark programs to stdout. Each
+ *     workload shape stresses one part of the UM; the iteration count and
+ *     the size parameter let a benchmark script scale it. Iterations must be
+ *     at least 1.
+ *
+ *     Usage: umgen <shape> <iterations> <size> > program.um
+ *
+ *     Shapes:
+ *      arith       runs a loop body of <size> additions, multiplications,
+ *                  divisions and NANDs <iterations> times
+ *      loadstore   maps a segment of <size> words (rounded up to a power
+ *                  of two) and walks it <iterations> times 16 words at a
+ *                  time, loading, adding to and storing back each word
+ *      churn       maps three <size>-word segments, stores to each and
+ *                  unmaps them again, in a different order, <iterations>
+ *                  times
+ *      branch      jumps around segment 0 with load program (from
+ *                  segment 0, $r[B] = 0) every few instructions,
+ *                  <iterations> times through a loop of <size> jumps
+ *      io          <iterations> times, inputs one byte and outputs <size>
+ *                  bytes
+ *      jump        loads a <size>-word code segment into segment 0 and
+ *                  then long-jumps into it again (load program with a
+ *                  nonzero $r[B]) <iterations> times
+ *      sparse      maps a <size>-word segment, stores to 16 words spread
+ *                  evenly across it and unmaps it again, <iterations> times
+ *      random      maps a segment of <size> words (rounded up to a power
+ *                  of two, at most 2^30) and <iterations> times loads,
+ *                  adds to and stores back 16 words at indices drawn from
+ *                  a linear congruential generator, so nearly every
+ *                  access of a large segment lands on a different page
+ *      phases      keeps a table of <size> slots (rounded up to a power of
+ *                  two, between 16 and 2^24) and <iterations> times maps a
+ *                  16-word segment into every slot, unmaps them all in a
+ *                  scattered order and maps a quarter again, leaving the
+ *                  last quarter mapped at halt; how spread out those ids
+ *                  are shows how an id allocator reuses ids
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* a program being assembled */
+struct program {
+        uint32_t *words;
+        size_t length;
+        size_t capacity;
+};
+
+/********** emit ********
+ *
+ * Appends one word to a program and returns its index
+ ************************/
+static size_t emit(struct program *p, uint32_t word)
+{
+        if (p->length == p->capacity) {
+                p->capacity = p->capacity ? 2 * p->capacity : 64;
+                p->words = realloc(p->words, p->capacity * sizeof(uint32_t));
+                if (p->words == NULL) {
+                        perror("umgen");
+                        exit(1);
+                }
+        }
+        p->words[p->length] = word;
+        return p->length++;
+}
+
+/* three-register instruction */
+static uint32_t op(unsigned opcode, unsigned a, unsigned b, unsigned c)
+{
+        return (uint32_t)opcode << 28 | a << 6 | b << 3 | c;
+}
+
+/* load value; value must fit in 25 bits */
+static uint32_t loadval(unsigned a, uint32_t value)
+{
+        return (uint32_t)13 << 28 | a << 25 | value;
+}
+
+/********** load_constant ********
+ *
+ * Emits instructions that put any 32 bit value in register r, using tmp as
+ * scratch when the value does not fit in a load value
+ ************************/
+static void load_constant(struct program *p, unsigned r, uint32_t value,
+                          unsigned tmp)
+{
+        if (value < (1 << 25)) {
+                emit(p, loadval(r, value));
+                return;
+        }
+        emit(p, loadval(r, value >> 16));
+        emit(p, loadval(tmp, 1 << 16));
+        emit(p, op(4, r, r, tmp));
+        emit(p, loadval(tmp, value & 0xFFFF));
+        emit(p, op(3, r, r, tmp));
+}
+
+/********** store_program ********
+ *
+ * Emits instructions that map a segment of size words, store the words of
+ * code into it, and leave its id in register id. Registers tmp1 and tmp2
+ * are clobbered. code must be shorter than 2^25 words.
+ ************************/
+static void store_program(struct program *p, const struct program *code,
+                          uint32_t size, unsigned id, unsigned tmp1,
+                          unsigned tmp2)
+{
+        load_constant(p, tmp1, size, tmp2);
+        emit(p, op(8, 0, id, tmp1));
+        for (size_t i = 0; i < code->length; i++) {
+                if (code->words[i] == 0) { /* segments start out zeroed */
+                        continue;
+                }
+                load_constant(p, tmp1, code->words[i], tmp2);
+                emit(p, loadval(tmp2, i));
+                emit(p, op(2, id, tmp2, tmp1));
+        }
+}
+
+/********** loop_back ********
+ *
+ * Emits the end of a loop in segment 0: r1 counts down, and while it is
+ * not zero a load program from segment 0 jumps back to top; then the
+ * program halts. r0 must be zero; r4 and r5 are clobbered.
+ ************************/
+static void loop_back(struct program *p, size_t top)
+{
+        emit(p, op(6, 5, 0, 0));                /* r5 := ~0 */
+        emit(p, op(3, 1, 1, 5));                /* r1 := r1 - 1 */
+        size_t end = emit(p, loadval(5, 0));
+        emit(p, loadval(4, top));
+        emit(p, op(0, 5, 4, 1));                /* loop while r1 != 0 */
+        emit(p, op(12, 0, 0, 5));
+        p->words[end] |= emit(p, op(7, 0, 0, 0));
+}
+
+/********** count_down ********
+ *
+ * Emits the end of an inner loop: register r counts down, and while it is
+ * not zero a load program from segment 0 jumps back to top. r0 must be
+ * zero; r4 and r5 are clobbered.
+ ************************/
+static void count_down(struct program *p, unsigned r, size_t top)
+{
+        emit(p, op(6, 4, 0, 0));                /* r4 := ~0 */
+        emit(p, op(3, r, r, 4));                /* r := r - 1 */
+        emit(p, loadval(4, p->length + 4));     /* after the load program */
+        emit(p, loadval(5, top));
+        emit(p, op(0, 4, 5, r));                /* loop while r != 0 */
+        emit(p, op(12, 0, 0, 4));
+}
+
+/********** shape_arith ********
+ *
+ * r1 counts iterations down; r2, r3 and r6 are the operands, seeded so
+ * that no division is by zero (r6 stays odd)
+ ************************/
+static void shape_arith(struct program *p, uint32_t iterations,
+                        uint32_t size)
+{
+        load_constant(p, 1, iterations, 4);
+        emit(p, loadval(2, 12345));
+        emit(p, loadval(3, 678));
+        emit(p, loadval(6, 3));
+        emit(p, loadval(7, 2));
+
+        size_t top = emit(p, op(3, 2, 2, 1));   /* r2 := r2 + r1 */
+        for (uint32_t i = 1; i < size; i++) {
+                switch (i % 4) {
+                case 0:
+                        emit(p, op(3, 2, 2, 3)); /* r2 := r2 + r3 */
+                        break;
+                case 1:
+                        emit(p, op(4, 3, 3, 6)); /* r3 := r3 * r6 */
+                        break;
+                case 2:
+                        emit(p, op(5, 2, 2, 6)); /* r2 := r2 / r6 */
+                        break;
+                default:
+                        emit(p, op(6, 3, 3, 2)); /* r3 := ~(r3 & r2) */
+                        break;
+                }
+        }
+        emit(p, op(3, 6, 6, 7));                /* r6 := r6 + 2 */
+        loop_back(p, top);
+}
+
+/********** shape_loadstore ********
+ *
+ * r1 counts iterations down, r2 holds the index mask, r3 is 1, r5 the
+ * index (which starts each iteration at 16 * r1, masked) and r7 the id of
+ * the segment; r6 is scratch
+ ************************/
+static void shape_loadstore(struct program *p, uint32_t iterations,
+                            uint32_t size)
+{
+        uint32_t words = 16;
+        while (words < size && words < ((uint32_t)1 << 30)) {
+                words *= 2;
+        }
+        load_constant(p, 2, words, 4);
+        emit(p, op(8, 0, 7, 2));                /* r7 := map r2 words */
+        emit(p, op(6, 3, 0, 0));                /* r3 := ~0 */
+        emit(p, op(3, 2, 2, 3));                /* r2 := words - 1 */
+        emit(p, loadval(3, 1));
+        load_constant(p, 1, iterations, 4);
+
+        size_t top = emit(p, loadval(6, 16));
+        emit(p, op(4, 5, 1, 6));                /* r5 := r1 * 16 */
+        emit(p, op(6, 5, 5, 2));                /* r5 := r5 & mask */
+        emit(p, op(6, 5, 5, 5));
+        for (int i = 0; i < 16; i++) {
+                emit(p, op(1, 6, 7, 5));        /* r6 := m[r7][r5] */
+                emit(p, op(3, 6, 6, 1));        /* r6 := r6 + r1 */
+                emit(p, op(2, 7, 5, 6));        /* m[r7][r5] := r6 */
+                emit(p, op(3, 5, 5, 3));        /* r5 := r5 + 1 */
+                emit(p, op(6, 5, 5, 2));        /* r5 := r5 & mask */
+                emit(p, op(6, 5, 5, 5));
+        }
+        loop_back(p, top);
+}
+
+/********** shape_churn ********
+ *
+ * r1 counts iterations down, r2 holds the segment size and r3 the value
+ * stored; the segments' ids are in r5, r6 and r7
+ ************************/
+static void shape_churn(struct program *p, uint32_t iterations,
+                        uint32_t size)
+{
+        if (size == 0) {
+                size = 1;
+        }
+        load_constant(p, 2, size, 4);
+        load_constant(p, 1, iterations, 4);
+
+        size_t top = emit(p, op(8, 0, 5, 2));   /* map r5, r6, r7 */
+        emit(p, op(8, 0, 6, 2));
+        emit(p, op(8, 0, 7, 2));
+        emit(p, op(2, 5, 0, 1));                /* m[rN][0] := r1 */
+        emit(p, op(2, 6, 0, 1));
+        emit(p, op(2, 7, 0, 1));
+        emit(p, op(1, 3, 6, 0));                /* r3 := m[r6][0] */
+        emit(p, op(9, 0, 0, 6));                /* unmap r6, r5, r7 */
+        emit(p, op(9, 0, 0, 5));
+        emit(p, op(9, 0, 0, 7));
+        loop_back(p, top);
+}
+
+/********** shape_branch ********
+ *
+ * r1 counts iterations down and r2 counts jumps. Every hop is a load
+ * value of the next hop's address followed by a load program from segment
+ * 0; the hops are laid out backwards, so each one jumps over the others.
+ ************************/
+static void shape_branch(struct program *p, uint32_t iterations,
+                         uint32_t size)
+{
+        if (size == 0) {
+                size = 1;
+        }
+        load_constant(p, 1, iterations, 4);
+        emit(p, loadval(3, 1));
+        size_t first = emit(p, loadval(6, 0));
+        emit(p, op(12, 0, 0, 6));
+
+        /* hop i sits at hops + 3 * (size - 1 - i) */
+        size_t hops = p->length;
+        for (uint32_t i = 0; i < size; i++) {
+                emit(p, op(3, 2, 2, 3));        /* r2 := r2 + 1 */
+                emit(p, loadval(6, 0));
+                emit(p, op(12, 0, 0, 6));
+        }
+        size_t bottom = p->length;
+        for (uint32_t i = 0; i < size; i++) {
+                size_t at = hops + 3 * (size - 1 - i);
+                size_t next = i + 1 < size ? at - 3 : bottom;
+                p->words[at + 1] |= next;
+        }
+        p->words[first] |= hops + 3 * (size - 1);
+        loop_back(p, first);
+}
+
+/********** shape_io ********
+ *
+ * r1 counts iterations down and r2 holds the byte input; r7 is the byte
+ * output <size> times, which is '.' once the input has ended
+ ************************/
+static void shape_io(struct program *p, uint32_t iterations, uint32_t size)
+{
+        load_constant(p, 1, iterations, 4);
+
+        size_t top = emit(p, op(11, 0, 0, 2));  /* r2 := input */
+        emit(p, op(6, 6, 2, 2));                /* r6 := ~r2, 0 at end */
+        emit(p, loadval(7, '.'));
+        emit(p, op(0, 7, 2, 6));                /* r7 := r2 unless so */
+        for (uint32_t i = 0; i < size; i++) {
+                emit(p, op(10, 0, 0, 7));
+        }
+        loop_back(p, top);
+}
+
+/********** shape_jump ********
+ *
+ * r1 counts iterations down and r7 holds the id of the code segment. Every
+ * iteration runs 8 instructions and ends in a load program from r7 (or
+ * from segment 0, to reach the halt, once r1 is zero).
+ ************************/
+static void shape_jump(struct program *p, uint32_t iterations, uint32_t size)
+{
+        struct program code = { NULL, 0, 0 };
+        emit(&code, op(6, 5, 0, 0));            /* r5 := ~0 */
+        emit(&code, op(3, 1, 1, 5));            /* r1 := r1 - 1 */
+        size_t end = emit(&code, loadval(5, 0));
+        emit(&code, loadval(4, 0));
+        emit(&code, op(0, 5, 4, 1));            /* loop while r1 != 0 */
+        emit(&code, loadval(3, 0));
+        emit(&code, op(0, 3, 7, 1));
+        emit(&code, op(12, 0, 3, 5));
+        code.words[end] |= emit(&code, op(7, 0, 0, 0));
+        if (size < code.length) {
+                size = code.length;
+        }
+
+        store_program(p, &code, size, 7, 2, 3);
+        load_constant(p, 1, iterations, 2);
+        emit(p, op(3, 3, 7, 0));
+        emit(p, loadval(4, 0));
+        emit(p, op(12, 0, 3, 4));
+        free(code.words);
+}
+
+/********** shape_sparse ********
+ *
+ * r0 stays zero, r1 counts iterations down, r2 holds the segment size, r3
+ * the distance between touched words and r7 the id of the segment. The loop
+ * jumps back to its top with a load program from segment 0.
+ ************************/
+static void shape_sparse(struct program *p, uint32_t iterations,
+                         uint32_t size)
+{
+        uint32_t touches = size < 16 ? size : 16;
+        uint32_t stride = size < 16 ? 1 : size / 16;
+        load_constant(p, 2, size, 4);
+        load_constant(p, 1, iterations, 4);
+        load_constant(p, 3, stride, 4);
+
+        size_t top = emit(p, op(8, 0, 7, 2));   /* r7 := map r2 words */
+        emit(p, loadval(5, 0));
+        for (uint32_t i = 0; i < touches; i++) {
+                emit(p, op(2, 7, 5, 1));        /* m[r7][r5] := r1 */
+                emit(p, op(3, 5, 5, 3));        /* r5 := r5 + stride */
+        }
+        emit(p, op(9, 0, 0, 7));                /* unmap r7 */
+        loop_back(p, top);
+}
+
+/********** shape_random ********
+ *
+ * r0 stays zero, r1 counts iterations down, r2 holds 2^32 / words, so that
+ * dividing by it leaves the top bits of the generator's state, r3 is that
+ * state, r6 the index and r7 the id of the segment; r4 is scratch
+ ************************/
+static void shape_random(struct program *p, uint32_t iterations,
+                         uint32_t size)
+{
+        unsigned bits = 4;
+        while (((uint32_t)1 << bits) < size && bits < 30) {
+                bits++;
+        }
+        load_constant(p, 2, (uint32_t)1 << bits, 4);
+        emit(p, op(8, 0, 7, 2));                /* r7 := map r2 words */
+        load_constant(p, 2, (uint32_t)1 << (32 - bits), 4);
+        emit(p, loadval(3, 1));
+        load_constant(p, 1, iterations, 4);
+
+        size_t top = emit(p, loadval(4, 1664525));
+        for (int i = 0; i < 16; i++) {
+                if (i > 0) {
+                        emit(p, loadval(4, 1664525));
+                }
+                emit(p, op(4, 3, 3, 4));        /* r3 := r3 * 1664525 */
+                emit(p, loadval(4, 12345));
+                emit(p, op(3, 3, 3, 4));        /* r3 := r3 + 12345 */
+                emit(p, op(5, 6, 3, 2));        /* r6 := top bits of r3 */
+                emit(p, op(1, 4, 7, 6));        /* r4 := m[r7][r6] */
+                emit(p, op(3, 4, 4, 3));        /* r4 := r4 + r3 */
+                emit(p, op(2, 7, 6, 4));        /* m[r7][r6] := r4 */
+        }
+        loop_back(p, top);
+}
+
+/********** map_quarter ********
+ *
+ * Emits a loop for shape_phases that maps a 16-word segment into slots
+ * quarter down to 1 of the table in r2, storing the slot number in it
+ ************************/
+static void map_quarter(struct program *p, uint32_t quarter)
+{
+        emit(p, loadval(3, quarter));
+        size_t top = emit(p, loadval(7, 16));
+        emit(p, op(8, 0, 7, 7));                /* r7 := map 16 words */
+        emit(p, op(2, 7, 0, 3));                /* m[r7][0] := r3 */
+        emit(p, op(2, 2, 3, 7));                /* m[r2][r3] := r7 */
+        count_down(p, 3, top);
+}
+
+/********** shape_phases ********
+ *
+ * r0 stays zero, r1 counts iterations down, r2 is the id of the table of
+ * slots, r3 counts slots down in the inner loops, r6 is the slot and r7
+ * scratch. Slots are visited as r3 & mask when filling and as
+ * (r3 * an odd number) & mask when unmapping, which is also every slot
+ * once, in a scattered order.
+ ************************/
+static void shape_phases(struct program *p, uint32_t iterations,
+                         uint32_t size)
+{
+        uint32_t slots = 16;
+        while (slots < size && slots < ((uint32_t)1 << 24)) {
+                slots *= 2;
+        }
+        uint32_t quarter = slots / 4;
+        emit(p, loadval(7, slots));
+        emit(p, op(8, 0, 2, 7));                /* r2 := map the slots */
+        map_quarter(p, quarter);
+        load_constant(p, 1, iterations, 4);
+
+        size_t top = emit(p, loadval(3, quarter));
+        size_t release = emit(p, op(1, 7, 2, 3)); /* unmap the quarter */
+        emit(p, op(9, 0, 0, 7));
+        count_down(p, 3, release);
+
+        emit(p, loadval(3, slots));
+        size_t fill = emit(p, loadval(7, slots - 1));
+        emit(p, op(6, 6, 3, 7));                /* r6 := r3 & mask */
+        emit(p, op(6, 6, 6, 6));
+        emit(p, loadval(7, 16));
+        emit(p, op(8, 0, 7, 7));                /* r7 := map 16 words */
+        emit(p, op(2, 2, 6, 7));                /* m[r2][r6] := r7 */
+        count_down(p, 3, fill);
+
+        emit(p, loadval(3, slots));
+        size_t scatter = emit(p, loadval(6, 0x9E3779));
+        emit(p, op(4, 6, 3, 6));                /* r6 := r3 * odd */
+        emit(p, loadval(7, slots - 1));
+        emit(p, op(6, 6, 6, 7));                /* r6 := r6 & mask */
+        emit(p, op(6, 6, 6, 6));
+        emit(p, op(1, 7, 2, 6));                /* unmap m[r2][r6] */
+        emit(p, op(9, 0, 0, 7));
+        count_down(p, 3, scatter);
+
+        map_quarter(p, quarter);
+        loop_back(p, top);
+}
+
+int main(int argc, char *argv[])
+{
+        if (argc != 4) {
+                fprintf(stderr, "usage: %s <shape> <iterations> <size>\n",
+                        argv[0]);
+                return 1;
+        }
+        uint32_t iterations = strtoul(argv[2], NULL, 0);
+        uint32_t size = strtoul(argv[3], NULL, 0);
+        struct program p = { NULL, 0, 0 };
+
+        if (strcmp(argv[1], "arith") == 0) {
+                shape_arith(&p, iterations, size);
+        } else if (strcmp(argv[1], "loadstore") == 0) {
+                shape_loadstore(&p, iterations, size);
+        } else if (strcmp(argv[1], "churn") == 0) {
+                shape_churn(&p, iterations, size);
+        } else if (strcmp(argv[1], "branch") == 0) {
+                shape_branch(&p, iterations, size);
+        } else if (strcmp(argv[1], "io") == 0) {
+                shape_io(&p, iterations, size);
+        } else if (strcmp(argv[1], "jump") == 0) {
+                shape_jump(&p, iterations, size);
+        } else if (strcmp(argv[1], "sparse") == 0) {
+                shape_sparse(&p, iterations, size);
+        } else if (strcmp(argv[1], "random") == 0) {
+                shape_random(&p, iterations, size);
+        } else if (strcmp(argv[1], "phases") == 0) {
+                shape_phases(&p, iterations, size);
+        } else {
+                fprintf(stderr, "%s: unknown shape %s\n", argv[0], argv[1]);
+                return 1;
+        }
+
+        for (size_t i = 0; i < p.length; i++) {
+                uint32_t w = p.words[i];
+                putchar(w >> 24);
+                putchar(w >> 16);
+                putchar(w >> 8);
+                putchar(w);
+        }
+        free(p.words);
+        return 0;
+}
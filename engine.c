@@ -0,0 +1,333 @@
+/*
+ *     engine.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: engine.c contains the implementation of run_engine(), the
+ *     fast interpreter core. Each instruction is fetched, already decoded,
+ *     from a cached pointer to the pre-decoded copy of segment 0 and
+ *     dispatched through a computed-goto jump table (GCC and Clang) or a
+ *     switch statement (any other compiler, or when UM_SWITCH_DISPATCH is
+ *     defined). Loads and stores index the segment table directly; every
+ *     other memory instruction goes through the functions in memory.h, so
+ *     both engines share one memory model. The superinstructions that
+ *     memory.c fuses into the decoded copy each run two UM instructions (or
+ *     a NAND with one operand) in one dispatch.
+ *
+ *     The loop itself is in engine_loop.h, which is compiled once for
+ *     run_engine(), once with profiling built in for run_engine_profiled(),
+ *     once with an instruction limit for run_engine_bounded() and the runs
+ *     to the first input or output, and once with a budget checked on jumps
+ *     for run_engine_budgeted().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "engine.h"
+#include "memory.h"
+#include "profile.h"
+#include "flight.h"
+
+#if defined(__GNUC__) && !defined(UM_SWITCH_DISPATCH)
+#define THREADED_DISPATCH 1
+#endif
+
+/* what a bounded loop stops just before, besides its limit */
+#define UNTIL_INPUT 1
+#define UNTIL_OUTPUT 2
+
+/* instructions a budgeted loop runs between looks at the clock */
+#define BUDGET_CLOCK_EVERY ((uint64_t)1 << 20)
+
+/********** budget_spent ********
+ *
+ * Function that checks a budgeted loop's budget, and when it is not spent
+ * sets when to check it next
+ *
+ * Parameters:
+ *      const struct engine_budget *budget: the budget
+ *      uint64_t count:       the instructions run so far
+ *      uint64_t *check_at:   set to the count to check it again at
+ *      enum engine_stop *stop: set to ENGINE_LIMIT or ENGINE_TIMEOUT when
+ *                            it is spent
+ *
+ * Return: true if the loop is to stop
+ *
+ * Notes:
+ *     called at most once every BUDGET_CLOCK_EVERY instructions, so the
+ *     clock is read that seldom too
+ ************************/
+static bool __attribute__((noinline, cold))
+budget_spent(const struct engine_budget *budget, uint64_t count,
+             uint64_t *check_at, enum engine_stop *stop)
+{
+        if (count >= budget->instructions) {
+                *stop = ENGINE_LIMIT;
+                return true;
+        }
+        if (budget->deadline_ns != UINT64_MAX) {
+                if (profile_now() >= budget->deadline_ns) {
+                        *stop = ENGINE_TIMEOUT;
+                        return true;
+                }
+                if (budget->instructions - count > BUDGET_CLOCK_EVERY) {
+                        *check_at = count + BUDGET_CLOCK_EVERY;
+                        return false;
+                }
+        }
+        *check_at = budget->instructions;
+        return false;
+}
+
+/* at a jump, whether a budgeted loop has spent its budget and must stop */
+#define SPENT()                                                         \
+        (BUDGETED && count >= check_at &&                               \
+         budget_spent(budget, count, &check_at, stop))
+
+/* 
+ * fetches the next pre-decoded instruction of segment 0. No bounds check is
+ * needed: the decoded copy ends in a halt (see decode_segment in memory.c)
+ */
+#define FETCH()                                                         \
+        do {                                                            \
+                if (BOUNDED && count == limit) {                        \
+                        goto done;                                      \
+                }                                                       \
+                ins = &code[pc++];                                      \
+                count++;                                                \
+                if (PROFILING) {                                        \
+                        profile->dispatches[ins->opcode]++;             \
+                        profile_pc(profile, pc - 1);                    \
+                }                                                       \
+        } while (0)
+
+/* runs action, adding the time it takes to the profile of opcode */
+#define TIMED(opcode, action)                                           \
+        do {                                                            \
+                if (PROFILING) {                                        \
+                        uint64_t start_ns = profile_now();              \
+                        action;                                         \
+                        profile->ns[opcode] += profile_now() - start_ns; \
+                } else {                                                \
+                        action;                                         \
+                }                                                       \
+        } while (0)
+
+#ifdef THREADED_DISPATCH
+#define CASE(n)         L_##n:
+#define DISPATCH()                                                      \
+        do {                                                            \
+                FETCH();                                                \
+                goto *dispatch_table[ins->opcode];                      \
+        } while (0)
+#else
+#define CASE(n)         case n:
+#define DISPATCH()      continue
+#endif
+
+
+#define ENGINE_LOOP run_plain
+#define PROFILING 0
+#define BOUNDED 0
+#define BUDGETED 0
+#include "engine_loop.h"
+#undef ENGINE_LOOP
+#undef PROFILING
+#undef BOUNDED
+#undef BUDGETED
+
+#define ENGINE_LOOP run_profiled
+#define PROFILING 1
+#define BOUNDED 0
+#define BUDGETED 0
+#include "engine_loop.h"
+#undef ENGINE_LOOP
+#undef PROFILING
+#undef BOUNDED
+#undef BUDGETED
+
+#define ENGINE_LOOP run_bounded
+#define PROFILING 0
+#define BOUNDED 1
+#define BUDGETED 0
+#include "engine_loop.h"
+#undef ENGINE_LOOP
+#undef PROFILING
+#undef BOUNDED
+#undef BUDGETED
+
+#define ENGINE_LOOP run_budgeted
+#define PROFILING 0
+#define BOUNDED 0
+#define BUDGETED 1
+#include "engine_loop.h"
+#undef ENGINE_LOOP
+#undef PROFILING
+#undef BOUNDED
+#undef BUDGETED
+
+/********** run_engine ********
+ *
+ * Function that runs the program in segment 0 until it halts or the program
+ * counter runs off the end of segment 0
+ *
+ * Parameters:
+ *      uint32_t *registers:  a pointer to the registers (an array of 8
+ *                            uint32_t values that represent the registers
+ *                            of the UM). They are copied in on entry and
+ *                            written back on exit.
+ *      uint32_t *counter     a pointer to the program counter, copied in on
+ *                            entry and written back on exit
+ *      struct segment_table *table: the segment table
+ *      struct input *in:     the input buffer
+ *      struct output *out:   the output buffer
+ *
+ * Return: the number of instructions executed
+ *
+ * Expects
+ *     registers and counter are not null, and the table is in its proper
+ *     state with segment 0 loaded
+ *
+ * Notes:
+ *     an opcode of 14 or 15 is not a valid instruction; the UM reports it
+ *     and fails. How often each superinstruction ran is added to
+ *     table->fusion.fired.
+ ************************/
+uint64_t run_engine(uint32_t *registers, uint32_t *counter,
+                    struct segment_table *table, struct input *in,
+                    struct output *out)
+{
+        return run_plain(registers, counter, table, in, out, NULL, 0, NULL, 0,
+                         NULL);
+}
+
+/********** run_engine_profiled ********
+ *
+ * Same as run_engine, but also counts every instruction by opcode and by
+ * range of segment 0, times map, unmap, output, input and load program,
+ * and counts the runs of each load program instruction
+ *
+ * Parameters:
+ *      the parameters of run_engine, and
+ *      struct profile *profile: the profile to add to
+ *
+ * Return: the number of instructions executed
+ *
+ * Expects
+ *     profile is not null and has been set up with profile_init()
+ ************************/
+uint64_t run_engine_profiled(uint32_t *registers, uint32_t *counter,
+                             struct segment_table *table, struct input *in,
+                             struct output *out, struct profile *profile)
+{
+        assert(profile != NULL);
+        return run_profiled(registers, counter, table, in, out, profile, 0,
+                            NULL, 0, NULL);
+}
+
+/********** run_engine_bounded ********
+ *
+ * Same as run_engine, but stops after at most limit instructions, and
+ * does not end the process on an invalid instruction
+ *
+ * Parameters:
+ *      the parameters of run_engine, and
+ *      uint64_t limit:       the most instructions to run
+ *      enum engine_stop *stop: set to why it stopped: ENGINE_LIMIT after
+ *                            limit instructions, ENGINE_HALT when the
+ *                            program halted (*counter is then on the halt)
+ *                            or ENGINE_INVALID when the next instruction
+ *                            is not valid (*counter is then on it), or
+ *                            ENGINE_CAP when it is a map or load program
+ *                            the table's caps refuse (likewise)
+ *
+ * Return: the number of instructions executed
+ *
+ * Expects
+ *     stop is not null
+ *
+ * Notes:
+ *     a run that stops on its limit can be continued by calling
+ *     run_engine_bounded() again; a superinstruction that does not fit in
+ *     the limit runs only its first half
+ ************************/
+uint64_t run_engine_bounded(uint32_t *registers, uint32_t *counter,
+                            struct segment_table *table, struct input *in,
+                            struct output *out, uint64_t limit,
+                            enum engine_stop *stop)
+{
+        assert(stop != NULL);
+        return run_bounded(registers, counter, table, in, out, NULL, limit,
+                           stop, 0, NULL);
+}
+
+/********** run_engine_to_input ********
+ *
+ * Same as run_engine_bounded with no limit, but also stops just before the
+ * first input instruction, with *stop set to ENGINE_INPUT and *counter on
+ * that instruction
+ ************************/
+uint64_t run_engine_to_input(uint32_t *registers, uint32_t *counter,
+                             struct segment_table *table, struct input *in,
+                             struct output *out, enum engine_stop *stop)
+{
+        assert(stop != NULL);
+        return run_bounded(registers, counter, table, in, out, NULL,
+                           UINT64_MAX, stop, UNTIL_INPUT, NULL);
+}
+
+/********** run_engine_to_io ********
+ *
+ * Same as run_engine_to_input, but also stops just before the first output
+ * instruction, with *stop set to ENGINE_OUTPUT and *counter on that
+ * instruction, so that the caller can do every input and output itself
+ ************************/
+uint64_t run_engine_to_io(uint32_t *registers, uint32_t *counter,
+                          struct segment_table *table, struct input *in,
+                          struct output *out, enum engine_stop *stop)
+{
+        assert(stop != NULL);
+        return run_bounded(registers, counter, table, in, out, NULL,
+                           UINT64_MAX, stop, UNTIL_INPUT | UNTIL_OUTPUT,
+                           NULL);
+}
+
+/********** run_engine_budgeted ********
+ *
+ * Same as run_engine, but stops a runaway program once it has run out of
+ * a budget of instructions or time. The budget is checked only on jumps,
+ * and the clock only once every BUDGET_CLOCK_EVERY instructions, so the
+ * loop runs as fast as run_engine's.
+ *
+ * Parameters:
+ *      the parameters of run_engine, and
+ *      const struct engine_budget *budget: the budget
+ *      enum engine_stop *stop: set to why it stopped: ENGINE_HALT when the
+ *                            program halted (*counter is then on the
+ *                            halt), ENGINE_LIMIT when it had run its
+ *                            instructions or ENGINE_TIMEOUT when it had
+ *                            passed its deadline (*counter is then on the
+ *                            instruction jumped to)
+ *
+ * Return: the number of instructions executed
+ *
+ * Expects
+ *     budget and stop are not null
+ *
+ * Notes:
+ *     it runs on to the next jump after the budget is spent, so it may run
+ *     more instructions than allowed, or stop later than the deadline; a
+ *     program waiting for input is not stopped until the input comes. A
+ *     run that stopped can be continued by calling it again.
+ ************************/
+uint64_t run_engine_budgeted(uint32_t *registers, uint32_t *counter,
+                             struct segment_table *table, struct input *in,
+                             struct output *out,
+                             const struct engine_budget *budget,
+                             enum engine_stop *stop)
+{
+        assert(budget != NULL && stop != NULL);
+        return run_budgeted(registers, counter, table, in, out, NULL, 0,
+                            stop, 0, budget);
+}
@@ -0,0 +1,76 @@
+/*
+ *     engine.h
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: engine.h defines the fast interpreter core of the UM. Unlike
+ *              execute_instruction() (the reference engine in
+ *              instructions.h), run_engine() keeps the registers and program
+ *              counter in locals, caches the address of segment 0, and
+ *              dispatches every instruction through a jump table.
+ *              run_engine_profiled() is the same loop compiled with the
+ *              execution profiler of profile.h built in, and
+ *              run_engine_bounded() the same loop with an instruction
+ *              limit, for running a program a slice at a time;
+ *              run_engine_to_input() uses it to run up to the first input,
+ *              and run_engine_to_io() up to the first input or output.
+ *              run_engine_budgeted() is the same loop with a budget of
+ *              instructions and time that it checks only on jumps, for
+ *              stopping a runaway program.
+ */
+
+#ifndef ENGINE_INCLUDED
+#define ENGINE_INCLUDED
+#include <stdint.h>
+#include "memory.h"
+#include "io.h"
+#include "profile.h"
+
+/* why run_engine_bounded() stopped */
+enum engine_stop {
+        ENGINE_LIMIT,           /* ran the instructions it was allowed */
+        ENGINE_HALT,            /* the program halted */
+        ENGINE_INVALID,         /* the next instruction is not valid */
+        ENGINE_INPUT,           /* the next instruction is an input */
+        ENGINE_OUTPUT,          /* the next instruction is an output */
+        ENGINE_CAP,             /* the next instruction is a map or load
+                                   program the segment caps refuse */
+        ENGINE_TIMEOUT          /* ran past its deadline */
+};
+
+/* what run_engine_budgeted() may use before it stops */
+struct engine_budget {
+        uint64_t instructions;  /* the most to run, or UINT64_MAX */
+        uint64_t deadline_ns;   /* when to stop, in the time of
+                                   profile_now(), or UINT64_MAX */
+};
+
+uint64_t run_engine(uint32_t *registers, uint32_t *counter,
+                    struct segment_table *table, struct input *in,
+                    struct output *out);
+
+uint64_t run_engine_profiled(uint32_t *registers, uint32_t *counter,
+                             struct segment_table *table, struct input *in,
+                             struct output *out, struct profile *profile);
+
+uint64_t run_engine_bounded(uint32_t *registers, uint32_t *counter,
+                            struct segment_table *table, struct input *in,
+                            struct output *out, uint64_t limit,
+                            enum engine_stop *stop);
+
+uint64_t run_engine_to_input(uint32_t *registers, uint32_t *counter,
+                             struct segment_table *table, struct input *in,
+                             struct output *out, enum engine_stop *stop);
+
+uint64_t run_engine_to_io(uint32_t *registers, uint32_t *counter,
+                          struct segment_table *table, struct input *in,
+                          struct output *out, enum engine_stop *stop);
+
+uint64_t run_engine_budgeted(uint32_t *registers, uint32_t *counter,
+                             struct segment_table *table, struct input *in,
+                             struct output *out,
+                             const struct engine_budget *budget,
+                             enum engine_stop *stop);
+
+#endif
@@ -0,0 +1,304 @@
+/*
+ *     engine_loop.h
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: engine_loop.h holds the body of the interpreter core. It is
+ *     not an ordinary header: engine.c includes it once for each variant
+ *     of the loop, with ENGINE_LOOP naming the function to define,
+ *     PROFILING set to 1 for a loop that fills in a struct profile,
+ *     BOUNDED set to 1 for one that stops after limit instructions and
+ *     BUDGETED set to 1 for one that checks a budget on jumps. (A
+ *     computed-goto function cannot be inlined into several callers, so
+ *     this is how the loop is specialized.) Every use of PROFILING,
+ *     BOUNDED and BUDGETED is a constant condition the compiler removes,
+ *     so the plain loop has none of them.
+ */
+
+/********** ENGINE_LOOP ********
+ *
+ * Function that runs the program in segment 0 until it halts or the program
+ * counter runs off the end of segment 0; see run_engine in engine.c
+ *
+ * Parameters:
+ *      the parameters of run_engine, and
+ *      struct profile *profile: the profile to fill in when PROFILING is 1;
+ *                            unused otherwise
+ *      uint64_t limit:       when BOUNDED is 1, the most instructions to
+ *                            run; unused otherwise
+ *      enum engine_stop *stop: when BOUNDED or BUDGETED is 1, set to why
+ *                            the loop stopped; unused otherwise
+ *      unsigned until:       when BOUNDED is 1, UNTIL_INPUT and/or
+ *                            UNTIL_OUTPUT to stop before the first input
+ *                            or output instruction, or 0; unused otherwise
+ *      const struct engine_budget *budget: when BUDGETED is 1, the budget
+ *                            to stop at; unused otherwise
+ *
+ * Return: the number of instructions executed
+ ************************/
+static uint64_t ENGINE_LOOP(uint32_t *registers, uint32_t *counter,
+                            struct segment_table *table, struct input *in,
+                            struct output *out, struct profile *profile,
+                            uint64_t limit, enum engine_stop *stop,
+                            unsigned until,
+                            const struct engine_budget *budget)
+{
+        uint32_t r[8];
+        for (int i = 0; i < 8; i++) {
+                r[i] = registers[i];
+        }
+        uint32_t pc = *counter;
+        uint64_t count = 0;
+        uint64_t fired[FUSION_KINDS] = { 0 };
+        const struct instruction *ins;
+        bool fits;
+        struct flight *flight = &flight_recorder;
+        uint64_t transfers = flight->count;
+        (void)profile;
+        (void)limit;
+        (void)until;
+        (void)budget;
+        if (BOUNDED) {
+                *stop = ENGINE_LIMIT;
+        }
+        uint64_t check_at = 0; /* when BUDGETED, the count to check at */
+        if (BUDGETED) {
+                *stop = ENGINE_HALT;
+        }
+
+        const struct instruction *code = table->program;
+        uint32_t length = table->segments[0].size;
+        flight->table = table;
+        flight->registers = r;
+        flight->pc = &pc;
+        flight->at = FLIGHT_NONE;
+        flight_enter(flight, &transfers, r, pc);
+        flight_checkpoint(flight, r, transfers, pc, true);
+
+#ifdef THREADED_DISPATCH
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+        static const void *const dispatch_table[OP_COUNT] = {
+                &&L_0, &&L_1, &&L_2, &&L_3, &&L_4, &&L_5, &&L_6, &&L_7,
+                &&L_8, &&L_9, &&L_10, &&L_11, &&L_12, &&L_13, &&L_14, &&L_15,
+                &&L_16, &&L_17, &&L_18
+        };
+        DISPATCH();
+#else
+        for (;;) {
+        FETCH();
+        switch (ins->opcode) {
+#endif
+
+        CASE(0) /* conditional move */
+                if (r[ins->rc] != 0) {
+                        r[ins->ra] = r[ins->rb];
+                }
+                DISPATCH();
+        CASE(1) /* segmented load */
+                r[ins->ra] = table->segments[r[ins->rb]].address[r[ins->rc]];
+                DISPATCH();
+        CASE(2) /* segmented store: segment 0 also needs re-decoding, and
+                   either side of a copy-on-write pair needs copying */
+                if (r[ins->ra] == 0 || r[ins->ra] == table->shared_with) {
+                        flight_call(flight, pc - 1);
+                        store_memory(ins->ra, ins->rb, ins->rc, r, table);
+                        flight_return(flight);
+                        if (r[ins->ra] == 0) { /* the code changed */
+                                flight_checkpoint(flight, r, transfers, pc,
+                                                  true);
+                        }
+                        code = table->program; /* may be a new copy */
+                } else {
+                        table->segments[r[ins->ra]].address[r[ins->rb]] =
+                                r[ins->rc];
+                }
+                DISPATCH();
+        CASE(3) /* addition */
+                r[ins->ra] = r[ins->rb] + r[ins->rc];
+                DISPATCH();
+        CASE(4) /* multiplication */
+                r[ins->ra] = r[ins->rb] * r[ins->rc];
+                DISPATCH();
+        CASE(5) /* division */
+                r[ins->ra] = r[ins->rb] / r[ins->rc];
+                DISPATCH();
+        CASE(6) /* bitwise NAND */
+                r[ins->ra] = ~(r[ins->rb] & r[ins->rc]);
+                DISPATCH();
+        CASE(7) /* halt, or ran off the end: leave the counter on it */
+                pc--;
+                if (pc == length) { /* the sentinel is not an instruction */
+                        count--;
+                        if (PROFILING) {
+                                profile->dispatches[7]--;
+                        }
+                }
+                if (BOUNDED) {
+                        *stop = ENGINE_HALT;
+                }
+                goto done;
+        CASE(8) /* map segment */
+                flight_call(flight, pc - 1);
+                TIMED(8, fits = map_segment(ins->rb, ins->rc, r, table));
+                flight_return(flight);
+                if (!fits) {
+                        goto over_cap;
+                }
+                DISPATCH();
+        CASE(9) /* unmap segment */
+                flight_call(flight, pc - 1);
+                TIMED(9, unmap_segment(ins->rc, r, table));
+                flight_return(flight);
+                DISPATCH();
+        CASE(10) /* output */
+                /* when asked, leave the output to the caller */
+                if (BOUNDED && (until & UNTIL_OUTPUT) != 0) {
+                        *stop = ENGINE_OUTPUT;
+                        pc--;
+                        count--;
+                        goto done;
+                }
+                TIMED(10,
+                        if (r[ins->rc] <= 255) {
+                                output_byte(out, r[ins->rc]);
+                        });
+                DISPATCH();
+        CASE(11) /* input */
+                /* when asked, leave the input to the caller */
+                if (BOUNDED && (until & UNTIL_INPUT) != 0) {
+                        *stop = ENGINE_INPUT;
+                        pc--;
+                        count--;
+                        goto done;
+                }
+                TIMED(11,
+                        if (in->next == in->end) { /* about to wait */
+                                output_flush(out);
+                        }
+                        r[ins->rc] = input_byte(in));
+                DISPATCH();
+        CASE(12) /* load program: segment 0 may have been replaced */
+                if (PROFILING) {
+                        profile_site(profile, pc - 1);
+                        if (r[ins->rb] != 0) {
+                                profile->new_programs++;
+                        }
+                }
+                if (!PROFILING && r[ins->rb] == 0) { /* within segment 0 */
+                        pc = r[ins->rc];
+                        flight_enter(flight, &transfers, r, pc);
+                } else {
+                        flight_call(flight, pc - 1);
+                        TIMED(12, fits = load_program(ins->rb, ins->rc, r,
+                                                      table, &pc));
+                        flight_return(flight);
+                        if (!fits) {
+                                goto over_cap;
+                        }
+                        code = table->program;
+                        length = table->segments[0].size;
+                        flight_enter(flight, &transfers, r, pc);
+                        if (FLIGHT_RECORDING &&
+                            table->generation != flight->generation) {
+                                flight_checkpoint(flight, r, transfers, pc,
+                                                  false);
+                        }
+                }
+                if (pc > length) { /* jumped past the final halt */
+                        if (BOUNDED) {
+                                *stop = ENGINE_HALT;
+                        }
+                        goto done;
+                }
+                if (SPENT()) {
+                        goto done;
+                }
+                DISPATCH();
+        CASE(13) /* load value */
+                r[ins->ra] = ins->value;
+                DISPATCH();
+        CASE(16) /* OP_NOT */
+                fired[OP_NOT - OP_NOT]++;
+                r[ins->ra] = ~r[ins->rb];
+                DISPATCH();
+        CASE(17) /* OP_LOAD_PAIR: the second load value is the next word */
+                r[ins->ra] = ins->value;
+                if (BOUNDED && count == limit) { /* no room for the second */
+                        goto done;
+                }
+                fired[OP_LOAD_PAIR - OP_NOT]++;
+                r[code[pc].ra] = code[pc].value;
+                pc++;
+                count++;
+                DISPATCH();
+        CASE(18) /* OP_JUMP: load value, then load program from it */
+                r[ins->ra] = ins->value;
+                if (BOUNDED && count == limit) { /* no room for the jump */
+                        goto done;
+                }
+                if (r[code[pc].rb] != 0) { /* a new program: no shortcut */
+                        DISPATCH();
+                }
+                fired[OP_JUMP - OP_NOT]++;
+                if (PROFILING) {
+                        profile_site(profile, pc);
+                        profile->fused_jumps++;
+                }
+                flight_enter(flight, &transfers, r, ins->value);
+                pc = ins->value;
+                count++;
+                if (pc > length) { /* jumped past the final halt */
+                        if (BOUNDED) {
+                                *stop = ENGINE_HALT;
+                        }
+                        goto done;
+                }
+                if (SPENT()) {
+                        goto done;
+                }
+                DISPATCH();
+        CASE(14)
+        CASE(15)
+                if (BOUNDED) { /* leave it to the caller */
+                        *stop = ENGINE_INVALID;
+                        pc--;
+                        count--;
+                        goto done;
+                }
+                output_flush(out);
+                fprintf(stderr, "um: invalid opcode %u at %u\n",
+                        ins->opcode, pc - 1);
+                exit(EXIT_FAILURE);
+        over_cap: /* a map or load program the caps refused */
+                if (BOUNDED) { /* leave it to the caller */
+                        *stop = ENGINE_CAP;
+                        pc--;
+                        count--;
+                        goto done;
+                }
+                output_flush(out);
+                report_cap(table);
+                exit(EXIT_FAILURE);
+
+#ifdef THREADED_DISPATCH
+#pragma GCC diagnostic pop
+#else
+        }
+        }
+#endif
+
+done:
+        flight->registers = NULL;
+        flight->pc = NULL;
+        flight->count = transfers;
+        for (int i = 0; i < 8; i++) {
+                registers[i] = r[i];
+        }
+        for (int i = 0; i < FUSION_KINDS; i++) {
+                table->fusion.fired[i] += fired[i];
+        }
+        *counter = pc;
+        return count;
+}
@@ -0,0 +1,683 @@
+/*
+ *     flight.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: flight.c contains the implementation of the flight recorder
+ *     defined in flight.h: the fatal-signal handler and the dump, which
+ *     replays the stretches between the recorded transfers. A replay
+ *     reads segments as they are at the fault, so a load whose words have
+ *     been stored to since shows what is there now; what a map or input
+ *     put in a register is not known at all, and is shown as such. The
+ *     code it replays is read the same way, so it never starts before the
+ *     latest store to segment 0, which takes a checkpoint of its own.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include "assert.h"
+#include "Word.h"
+#include "flight.h"
+
+__thread struct flight flight_recorder;
+
+/* flushed before a dump; set by flight_install() */
+static struct output *flight_output;
+
+static const char *const opcode_names[16] = {
+        "cmov", "load", "store", "add", "mul", "div", "nand", "halt",
+        "map", "unmap", "output", "input", "loadprog", "loadval",
+        "invalid14", "invalid15"
+};
+
+/* what replaying one instruction found */
+enum outcome {
+        RAN,                    /* it ran, and the stretch goes on */
+        ENDED,                  /* it ran, and ended the stretch */
+        FAULTED,                /* it is where the program failed */
+        LOST                    /* whether it failed depends on a register
+                                   that is not known, or the replay cannot
+                                   follow the program past it */
+};
+
+/* one line of a dump */
+struct step {
+        uint32_t pc;
+        uint32_t word;
+        int reg;                /* the register it changed, or -1 */
+        uint32_t before;
+        uint32_t after;
+        bool known;             /* whether after is */
+        enum outcome outcome;
+        const char *why;        /* for FAULTED, or NULL */
+        bool jumped;            /* a load program, to target */
+        uint32_t target;
+};
+
+/* a replayed register file */
+struct replay_state {
+        uint32_t r[8];
+        unsigned unknown;       /* a bit per register not known */
+        const uint32_t *live;   /* the registers of the core at the fault */
+};
+
+/* the last FLIGHT_LINES steps of a dump; static, as it runs in a handler */
+static struct step steps[FLIGHT_LINES];
+static uint64_t step_count;
+
+/********** known ********
+ *
+ * Returns whether every register in mask is known
+ ************************/
+static bool known(const struct replay_state *state, unsigned mask)
+{
+        return (state->unknown & mask) == 0;
+}
+
+/********** written ********
+ *
+ * Returns a bit for each register an instruction may write
+ ************************/
+static unsigned written(uint32_t word)
+{
+        unsigned opcode = get_opcode(word);
+        if (opcode <= 6 && opcode != 2) {
+                return 1u << get_ra(word);
+        } else if (opcode == 8) {
+                return 1u << get_rb(word);
+        } else if (opcode == 11) {
+                return 1u << get_rc(word);
+        } else if (opcode == 13) {
+                return 1u << get_lv_ra(word);
+        }
+        return 0;
+}
+
+/********** recover ********
+ *
+ * Function that fills in the registers not known from those of the core at
+ * the fault, for each one that nothing from pc to the end of the stretch
+ * can write: whatever instruction failed, it still held the same value
+ *
+ * Parameters:
+ *      const struct segment *program: segment 0
+ *      struct replay_state *state: the registers, updated
+ *      uint32_t pc:          where the replay is, in the stretch the
+ *                            program failed in
+ *
+ * Return: void
+ ************************/
+static void recover(const struct segment *program, struct replay_state *state,
+                    uint32_t pc)
+{
+        unsigned changing = 0;
+        for (uint32_t i = pc; i < program->size; i++) {
+                uint32_t word = program->address[i];
+                changing |= written(word);
+                if (get_opcode(word) == 7 || get_opcode(word) == 12) {
+                        break;
+                }
+        }
+        for (int i = 0; i < 8; i++) {
+                unsigned bit = 1u << i;
+                if ((state->unknown & bit) != 0 && (changing & bit) == 0) {
+                        state->r[i] = state->live[i];
+                        state->unknown &= ~bit;
+                }
+        }
+}
+
+/********** addressable ********
+ *
+ * Returns whether word index of segment id can be read, and so whether a
+ * load or store of it does not fail
+ ************************/
+static bool addressable(const struct segment_table *table, uint32_t id,
+                        uint32_t index)
+{
+        return segment_mapped(table, id) &&
+               index < table->segments[id].size;
+}
+
+/********** replay_one ********
+ *
+ * Function that replays one instruction
+ *
+ * Parameters:
+ *      const struct segment_table *table: the table, as it is now
+ *      struct replay_state *state: the registers, updated
+ *      uint32_t pc:          where the instruction is
+ *      uint32_t word:        the instruction
+ *      uint32_t at:          where the last map, unmap, load program or
+ *                            segment 0 store of the stretch ran, or
+ *                            FLIGHT_NONE
+ *      bool newest:          whether the stretch is the one the program
+ *                            failed in; in the others every instruction
+ *                            ran, so none can fail or be lost
+ *      struct step *step:    filled in with what it did
+ *
+ * Return: what it found
+ ************************/
+static enum outcome replay_one(const struct segment_table *table,
+                               struct replay_state *state, uint32_t pc,
+                               uint32_t word, uint32_t at, bool newest,
+                               struct step *step)
+{
+        unsigned opcode = get_opcode(word);
+        unsigned a = get_ra(word), b = get_rb(word), c = get_rc(word);
+        uint32_t *r = state->r;
+        int reg = -1;
+        bool sure = true;
+        uint32_t value = 0;
+        enum outcome outcome = RAN;
+
+        step->why = NULL;
+        if (newest && pc == at) { /* failed inside memory.c */
+                step->why = "failed in the call";
+                outcome = FAULTED;
+        } else if (opcode == 0 || (opcode >= 3 && opcode <= 6)) {
+                reg = a;
+                sure = known(state, 1u << b | 1u << c);
+                if (opcode == 5 && known(state, 1u << c) && r[c] == 0) {
+                        step->why = "divided by zero";
+                        outcome = FAULTED;
+                        reg = -1;
+                } else if (opcode == 5 && !sure && newest) {
+                        outcome = LOST;
+                        reg = -1;
+                } else if (opcode == 0) {
+                        value = r[c] != 0 ? r[b] : r[a];
+                        sure = sure && known(state, 1u << a);
+                } else if (opcode != 5) {
+                        value = opcode == 3 ? r[b] + r[c] :
+                                opcode == 4 ? r[b] * r[c] : ~(r[b] & r[c]);
+                } else {
+                        value = sure ? r[b] / r[c] : 0;
+                }
+        } else if (opcode == 1 || opcode == 2) {
+                unsigned id = opcode == 1 ? b : a;
+                unsigned index = opcode == 1 ? c : b;
+                sure = known(state, 1u << id | 1u << index);
+                bool fine = sure && addressable(table, r[id], r[index]);
+                if (!sure && newest) {
+                        outcome = LOST;
+                } else if (!fine && newest) {
+                        step->why = segment_mapped(table, r[id]) ?
+                                "past the end of the segment" :
+                                "segment not mapped";
+                        outcome = FAULTED;
+                } else if (opcode == 1) {
+                        reg = a;
+                        sure = fine;
+                        value = fine ?
+                                table->segments[r[b]].address[r[c]] : 0;
+                }
+        } else if (opcode == 8 || opcode == 11) {
+                reg = opcode == 8 ? (int)b : (int)c;
+                sure = false;
+        } else if (opcode == 13) {
+                reg = get_lv_ra(word);
+                value = get_lv_val(word);
+        } else if (opcode == 7 || opcode == 12) {
+                outcome = ENDED;
+        } else if (opcode >= 14) {
+                step->why = "not a valid instruction";
+                outcome = FAULTED;
+        }
+
+        step->pc = pc;
+        step->word = word;
+        step->jumped = false;
+        step->reg = reg;
+        step->outcome = outcome;
+        if (reg >= 0) {
+                step->before = r[reg];
+                step->after = value;
+                step->known = sure;
+                r[reg] = value;
+                if (sure) {
+                        state->unknown &= ~(1u << reg);
+                } else {
+                        state->unknown |= 1u << reg;
+                }
+        }
+        return outcome;
+}
+
+/********** push_step ********
+ *
+ * Adds a step to the last FLIGHT_LINES of a dump
+ ************************/
+static void push_step(const struct step *step)
+{
+        steps[step_count++ % FLIGHT_LINES] = *step;
+}
+
+/********** first_checkpoint ********
+ *
+ * Function that finds the checkpoint to replay from: the oldest one whose
+ * transfers are all still recorded, of the current segment 0, and not
+ * before the latest barrier (the registers may have been changed when the
+ * core was not running, and the code by a store to segment 0)
+ *
+ * Parameters:
+ *      const struct flight *flight: the flight recorder
+ *      uint32_t newest:      the low bits of the latest transfer's number
+ *
+ * Return: the checkpoint, or NULL if there is none
+ ************************/
+static const struct flight_checkpoint *
+first_checkpoint(const struct flight *flight, uint32_t newest)
+{
+        uint64_t end = flight->checkpoint_count;
+        uint64_t begin = end < FLIGHT_CHECKPOINTS ? 0 :
+                         end - FLIGHT_CHECKPOINTS;
+        for (uint64_t i = end; i > begin; i--) { /* the latest barrier */
+                if (flight->checkpoints[(i - 1) %
+                                        FLIGHT_CHECKPOINTS].barrier) {
+                        begin = i - 1;
+                        break;
+                }
+        }
+
+        for (uint64_t i = begin; i < end; i++) { /* in the order taken */
+                const struct flight_checkpoint *checkpoint =
+                        &flight->checkpoints[i % FLIGHT_CHECKPOINTS];
+                uint32_t distance = newest - (uint32_t)checkpoint->number;
+                if (distance < FLIGHT_TRANSFERS &&
+                    checkpoint->generation == flight->table->generation) {
+                        return checkpoint;
+                }
+        }
+        return NULL;
+}
+
+/********** replay ********
+ *
+ * Function that replays the program from the first checkpoint up to the
+ * instruction that failed, keeping the last FLIGHT_LINES steps
+ *
+ * Parameters:
+ *      const struct flight *flight: the flight recorder, of a core that is
+ *                            running
+ *
+ * Return: what the last instruction replayed found
+ ************************/
+static enum outcome replay(const struct flight *flight)
+{
+        const struct segment_table *table = flight->table;
+        const struct segment *program = &table->segments[0];
+        uint32_t newest = flight_newest(flight);
+        const struct flight_checkpoint *checkpoint =
+                first_checkpoint(flight, newest);
+        step_count = 0;
+        if (checkpoint == NULL) {
+                return LOST;
+        }
+        struct replay_state state;
+        memcpy(state.r, checkpoint->registers, sizeof(state.r));
+        state.unknown = 0;
+        state.live = flight->registers;
+
+        uint32_t pc = checkpoint->pc;
+        for (uint32_t number = checkpoint->number;; number++) {
+                bool last = number == newest;
+                uint32_t at = last ? flight->at : FLIGHT_NONE;
+                if (number != (uint32_t)checkpoint->number) {
+                        pc = flight->transfer_to[number %
+                                                 FLIGHT_TRANSFERS];
+                }
+                enum outcome outcome = LOST;
+                for (; pc < program->size; pc++) {
+                        struct step step;
+                        if (last && state.unknown != 0) {
+                                recover(program, &state, pc);
+                        }
+                        outcome = replay_one(table, &state, pc,
+                                             program->address[pc], at, last,
+                                             &step);
+                        push_step(&step);
+                        if (outcome != RAN) {
+                                break;
+                        }
+                }
+                if (last) {
+                        return outcome;
+                }
+                if (outcome != ENDED || get_opcode(program->address[pc]) !=
+                                        12) {
+                        return LOST; /* it cannot have jumped from here */
+                }
+                struct step *jump = &steps[(step_count - 1) % FLIGHT_LINES];
+                jump->jumped = true;
+                jump->target = flight->transfer_to[(number + 1) %
+                                                   FLIGHT_TRANSFERS];
+        }
+}
+
+/* the line of a dump being formatted; static, as it runs in a handler */
+static char line[160];
+static size_t line_used;
+
+/********** put_char ********
+ *
+ * Adds one character to the line being formatted, if it fits
+ ************************/
+static void put_char(char c)
+{
+        if (line_used < sizeof(line)) {
+                line[line_used++] = c;
+        }
+}
+
+/********** put_text ********
+ *
+ * Adds a string to the line being formatted
+ ************************/
+static void put_text(const char *text)
+{
+        while (*text != '\0') {
+                put_char(*text++);
+        }
+}
+
+/********** put_number ********
+ *
+ * Adds n to the line being formatted, in base 10 or 16 (lower case),
+ * padded on the left with pad to at least width characters
+ ************************/
+static void put_number(uint64_t n, unsigned base, unsigned width, char pad)
+{
+        char digits[20];
+        unsigned count = 0;
+        do {
+                digits[count++] = "0123456789abcdef"[n % base];
+                n /= base;
+        } while (n != 0);
+        for (unsigned i = count; i < width; i++) {
+                put_char(pad);
+        }
+        while (count > 0) {
+                put_char(digits[--count]);
+        }
+}
+
+/********** put_line ********
+ *
+ * Ends the line being formatted and writes it to stderr
+ ************************/
+static void put_line(void)
+{
+        put_char('\n');
+        size_t done = 0;
+        while (done < line_used) {
+                ssize_t wrote = write(STDERR_FILENO, line + done,
+                                      line_used - done);
+                if (wrote < 0 && errno == EINTR) {
+                        continue;
+                }
+                if (wrote <= 0) {
+                        break;
+                }
+                done += wrote;
+        }
+        line_used = 0;
+}
+
+/********** put_step ********
+ *
+ * Writes one line of a dump
+ ************************/
+static void put_step(const struct step *step)
+{
+        unsigned opcode = get_opcode(step->word);
+        bool noted = step->why != NULL || step->jumped || step->reg >= 0;
+        put_text(step->why != NULL ? "=> " : "   ");
+        put_number(step->pc, 10, 10, ' ');
+        put_text("  ");
+        put_number(step->word, 16, 8, '0');
+        put_text("  ");
+
+        size_t text = line_used;
+        put_text(opcode_names[opcode]);
+        if (opcode == 13) {
+                put_text(" r");
+                put_number(get_lv_ra(step->word), 10, 0, ' ');
+                put_text(", ");
+                put_number(get_lv_val(step->word), 10, 0, ' ');
+        } else {
+                put_text(" r");
+                put_number(get_ra(step->word), 10, 0, ' ');
+                put_text(", r");
+                put_number(get_rb(step->word), 10, 0, ' ');
+                put_text(", r");
+                put_number(get_rc(step->word), 10, 0, ' ');
+        }
+        while (noted && line_used - text < 24) {
+                put_char(' ');
+        }
+
+        if (step->why != NULL) {
+                put_text(step->why);
+        } else if (step->jumped) {
+                put_text("to ");
+                put_number(step->target, 10, 0, ' ');
+        } else if (step->reg >= 0 && step->known) {
+                put_char('r');
+                put_number(step->reg, 10, 0, ' ');
+                put_text(" = 0x");
+                put_number(step->after, 16, 0, ' ');
+                put_text(" (was 0x");
+                put_number(step->before, 16, 0, ' ');
+                put_char(')');
+        } else if (step->reg >= 0) {
+                put_char('r');
+                put_number(step->reg, 10, 0, ' ');
+                put_text(" = ?");
+        }
+        put_line();
+}
+
+/********** put_instructions ********
+ *
+ * Function that rebuilds and writes the last instructions run
+ *
+ * Parameters:
+ *      const struct flight *flight: the flight recorder, of a core that is
+ *                            running
+ *
+ * Return: void
+ ************************/
+static void put_instructions(const struct flight *flight)
+{
+        enum outcome outcome = replay(flight);
+        uint64_t shown = step_count < FLIGHT_LINES ? step_count :
+                         FLIGHT_LINES;
+        put_text("um: the last ");
+        put_number(shown, 10, 0, ' ');
+        put_text(" instructions run:");
+        put_line();
+        for (uint64_t i = step_count - shown; i < step_count; i++) {
+                put_step(&steps[i % FLIGHT_LINES]);
+        }
+        if (outcome == LOST) {
+                put_text("um: (the replay cannot follow the program past "
+                         "here)");
+                put_line();
+        } else if (outcome != FAULTED) {
+                put_text("um: (none of these failed, so the fault was in "
+                         "the UM itself)");
+                put_line();
+        }
+}
+
+/********** flight_report ********
+ *
+ * Function that writes what the calling thread's flight recorder holds to
+ * stderr: the last instructions run, each with the register it changed,
+ * the registers, and a summary of the segment table
+ *
+ * Return: void
+ *
+ * Notes:
+ *     meant to be called from a handler of a fatal signal, so it writes
+ *     only if the fast interpreter core is running on the thread (which
+ *     keeps its segment table alive), formats every line by hand into a
+ *     static buffer and writes it with write(), all of which is
+ *     async-signal-safe
+ ************************/
+void flight_report(void)
+{
+        const struct flight *flight = &flight_recorder;
+        if (flight->registers == NULL) {
+                put_text("um: the interpreter core was not running; no "
+                         "flight record");
+                put_line();
+                return;
+        }
+        if (FLIGHT_RECORDING) {
+                put_instructions(flight);
+        } else {
+                put_text("um: built with UM_NO_FLIGHT, so no instructions "
+                         "were recorded");
+                put_line();
+        }
+
+        const uint32_t *r = flight->registers;
+        put_text("um: registers");
+        for (int i = 0; i < 8; i++) {
+                put_text(" r");
+                put_number(i, 10, 0, ' ');
+                put_text("=0x");
+                put_number(r[i], 16, 0, ' ');
+        }
+        put_line();
+        const struct segment_table *table = flight->table;
+        const struct memory_stats *memory = &table->memory;
+        put_text("um: segments: ");
+        put_number(memory->live_segments, 10, 0, ' ');
+        put_text(" mapped of ");
+        put_number(table->length, 10, 0, ' ');
+        put_text(" ids, ");
+        put_number(memory->live_words, 10, 0, ' ');
+        put_text(" words (peak ");
+        put_number(memory->peak_words, 10, 0, ' ');
+        put_text("); segment 0 has ");
+        put_number(table->segments[0].size, 10, 0, ' ');
+        put_text(" words");
+        put_line();
+}
+
+/********** flight_fatal ********
+ *
+ * Function that reports a fatal signal and dumps the flight recorder of
+ * the calling thread, async-signal-safely
+ *
+ * Parameters:
+ *      int signal:           the signal
+ *
+ * Return: void
+ *
+ * Notes:
+ *     the signal is named from a table of those flight_install() catches,
+ *     since strsignal() may allocate
+ ************************/
+void flight_fatal(int signal)
+{
+        put_text("um: ");
+        switch (signal) {
+        case SIGSEGV:
+                put_text("Segmentation fault");
+                break;
+        case SIGBUS:
+                put_text("Bus error");
+                break;
+        case SIGFPE:
+                put_text("Floating point exception");
+                break;
+        case SIGILL:
+                put_text("Illegal instruction");
+                break;
+        case SIGABRT:
+                put_text("Aborted");
+                break;
+        default:
+                put_text("signal ");
+                put_number(signal, 10, 0, ' ');
+                break;
+        }
+        put_line();
+        flight_report();
+}
+
+/********** on_fatal ********
+ *
+ * The handler of fatal signals: writes out the program's output, dumps
+ * the flight recorder and raises the signal again, now with its default
+ * action
+ *
+ * Notes:
+ *     the output goes straight to its file descriptor with write(), as
+ *     output_flush() would, but without touching the buffer's counters;
+ *     output handed to a callback is dropped, since the callback may not
+ *     be safe to call here
+ ************************/
+static void on_fatal(int signal)
+{
+        struct output *out = flight_output;
+        if (out != NULL && out->write == NULL) {
+                size_t done = 0;
+                while (done < out->used) {
+                        ssize_t wrote = write(out->fd, out->buffer + done,
+                                              out->used - done);
+                        if (wrote < 0 && errno == EINTR) {
+                                continue;
+                        }
+                        if (wrote <= 0) {
+                                break;
+                        }
+                        done += wrote;
+                }
+                out->used = 0;
+        }
+        flight_fatal(signal);
+        raise(signal);
+}
+
+/********** flight_install ********
+ *
+ * Function that installs the handler that dumps the flight recorder of the
+ * thread that gets a SIGSEGV, SIGBUS, SIGFPE, SIGILL or SIGABRT
+ *
+ * Parameters:
+ *      struct output *out:   the program's output buffer, flushed before
+ *                            the dump, or NULL
+ *
+ * Return: void
+ *
+ * Notes:
+ *     the handler is reset as it runs, so the signal then dumps core as
+ *     usual. Call it before guard_install(), which takes over SIGSEGV and
+ *     dumps the flight recorder itself.
+ ************************/
+void flight_install(struct output *out)
+{
+        static const int signals[] = {
+                SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT
+        };
+        flight_output = out;
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = on_fatal;
+        action.sa_flags = SA_RESETHAND;
+        sigemptyset(&action.sa_mask);
+        for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++) {
+                int status = sigaction(signals[i], &action, NULL);
+                assert(status == 0);
+        }
+}
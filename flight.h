@@ -0,0 +1,213 @@
+/*
+ *     flight.h
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: flight.h defines the flight recorder: an always-on record
+ *              of what the fast interpreter core did last, which a fatal
+ *              signal (a division by zero, a bad segment access, a failed
+ *              assertion) dumps to stderr before the UM dies.
+ *
+ *              Recording every instruction would cost the core far more
+ *              than a record that is almost never read is worth, so it
+ *              records transfers of control instead: where each of the
+ *              last FLIGHT_TRANSFERS jumps went, and the registers on
+ *              arrival at every FLIGHT_EVERY-th one. Between two jumps the
+ *              program runs straight through segment 0 up to the load
+ *              program that makes the next, so the dump rebuilds the last
+ *              instructions run, each with the register it changed, by
+ *              replaying them from the latest checkpoints of the registers
+ *              it has, and stops at the instruction that failed. A map,
+ *              unmap, load program or store to segment 0 also notes where
+ *              it is while it calls into memory.c, since that is where
+ *              memory.c could fail an assertion. A store to segment 0
+ *              changes the code the replay reads, so it takes a
+ *              checkpoint just after itself that the replay never goes
+ *              back past.
+ *
+ *              A jump costs the core two stores, and the registers are
+ *              copied once every FLIGHT_EVERY jumps. The record is per
+ *              thread, so every batch thread keeps its own.
+ */
+
+#ifndef FLIGHT_INCLUDED
+#define FLIGHT_INCLUDED
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "memory.h"
+#include "io.h"
+
+#define FLIGHT_TRANSFERS 256            /* jumps kept; a power of 2 */
+#define FLIGHT_EVERY 64                 /* jumps between checkpoints */
+#define FLIGHT_CHECKPOINTS 8            /* checkpoints kept */
+#define FLIGHT_LINES 40                 /* instructions a dump shows */
+#define FLIGHT_NONE UINT32_MAX          /* no program counter */
+
+/* built with -DUM_NO_FLIGHT, the core records nothing and a fatal signal
+   dumps no instructions */
+#ifdef UM_NO_FLIGHT
+#define FLIGHT_RECORDING 0
+#else
+#define FLIGHT_RECORDING 1
+#endif
+
+/* the registers at one point of the stretch after a transfer */
+struct flight_checkpoint {
+        uint32_t registers[8];
+        uint64_t number;                /* of the transfer, from 1 */
+        uint32_t pc;                    /* where a replay from here
+                                           starts: where the transfer
+                                           went, unless it is a barrier */
+        uint64_t generation;            /* of segment 0 (memory.h) */
+        bool barrier;                   /* whether a replay cannot go
+                                           back past it: the core started
+                                           running there, or had just
+                                           stored to segment 0 */
+};
+
+struct flight {
+        uint32_t transfer_to[FLIGHT_TRANSFERS]; /* where transfer n went,
+                                           at n % FLIGHT_TRANSFERS */
+        uint32_t transfer_number[FLIGHT_TRANSFERS]; /* beside it, the low
+                                           32 bits of n, from 1; 0 in an
+                                           empty slot */
+        struct flight_checkpoint checkpoints[FLIGHT_CHECKPOINTS];
+        uint64_t checkpoint_count;
+        uint64_t count;                 /* transfers before the running
+                                           core started; it counts the
+                                           rest itself */
+        uint64_t generation;            /* of the latest checkpoint */
+        uint32_t at;                    /* the map, unmap, load program
+                                           or segment 0 store in memory.c,
+                                           which came after the latest
+                                           transfer, or FLIGHT_NONE */
+        const uint32_t *registers;      /* the registers of the running
+                                           core, or NULL between runs */
+        const uint32_t *pc;             /* likewise its program counter,
+                                           one past the instruction it
+                                           runs */
+        const struct segment_table *table; /* what it runs on */
+};
+
+/* the calling thread's flight recorder */
+extern __thread struct flight flight_recorder;
+
+/********** flight_checkpoint ********
+ *
+ * Function that records the registers at a point of the stretch after a
+ * transfer
+ *
+ * Parameters:
+ *      struct flight *flight: the flight recorder
+ *      const uint32_t *registers: the registers
+ *      uint64_t number:      the number of the transfer
+ *      uint32_t pc:          the point: where the transfer went, or for a
+ *                            barrier any instruction after it
+ *      bool barrier:         whether a replay cannot go back past it
+ *
+ * Return: void
+ ************************/
+static inline void flight_checkpoint(struct flight *flight,
+                                     const uint32_t *registers,
+                                     uint64_t number, uint32_t pc,
+                                     bool barrier)
+{
+        if (!FLIGHT_RECORDING) {
+                return;
+        }
+        struct flight_checkpoint *checkpoint = &flight->checkpoints[
+                flight->checkpoint_count++ % FLIGHT_CHECKPOINTS];
+        memcpy(checkpoint->registers, registers,
+               sizeof(checkpoint->registers));
+        checkpoint->number = number;
+        checkpoint->pc = pc;
+        checkpoint->generation = flight->table->generation;
+        checkpoint->barrier = barrier;
+        flight->generation = checkpoint->generation;
+}
+
+/********** flight_enter ********
+ *
+ * Function that records a transfer of control, and every FLIGHT_EVERY
+ * transfers the registers on arrival
+ *
+ * Parameters:
+ *      struct flight *flight: the flight recorder
+ *      uint64_t *count:      the core's count of transfers, bumped
+ *      const uint32_t *registers: the registers on arrival
+ *      uint32_t to:          where it went
+ *
+ * Return: void
+ *
+ * Notes:
+ *     a load program that replaces segment 0 must be followed by a
+ *     checkpoint, since the dump cannot replay across it
+ ************************/
+static inline void flight_enter(struct flight *flight, uint64_t *count,
+                                const uint32_t *registers, uint32_t to)
+{
+        if (!FLIGHT_RECORDING) {
+                return;
+        }
+        uint64_t number = ++*count;
+        flight->transfer_to[number % FLIGHT_TRANSFERS] = to;
+        flight->transfer_number[number % FLIGHT_TRANSFERS] = number;
+        if (number % FLIGHT_EVERY == 0) {
+                flight_checkpoint(flight, registers, number, to, false);
+        }
+}
+
+/********** flight_call ********
+ *
+ * Function that notes where a map, unmap, load program or store to
+ * segment 0 is about to call into memory.c
+ ************************/
+static inline void flight_call(struct flight *flight, uint32_t pc)
+{
+        if (!FLIGHT_RECORDING) {
+                return;
+        }
+        flight->at = pc;
+}
+
+/********** flight_return ********
+ *
+ * Function that notes that a call into memory.c has returned, so a later
+ * fault is not blamed on it. A load program returns before the transfer
+ * it makes is recorded, so a note is always of the latest stretch.
+ ************************/
+static inline void flight_return(struct flight *flight)
+{
+        if (!FLIGHT_RECORDING) {
+                return;
+        }
+        flight->at = FLIGHT_NONE;
+}
+
+/********** flight_newest ********
+ *
+ * Returns the low 32 bits of the number of the latest transfer recorded:
+ * the one whose slot is not followed by the next number
+ ************************/
+static inline uint32_t flight_newest(const struct flight *flight)
+{
+        for (uint32_t i = 0; i < FLIGHT_TRANSFERS; i++) {
+                uint32_t number = flight->transfer_number[i];
+                uint32_t next =
+                        flight->transfer_number[(i + 1) % FLIGHT_TRANSFERS];
+                if (number != 0 && next != number + 1) {
+                        return number;
+                }
+        }
+        return 0;
+}
+
+void flight_install(struct output *out);
+
+void flight_report(void);
+
+void flight_fatal(int signal);
+
+#endif
@@ -0,0 +1,154 @@
+/*
+ *     guard.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: guard.c contains the implementation of the fault handler
+ *     defined in guard.h. A fault that is none of the kinds safe mode sets
+ *     up (a bug in the UM itself) is passed on to the default action, so it
+ *     still dumps core. Every report is followed by a dump of the flight
+ *     recorder (flight.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include "assert.h"
+#include "guard.h"
+#include "flight.h"
+
+/* how far past address 0 a word index can reach: 2^32 words */
+#define NULL_REACH ((uintptr_t)1 << 34)
+
+/* what the handler reports on; set once by guard_install() */
+static const struct segment_table *guarded_table;
+static struct output *guarded_output;
+
+/********** find_overrun ********
+ *
+ * Function that finds the segment whose guard pages hold an address
+ *
+ * Parameters:
+ *      uintptr_t address:    the address that faulted
+ *      uint32_t *id:         set to the segment's id
+ *
+ * Return: true if there is one
+ ************************/
+static bool find_overrun(uintptr_t address, uint32_t *id)
+{
+        const struct segment_table *table = guarded_table;
+        for (uint32_t i = 0; i < table->length; i++) {
+                const struct segment *seg = &table->segments[i];
+                if (seg->address == NULL) {
+                        continue;
+                }
+                uintptr_t end = (uintptr_t)(seg->address + seg->size);
+                if (address >= end && address - end < POOL_GUARD_BYTES) {
+                        *id = i;
+                        return true;
+                }
+        }
+        return false;
+}
+
+/********** guard_fail ********
+ *
+ * Function that flushes the program's output, writes a report of what it
+ * did wrong to stderr, and fails the UM
+ *
+ * Parameters:
+ *      const char *report:   the report, ending in a newline
+ *
+ * Return: does not return
+ *
+ * Expects
+ *     guard_install() has been called
+ ************************/
+void guard_fail(const char *report)
+{
+        output_flush(guarded_output);
+        ssize_t written = write(STDERR_FILENO, report, strlen(report));
+        (void)written;
+        flight_report();
+        _exit(EXIT_FAILURE);
+}
+
+/********** on_fault ********
+ *
+ * The SIGSEGV handler: reports a bad segmented load or store and fails
+ *
+ * Notes:
+ *     the UM is about to exit, so the report is formatted with snprintf()
+ *     even though it is not async-signal-safe
+ ************************/
+static void on_fault(int signal, siginfo_t *info, void *context)
+{
+        (void)context;
+        const struct segment_table *table = guarded_table;
+        uintptr_t address = (uintptr_t)info->si_addr;
+        uintptr_t entries = (uintptr_t)table->segments;
+        char report[160];
+        uint32_t id;
+
+        if (address >= entries && address - entries < SAFE_TABLE_BYTES) {
+                snprintf(report, sizeof(report),
+                         "um: --safe: segment %llu is not mapped\n",
+                         (unsigned long long)((address - entries) /
+                                              sizeof(struct segment)));
+        } else if (address < NULL_REACH) {
+                snprintf(report, sizeof(report),
+                         "um: --safe: word %llu of an unmapped segment\n",
+                         (unsigned long long)(address / sizeof(uint32_t)));
+        } else if (find_overrun(address, &id)) {
+                const struct segment *seg = &table->segments[id];
+                snprintf(report, sizeof(report),
+                         "um: --safe: word %llu of segment %u, which has %u "
+                         "words\n",
+                         (unsigned long long)((address -
+                                               (uintptr_t)seg->address) /
+                                              sizeof(uint32_t)),
+                         id, seg->size);
+        } else { /* not the program's doing: fault again, for real */
+                flight_fatal(signal);
+                struct sigaction action;
+                memset(&action, 0, sizeof(action));
+                action.sa_handler = SIG_DFL;
+                sigaction(signal, &action, NULL);
+                return;
+        }
+
+        guard_fail(report);
+}
+
+/********** guard_install ********
+ *
+ * Function that installs the fault handler of safe mode
+ *
+ * Parameters:
+ *      const struct segment_table *table: the table of the machine being
+ *                            run, which must be a safe one
+ *      struct output *out:   its output buffer, flushed before the report
+ *
+ * Return: void
+ *
+ * Notes:
+ *     there is one handler per process, so only one machine can run in
+ *     safe mode at a time
+ ************************/
+void guard_install(const struct segment_table *table, struct output *out)
+{
+        assert(table != NULL && table->safe && out != NULL);
+        guarded_table = table;
+        guarded_output = out;
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = on_fault;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        int status = sigaction(SIGSEGV, &action, NULL);
+        assert(status == 0);
+}
@@ -0,0 +1,30 @@
+/*
+ *     guard.h
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: guard.h defines the fault handler of um --safe. In safe mode
+ *              segments are laid out so that a bad segmented load or store
+ *              faults (see memory.h and pool.h) rather than being checked:
+ *              a segment's words end at guard pages, the entries of ids
+ *              that were never handed out are inaccessible, and unmapped
+ *              ids point at address 0. The handler works out which of
+ *              those a fault hit, flushes the program's output, reports
+ *              it, and fails the UM, so in-bounds accesses run exactly as
+ *              fast as without --safe. The few misuses that do not fault
+ *              (unmapping an id twice, loading a program from an unmapped
+ *              id) are checked where they happen, which is never in the
+ *              hot path, and reported through guard_fail().
+ */
+
+#ifndef GUARD_INCLUDED
+#define GUARD_INCLUDED
+#include "memory.h"
+#include "io.h"
+
+void guard_install(const struct segment_table *table, struct output *out);
+
+void guard_fail(const char *report);
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ *     idmap.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: idmap.c contains the implementation of the free-id bitmap
+ *     defined in idmap.h. Putting an id back only touches the levels above
+ *     it while they go from empty to not, and taking one only while they go
+ *     the other way, so both usually stop after the bottom level.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "idmap.h"
+
+/********** id_map_init ********
+ *
+ * Function that sets up an empty map with room for no ids
+ *
+ * Parameters:
+ *      struct id_map *map:   the map
+ *
+ * Return: void
+ ************************/
+void id_map_init(struct id_map *map)
+{
+        memset(map, 0, sizeof(*map));
+}
+
+/********** id_map_grow ********
+ *
+ * Function that makes room in a map for ids 0 to ids - 1. Levels are
+ * added on top as the bottom one grows, and filled in from the level
+ * below them.
+ *
+ * Parameters:
+ *      struct id_map *map:   the map
+ *      uint32_t ids:         how many ids it must have room for
+ *
+ * Return: void
+ ************************/
+void id_map_grow(struct id_map *map, uint32_t ids)
+{
+        uint32_t count = (uint32_t)(((uint64_t)ids + 63) / 64);
+        unsigned k = 0;
+        for (;;) {
+                assert(k < ID_MAP_LEVELS);
+                if (count > map->words[k]) {
+                        map->levels[k] = realloc(map->levels[k],
+                                                 count * sizeof(uint64_t));
+                        assert(map->levels[k] != NULL);
+                        memset(map->levels[k] + map->words[k], 0,
+                               (count - map->words[k]) * sizeof(uint64_t));
+                        map->words[k] = count;
+                }
+                if (map->words[k] == 1) {
+                        break;
+                }
+                count = (map->words[k] + 63) / 64;
+                k++;
+        }
+
+        for (unsigned level = map->height; level <= k; level++) {
+                if (level == 0) {
+                        continue;
+                }
+                for (uint32_t i = 0; i < map->words[level - 1]; i++) {
+                        if (map->levels[level - 1][i] != 0) {
+                                map->levels[level][i >> 6] |=
+                                        (uint64_t)1 << (i & 63);
+                        }
+                }
+        }
+        if (k + 1 > map->height) {
+                map->height = k + 1;
+        }
+}
+
+/********** id_map_free ********
+ *
+ * Function that frees the memory of a map
+ *
+ * Parameters:
+ *      struct id_map *map:   the map
+ *
+ * Return: void
+ ************************/
+void id_map_free(struct id_map *map)
+{
+        for (unsigned k = 0; k < ID_MAP_LEVELS; k++) {
+                free(map->levels[k]);
+        }
+        id_map_init(map);
+}
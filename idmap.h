@@ -0,0 +1,176 @@
+/*
+ *     idmap.h
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: idmap.h defines the set of unmapped segment ids, kept as a
+ *              hierarchical bitmap: the bottom level has a bit per id, set
+ *              while the id is free, and every level above has a bit per
+ *              word of the one below, set while that word has any bit set.
+ *              The top level is a single word. Taking an id walks down from
+ *              the top with a find-first-set at each level, so it always
+ *              returns the lowest free id, in at most six steps for 2^32
+ *              ids; putting one back, and asking whether an id is free, are
+ *              O(1) as well. Handing out the lowest id keeps the live
+ *              segments packed at the start of the segment table. The map
+ *              also remembers the first bottom word that can have a bit
+ *              set, so a take usually just clears the lowest bit of that
+ *              word, which keeps a map in a loop of maps and unmaps as
+ *              cheap as popping a free list.
+ */
+
+#ifndef IDMAP_INCLUDED
+#define IDMAP_INCLUDED
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ID_MAP_LEVELS 6                 /* 64^6 bits cover 2^32 ids */
+#define ID_MAP_NONE UINT32_MAX          /* what id_map_take() finds empty */
+
+struct id_map {
+        uint64_t *levels[ID_MAP_LEVELS]; /* levels[0] has a bit per id */
+        uint32_t words[ID_MAP_LEVELS];  /* words allocated in each level */
+        unsigned height;                /* levels in use */
+        uint32_t free;                  /* ids in the map */
+        uint32_t first;                 /* no word of levels[0] before this
+                                           one has a bit set */
+};
+
+void id_map_init(struct id_map *map);
+
+void id_map_grow(struct id_map *map, uint32_t ids);
+
+/********** id_map_has ********
+ *
+ * Returns whether id is in the map, that is, free
+ ************************/
+static inline bool id_map_has(const struct id_map *map, uint32_t id)
+{
+        return (id >> 6) < map->words[0] &&
+               (map->levels[0][id >> 6] >> (id & 63) & 1) != 0;
+}
+
+/********** id_map_lowest ********
+ *
+ * Returns the index of the lowest set bit of a nonzero word
+ ************************/
+static inline unsigned id_map_lowest(uint64_t word)
+{
+#ifdef __GNUC__
+        return __builtin_ctzll(word);
+#else
+        unsigned k = 0;
+        while ((word & 1) == 0) {
+                word >>= 1;
+                k++;
+        }
+        return k;
+#endif
+}
+
+/********** id_map_put ********
+ *
+ * Function that adds a free id to a map
+ *
+ * Parameters:
+ *      struct id_map *map:   the map
+ *      uint32_t id:          the id, which the map has room for and which
+ *                            is not in it yet (unchecked)
+ *
+ * Return: void
+ ************************/
+static inline void id_map_put(struct id_map *map, uint32_t id)
+{
+        uint32_t index = id >> 6;
+        uint64_t *word = &map->levels[0][index];
+        bool was_empty = *word == 0;
+        *word |= (uint64_t)1 << (id & 63);
+        map->free++;
+        if (index < map->first) {
+                map->first = index;
+        }
+        if (!was_empty) { /* the levels above have it already */
+                return;
+        }
+        for (unsigned k = 1; k < map->height; k++) {
+                word = &map->levels[k][index >> 6];
+                was_empty = *word == 0;
+                *word |= (uint64_t)1 << (index & 63);
+                if (!was_empty) {
+                        break;
+                }
+                index >>= 6;
+        }
+}
+
+/********** id_map_walk ********
+ *
+ * Function that removes the lowest id from a nonempty map the long way,
+ * walking down from the top level and clearing the bits that empties on
+ * the way back up
+ ************************/
+static inline uint32_t id_map_walk(struct id_map *map)
+{
+        uint32_t index = 0;
+        for (unsigned k = map->height; k-- > 0;) {
+                index = (index << 6) | id_map_lowest(map->levels[k][index]);
+        }
+
+        uint32_t id = index;
+        map->first = id >> 6;
+        for (unsigned k = 0; k < map->height; k++) {
+                uint64_t *word = &map->levels[k][index >> 6];
+                *word &= ~((uint64_t)1 << (index & 63));
+                if (*word != 0) {
+                        break;
+                }
+                index >>= 6;
+        }
+        return id;
+}
+
+/********** id_map_take ********
+ *
+ * Function that removes the lowest id from a map
+ *
+ * Parameters:
+ *      struct id_map *map:   the map
+ *
+ * Return: the id, or ID_MAP_NONE if the map is empty
+ *
+ * Notes:
+ *     every word of the bottom level before map->first is empty, so while
+ *     that word has a bit set its lowest is the lowest id, and taking it
+ *     touches nothing else unless it was the word's last one
+ ************************/
+static inline uint32_t id_map_take(struct id_map *map)
+{
+        if (map->free == 0) {
+                return ID_MAP_NONE;
+        }
+        map->free--;
+        uint64_t *word = &map->levels[0][map->first];
+        uint64_t bits = *word;
+        if (bits == 0) {
+                return id_map_walk(map);
+        }
+        uint32_t id = map->first << 6 | id_map_lowest(bits);
+        *word = bits & (bits - 1); /* clears the lowest bit */
+        if (*word == 0 && map->height > 1) {
+                uint32_t index = map->first;
+                for (unsigned k = 1; k < map->height; k++) {
+                        word = &map->levels[k][index >> 6];
+                        *word &= ~((uint64_t)1 << (index & 63));
+                        if (*word != 0) {
+                                break;
+                        }
+                        index >>= 6;
+                }
+        }
+        return id;
+}
+
+void id_map_free(struct id_map *map);
+
+#endif
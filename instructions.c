@@ -9,16 +9,13 @@
  *              defined in instructions.h. These include helper functions
  *              representing each individual instruction. instructions.c 
  *              utilizes the functions definedin word.h, and also the functions
- *              defined in memory.h to manipulate the Hanson Sequence, Hanson
- *              Stack, and struct pointers.
+ *              defined in memory.h to manipulate the segment table.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include "instructions.h"
 #include "Word.h"
-#include "stack.h"
-#include "seq.h"
 #include "assert.h"
 
 
@@ -71,16 +68,15 @@ void instruction_0(uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers)
  *      uint32_t *registers:  a pointer to the registers (an array of 8 
  *                            uint32_t values that represent the registers 
  *                            of the UM)
- *      Seq_T *ids:           a Hanson sequence that stores struct pointers
- *                            containing the id of each segment (its index
- *                            in the sequence), the 64-bit address of the 
- *                            segment in memory, and the size of the segment.
- * 
+ *      struct segment_table *table: the segment table, which holds the 
+ *                            64-bit address and the size of every segment,
+ *                            indexed by segment id, and the list of 
+ *                            unmapped ids
  * Return: void
  *
  * Expects
  *     expects that ra, rb, and rc are valid, the registers array 
- *     is not null and initalized properly, and the ids Sequence is not null
+ *     is not null and initalized properly, and the segment table is not null
  *     and is in its proper state
  * 
  * Notes:
@@ -89,10 +85,10 @@ void instruction_0(uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers)
  *      it manipulates memory.
  ************************/
 void instruction_1(uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers, 
-                   Seq_T *ids) 
+                   struct segment_table *table) 
 {
 
-        load_memory(ra, rb, rc, registers, ids);
+        load_memory(ra, rb, rc, registers, table);
 }
 
 /********** instruction_2 ********
@@ -111,16 +107,15 @@ void instruction_1(uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers,
  *      uint32_t *registers:  a pointer to the registers (an array of 8 
  *                            uint32_t values that represent the registers 
  *                            of the UM)
- *      Seq_T *ids:           a Hanson sequence that stores struct pointers
- *                            containing the id of each segment (its index
- *                            in the sequence), the 64-bit address of the 
- *                            segment in memory, and the size of the segment.
- * 
+ *      struct segment_table *table: the segment table, which holds the 
+ *                            64-bit address and the size of every segment,
+ *                            indexed by segment id, and the list of 
+ *                            unmapped ids
  * Return: void
  *
  * Expects
  *     expects that ra, rb, and rc are valid, the registers array 
- *     is not null and initalized properly, and the ids Sequence is not null
+ *     is not null and initalized properly, and the segment table is not null
  *     and is in its proper state
  * 
  * Notes:
@@ -129,9 +124,9 @@ void instruction_1(uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers,
  *      because it manipulates memory.
  ************************/
 void instruction_2(uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers, 
-                   Seq_T *ids) 
+                   struct segment_table *table) 
 {
-        store_memory(ra, rb, rc, registers, ids);
+        store_memory(ra, rb, rc, registers, table);
 }
 
 /********** instruction_3 ********
@@ -262,7 +257,7 @@ void instruction_6(uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers)
  *
  * function that given the rb and rc values of an instruction, the 
  * registers, and the segment , maps a segment to memory and adds it to the
- * correct spot in the Hanson Sequence ids.
+ * correct spot in the segment table.
  *
  * Parameters:
  *      uint32_t rb:          uint32_t that represents the rb value of a
@@ -272,33 +267,33 @@ void instruction_6(uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers)
  *      uint32_t *registers:  a pointer to the registers (an array of 8 
  *                            uint32_t values that represent the registers 
  *                            of the UM)
- *      Seq_T *ids:           a pointer to the Hanson sequence that stores 
- *                            struct pointers containing the id of each segment
- *                            (its index in the sequence), the 64-bit address 
- *                            of the segment in memory, and the size of the 
- *                            segment.
- * 
- *      Stack_T *unmapped     a pointer to the Hanson stack that stores
- *                            the uint32_t pointers that represent the ids of 
- *                            the most recently unmapped segments 
+ *      struct segment_table *table: the segment table, which holds the 
+ *                            64-bit address and the size of every segment,
+ *                            indexed by segment id, and the list of 
+ *                            unmapped ids
+ *      struct output *out:   the output buffer, flushed before the UM fails
  * 
  * Return: void
  *
  * Expects
  *     expects that rb, and rc are valid, the registers array 
- *     is not null and initalized properly, the ids Sequence is not null
- *     and is in its proper state, and that the unmapped Stack is not null
+ *     is not null and initalized properly, and the segment table is not null
  *     and is in its proper state
  * 
  * Notes:
  *      function is only used internally, so assumes input is valid. 
  *      instruction_8 uses the map_sgement function defined in memory.h 
- *      because it manipulates memory.
+ *      because it manipulates memory. A segment over the table's caps
+ *      fails the UM.
  ************************/
 void instruction_8(uint32_t rb, uint32_t rc, uint32_t *registers, 
-                   Stack_T *unmapped, Seq_T *ids) 
+                   struct segment_table *table, struct output *out) 
 {
-      map_segment(rb,rc, registers, unmapped, ids );
+        if (!map_segment(rb, rc, registers, table)) {
+                output_flush(out);
+                report_cap(table);
+                exit(EXIT_FAILURE);
+        }
 }
 
 /********** instruction_9 ********
@@ -315,23 +310,16 @@ void instruction_8(uint32_t rb, uint32_t rc, uint32_t *registers,
  *      uint32_t *registers:  a pointer to the registers (an array of 8 
  *                            uint32_t values that represent the registers 
  *                            of the UM)
- *      Seq_T *ids:           a pointer to the Hanson sequence that stores 
- *                            struct pointers containing the id of each 
- *                            segment
- *                            (its index in the sequence), the 64-bit address 
- *                            of the segment in memory, and the size of the 
- *                            segment.
- * 
- *      Stack_T *unmapped     a pointer to the Hanson stack that stores
- *                            the uint32_t pointers that represent the ids of 
- *                            the most recently unmapped segments 
+ *      struct segment_table *table: the segment table, which holds the 
+ *                            64-bit address and the size of every segment,
+ *                            indexed by segment id, and the list of 
+ *                            unmapped ids
  * 
  * Return: void
  *
  * Expects
  *     expects that rc is valid, the registers array 
- *     is not null and initalized properly, the ids Sequence is not null
- *     and is in its proper state, and that the unmapped Stack is not null
+ *     is not null and initalized properly, and the segment table is not null
  *     and is in its proper state
  * 
  * Notes:
@@ -339,17 +327,17 @@ void instruction_8(uint32_t rb, uint32_t rc, uint32_t *registers,
  *      instruction_9 uses the unmap_sgement function defined in memory.h 
  *      because it manipulates memory.
  ************************/
-void instruction_9(uint32_t rc, uint32_t *registers, Stack_T *unmapped, 
-                   Seq_T *ids) 
+void instruction_9(uint32_t rc, uint32_t *registers, 
+                   struct segment_table *table) 
 {
-        unmap_segment(rc, registers, unmapped, ids );
+        unmap_segment(rc, registers, table);
 }
 
 
 /********** instruction_10 ********
  *
  * function that given rc values of an instruction and the 
- * registers, writes the value in $r[C] to the I/O device immediately. 
+ * registers, writes the value in $r[C] to the I/O device's output buffer.
  * Only values from 0 to 255 are allowed.
  *
  * Parameters:
@@ -358,6 +346,7 @@ void instruction_9(uint32_t rc, uint32_t *registers, Stack_T *unmapped,
  *      uint32_t *registers:  a pointer to the registers (an array of 8 
  *                            uint32_t values that represent the registers 
  *                            of the UM)
+ *      struct output *out:   the output buffer
  * 
  * Return: void
  *
@@ -369,10 +358,10 @@ void instruction_9(uint32_t rc, uint32_t *registers, Stack_T *unmapped,
  * Notes:
  *      function is only used internally, so assumes input is valid. 
  ************************/
-void instruction_10(uint32_t rc, uint32_t *registers) 
+void instruction_10(uint32_t rc, uint32_t *registers, struct output *out)
 {
         if (registers[rc] <= 255) {
-                fprintf(stdout, "%c", registers[rc]);
+                output_byte(out, registers[rc]);
         }      
 }
 
@@ -390,6 +379,8 @@ void instruction_10(uint32_t rc, uint32_t *registers)
  *      uint32_t *registers:  a pointer to the registers (an array of 8 
  *                            uint32_t values that represent the registers 
  *                            of the UM)
+ *      struct input *in:     the input buffer
+ *      struct output *out:   the output buffer, flushed before waiting
  * 
  * Return: void
  *
@@ -403,22 +394,20 @@ void instruction_10(uint32_t rc, uint32_t *registers)
  * Notes:
  *      function is only used internally, so assumes input is valid. 
  ************************/
-void instruction_11(uint32_t rc, uint32_t *registers) 
+void instruction_11(uint32_t rc, uint32_t *registers, struct input *in,
+                    struct output *out)
 {
-        int input ;
-        input = getc(stdin);
-        if (input == EOF) {
-                registers[rc] = 0xFFFFFFFF;
-        } else {
-                assert(input <= 255 && input >= 0); 
-                registers[rc] = (uint32_t)input;
-        }         
+        if (in->next == in->end) {
+                output_flush(out); /* the program may be waiting on its own
+                                      prompt */
+        }
+        registers[rc] = input_byte(in);
 }
 
 /********** instruction_12 ********
  *
  * function that given the rb and rc values of an instruction, the 
- * registers, the Sequence ids, and a uint32_t counter, duplicates the segment
+ * registers, the segment table, and a uint32_t counter, duplicates the segment
  * in $m[$r[B]], replaces $m[0] with the duplicate, and abandons what was 
  * previously in $m[0]. The program counter is set to point to $m[0][$r[C]]. 
  *
@@ -430,31 +419,38 @@ void instruction_11(uint32_t rc, uint32_t *registers)
  *      uint32_t *registers:  a pointer to the registers (an array of 8 
  *                            uint32_t values that represent the registers 
  *                            of the UM)
- *      Seq_T *ids:           a pointer to the Hanson sequence that stores 
- *                            struct pointers containing the id of each segment
- *                            (its index in the sequence), the 64-bit address 
- *                            of the segment in memory, and the size of the 
- *                            segment.
+ *      struct segment_table *table: the segment table, which holds the 
+ *                            64-bit address and the size of every segment,
+ *                            indexed by segment id, and the list of 
+ *                            unmapped ids
  *      uint32_t *counter     a pointer to a uint32_t variable that represents
  *                            the program counter, or which index of segment 0
  *                            we are in within our execution loop
+ *      struct input *in:     the input buffer
+ *      struct output *out:   the output buffer
  *      
  * Return: void
  *
  * Expects
  *     expects that rb, and rc are valid, the registers array 
- *     is not null and initalized properly, the ids Sequence is not null
+ *     is not null and initalized properly, the segment table is not null
  *     and is in its proper state, and that counter is not null
  * 
  * Notes:
  *      function is only used internally, so assumes input is valid. 
  *      instruction_12 uses the load_program function defined in memory.h 
- *      because it manipulates memory.
+ *      because it manipulates memory. A program over the table's cap on
+ *      words fails the UM.
  ************************/
-void instruction_12(uint32_t rb, uint32_t rc, uint32_t *registers, Seq_T *ids,
-                    uint32_t *counter) 
+void instruction_12(uint32_t rb, uint32_t rc, uint32_t *registers, 
+                    struct segment_table *table, uint32_t *counter,
+                    struct output *out) 
 {
-       load_program(rb, rc, registers, ids, counter);   
+        if (!load_program(rb, rc, registers, table, counter)) {
+                output_flush(out);
+                report_cap(table);
+                exit(EXIT_FAILURE);
+        }
 }
 
 /********** instruction_13 ********
@@ -498,34 +494,32 @@ void instruction_13(uint32_t ra, uint32_t val, uint32_t *registers)
  *      uint32_t *registers:  a pointer to the registers (an array of 8 
  *                            uint32_t values that represent the registers 
  *                            of the UM)
- *      Seq_T *ids:           a pointer to the Hanson sequence that stores 
- *                            struct pointers containing the id of each segment
- *                            (its index in the sequence), the 64-bit address 
- *                            of the segment in memory, and the size of the 
- *                            segment.
- *      Stack_T *unmapped     a pointer to the Hanson stack that stores
- *                            the uint32_t pointers that represent the ids of 
- *                            the most recently unmapped segments 
+ *      struct segment_table *table: the segment table, which holds the 
+ *                            64-bit address and the size of every segment,
+ *                            indexed by segment id, and the list of 
+ *                            unmapped ids
  *      uint32_t *counter     a pointer to a uint32_t variable that represents
  *                            the program counter, or which index of segment 0
  *                            we are in within our execution loop
+ *      struct output *out:   the output buffer
  *      
  * Return: void
  *
  * Expects
  *     expects that opcode is from 0-13, word represents a valid instruction,
- *     the ids Sequence is not null and is in its proper state, the unmapped
- *     stack is not null and is in its proper state, and that counter is 
- *     not null
+ *     the segment table is not null and is in its proper state, and that
+ *     counter is not null
  * 
  * Notes:
- *     if the opcode is not within range or the word doesn't represent a 
- *     valid instruction, the UM is allowed to fail. This function is called
- *     within our um.c.
+ *     opcodes 14 and 15 are not instructions: the output is flushed and
+ *     the UM fails with the same report as the threaded core in engine.c,
+ *     so that the two engines agree. This function is called within our
+ *     um.c.
  *    
  ************************/
 void execute_instruction(uint32_t opcode, uint32_t word, uint32_t *registers, 
-                        Seq_T ids, Stack_T unmapped, uint32_t *counter) 
+                        struct segment_table *table, uint32_t *counter,
+                        struct input *in, struct output *out)
 {
         if (opcode != 12) {
                 (*counter) ++; /* increments counter for each execution of the 
@@ -547,9 +541,9 @@ void execute_instruction(uint32_t opcode, uint32_t word, uint32_t *registers,
                 if (opcode == 0) {
                         instruction_0(ra, rb, rc, registers);
                 } if (opcode == 1) {
-                        instruction_1(ra, rb, rc, registers, &ids);       
+                        instruction_1(ra, rb, rc, registers, table);       
                 }  if (opcode == 2) {
-                        instruction_2(ra, rb, rc, registers, &ids);          
+                        instruction_2(ra, rb, rc, registers, table);          
                 }  if (opcode == 3) {
                         instruction_3(ra, rb, rc, registers);           
                 }  if (opcode == 4) {
@@ -559,15 +553,20 @@ void execute_instruction(uint32_t opcode, uint32_t word, uint32_t *registers,
                 }  if (opcode == 6) {
                         instruction_6(ra, rb, rc, registers);              
                 }  if (opcode == 8) {
-                        instruction_8(rb, rc, registers, &unmapped, &ids);
+                        instruction_8(rb, rc, registers, table, out);
                 }  if (opcode == 9) {
-                        instruction_9(rc, registers, &unmapped, &ids); 
+                        instruction_9(rc, registers, table); 
                 }  if (opcode == 10) {
-                        instruction_10(rc, registers);                    
+                        instruction_10(rc, registers, out);                    
                 }  if (opcode == 11) {
-                        instruction_11(rc, registers);                   
+                        instruction_11(rc, registers, in, out);
                 }  if (opcode == 12) {
-                        instruction_12(rb, rc, registers, &ids, counter); 
+                        instruction_12(rb, rc, registers, table, counter, out);
+                }  if (opcode > 13) {
+                        output_flush(out);
+                        fprintf(stderr, "um: invalid opcode %u at %u\n",
+                                opcode, *counter - 1);
+                        exit(EXIT_FAILURE);
                 }
         }       
 }
\ No newline at end of file
@@ -2,11 +2,11 @@
 #define INSTRUCTIONS_INCLUDED
 #include <stdbool.h>
 #include <stdint.h>
-#include "stack.h"
-#include "seq.h"
 #include "memory.h"
+#include "io.h"
 
 void execute_instruction(uint32_t opcode, uint32_t word, uint32_t *registers,
- Seq_T ids, Stack_T unmapped, uint32_t *counter);
+ struct segment_table *table, uint32_t *counter, struct input *in,
+ struct output *out);
 
  #endif
\ No newline at end of file
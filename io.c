@@ -0,0 +1,227 @@
+/*
+ *     io.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: io.c contains the implementation of the I/O device defined
+ *     in io.h.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "io.h"
+
+/********** output_init ********
+ *
+ * Function that sets up an empty output buffer
+ *
+ * Parameters:
+ *      struct output *out:   the output buffer
+ *      int fd:               the file descriptor to write to
+ *      bool line_buffered:   whether every newline flushes
+ *
+ * Return: void
+ ************************/
+void output_init(struct output *out, int fd, bool line_buffered)
+{
+        assert(out != NULL);
+        out->fd = fd;
+        out->write = NULL;
+        out->closure = NULL;
+        out->line_buffered = line_buffered;
+        out->used = 0;
+        out->bytes = 0;
+        out->writes = 0;
+}
+
+/********** output_init_callback ********
+ *
+ * Function that sets up an empty output buffer that is flushed by calling
+ * write
+ *
+ * Parameters:
+ *      struct output *out:   the output buffer
+ *      output_fn write:      called with the bytes of every flush
+ *      void *closure:        passed to write
+ *      bool line_buffered:   whether every newline flushes
+ *
+ * Return: void
+ ************************/
+void output_init_callback(struct output *out, output_fn write,
+                          void *closure, bool line_buffered)
+{
+        assert(write != NULL);
+        output_init(out, -1, line_buffered);
+        out->write = write;
+        out->closure = closure;
+}
+
+/********** output_flush ********
+ *
+ * Function that writes every buffered byte to the file descriptor, or
+ * hands them to the write callback
+ *
+ * Parameters:
+ *      struct output *out:   the output buffer
+ *
+ * Return: void
+ *
+ * Notes:
+ *     like stdio, a write error drops the buffered bytes rather than
+ *     stopping the UM
+ ************************/
+void output_flush(struct output *out)
+{
+        if (out->write != NULL) {
+                if (out->used > 0) {
+                        out->write(out->closure, out->buffer, out->used);
+                        out->writes++;
+                }
+                out->bytes += out->used;
+                out->used = 0;
+                return;
+        }
+        size_t done = 0;
+        while (done < out->used) {
+                ssize_t wrote = write(out->fd, out->buffer + done,
+                                      out->used - done);
+                if (wrote < 0 && errno == EINTR) {
+                        continue;
+                }
+                out->writes++;
+                if (wrote < 0) {
+                        break;
+                }
+                done += wrote;
+        }
+        out->bytes += out->used;
+        out->used = 0;
+}
+
+/********** input_init ********
+ *
+ * Function that sets up the input from a file descriptor, mapping the rest
+ * of it into memory if it is a regular file
+ *
+ * Parameters:
+ *      struct input *in:     the input buffer
+ *      int fd:               the file descriptor to read from
+ *
+ * Return: void
+ *
+ * Notes:
+ *     input starts at the descriptor's current offset, as it would with
+ *     read(). If the file cannot be mapped it is read like a pipe.
+ ************************/
+void input_init(struct input *in, int fd)
+{
+        assert(in != NULL);
+        in->fd = fd;
+        in->read = NULL;
+        in->closure = NULL;
+        in->next = in->buffer;
+        in->end = in->buffer;
+        in->mapping = NULL;
+        in->mapped_size = 0;
+        in->ended = false;
+        in->bytes = 0;
+        in->reads = 0;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+                return;
+        }
+        off_t offset = lseek(fd, 0, SEEK_CUR);
+        if (offset < 0 || offset >= info.st_size) {
+                return;
+        }
+        void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd,
+                             0);
+        if (mapping == MAP_FAILED) {
+                return;
+        }
+        madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+        in->mapping = mapping;
+        in->mapped_size = info.st_size;
+        in->next = in->mapping + offset;
+        in->end = in->mapping + info.st_size;
+        in->ended = true; /* the mapping is all there is to read */
+}
+
+/********** input_init_callback ********
+ *
+ * Function that sets up the input to come from calls to read
+ *
+ * Parameters:
+ *      struct input *in:     the input buffer
+ *      input_fn read:        called for each chunk of input
+ *      void *closure:        passed to read
+ *
+ * Return: void
+ ************************/
+void input_init_callback(struct input *in, input_fn read, void *closure)
+{
+        assert(read != NULL);
+        input_init(in, -1); /* no file, so nothing is mapped */
+        in->read = read;
+        in->closure = closure;
+}
+
+/********** input_refill ********
+ *
+ * Function that reads the next chunk of input once the buffer is empty
+ *
+ * Parameters:
+ *      struct input *in:     the input buffer, with no unread bytes
+ *
+ * Return: the next input byte, or INPUT_EOF if the input has ended
+ *
+ * Notes:
+ *     a read error ends the input, as it would for getc()
+ ************************/
+uint32_t input_refill(struct input *in)
+{
+        while (!in->ended) {
+                ssize_t got;
+                if (in->read != NULL) {
+                        got = in->read(in->closure, in->buffer,
+                                       INPUT_BUFFER_SIZE);
+                } else {
+                        got = read(in->fd, in->buffer, INPUT_BUFFER_SIZE);
+                }
+                if (got < 0 && errno == EINTR) {
+                        continue;
+                }
+                in->reads++;
+                if (got <= 0) {
+                        in->ended = true;
+                        break;
+                }
+                in->next = in->buffer;
+                in->end = in->buffer + got;
+                return input_byte(in);
+        }
+        return INPUT_EOF;
+}
+
+/********** input_close ********
+ *
+ * Function that unmaps the input file, if it was mapped
+ *
+ * Parameters:
+ *      struct input *in:     the input buffer
+ *
+ * Return: void
+ ************************/
+void input_close(struct input *in)
+{
+        if (in->mapping != NULL) {
+                munmap(in->mapping, in->mapped_size);
+                in->mapping = NULL;
+        }
+        in->next = in->end;
+}
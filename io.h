@@ -0,0 +1,112 @@
+/*
+ *     io.h
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: io.h defines the UM's I/O device. Output bytes collect in a
+ *              large buffer that is written to the file descriptor with one
+ *              write() when it fills, before an input instruction has to
+ *              wait for more input (so a prompt is on screen before the
+ *              program waits for an answer) and when the program stops.
+ *              In line-buffered mode, meant for a terminal, every newline
+ *              also flushes.
+ *
+ *              Input comes from a buffer too. A regular file is memory-
+ *              mapped whole, so an input instruction is a bounds check and
+ *              a pointer bump; anything else (a pipe, a terminal) is read
+ *              in chunks of up to INPUT_BUFFER_SIZE bytes, each read()
+ *              returning whatever is available, so a terminal still works
+ *              a line at a time.
+ *
+ *              Either side can be given a callback in place of a file
+ *              descriptor, for a UM embedded in another program (see
+ *              um_vm.h).
+ */
+
+#ifndef IO_INCLUDED
+#define IO_INCLUDED
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define OUTPUT_BUFFER_SIZE ((size_t)1 << 16)    /* bytes */
+#define INPUT_BUFFER_SIZE ((size_t)1 << 16)     /* bytes */
+
+/* what an input instruction reads once the input has ended */
+#define INPUT_EOF UINT32_MAX
+
+/* takes count flushed output bytes */
+typedef void (*output_fn)(void *closure, const uint8_t *bytes, size_t count);
+
+/* puts up to size input bytes in buffer; returns how many, 0 at the end */
+typedef size_t (*input_fn)(void *closure, uint8_t *buffer, size_t size);
+
+struct output {
+        int fd;                         /* where flushed bytes go */
+        output_fn write;                /* or, if not NULL, where they go */
+        void *closure;                  /* passed to write */
+        bool line_buffered;             /* flush on every newline */
+        size_t used;                    /* bytes waiting in buffer */
+        uint64_t bytes;                 /* bytes output so far */
+        uint64_t writes;                /* write() calls so far */
+        uint8_t buffer[OUTPUT_BUFFER_SIZE];
+};
+
+struct input {
+        int fd;                         /* where unread bytes come from */
+        input_fn read;                  /* or, if not NULL, where they come */
+        void *closure;                  /* passed to read */
+        const uint8_t *next;            /* next unread byte */
+        const uint8_t *end;             /* end of the unread bytes */
+        uint8_t *mapping;               /* the mapped file, or NULL */
+        size_t mapped_size;             /* bytes in mapping */
+        bool ended;                     /* fd has nothing more */
+        uint64_t bytes;                 /* bytes input so far */
+        uint64_t reads;                 /* read() calls so far */
+        uint8_t buffer[INPUT_BUFFER_SIZE];
+};
+
+void output_init(struct output *out, int fd, bool line_buffered);
+
+void output_init_callback(struct output *out, output_fn write,
+                          void *closure, bool line_buffered);
+
+void output_flush(struct output *out);
+
+/********** output_byte ********
+ *
+ * Function that outputs one byte, flushing if the buffer fills or, in
+ * line-buffered mode, if the byte is a newline
+ ************************/
+static inline void output_byte(struct output *out, uint8_t byte)
+{
+        out->buffer[out->used++] = byte;
+        if (out->used == OUTPUT_BUFFER_SIZE ||
+            (out->line_buffered && byte == '\n')) {
+                output_flush(out);
+        }
+}
+
+void input_init(struct input *in, int fd);
+
+void input_init_callback(struct input *in, input_fn read, void *closure);
+
+uint32_t input_refill(struct input *in);
+
+void input_close(struct input *in);
+
+/********** input_byte ********
+ *
+ * Returns the next input byte, or INPUT_EOF once the input has ended
+ ************************/
+static inline uint32_t input_byte(struct input *in)
+{
+        if (in->next < in->end) {
+                in->bytes++;
+                return *in->next++;
+        }
+        return input_refill(in);
+}
+
+#endif
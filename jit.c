@@ -0,0 +1,961 @@
+/*
+ *     jit.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: jit.c contains the implementation of run_jit(). A block is
+ *     the run of instructions from an entry point up to and including the
+ *     next load program, stopping short of a halt or an invalid opcode, and
+ *     at most JIT_MAX_BLOCK instructions long. The only control transfer in
+ *     the UM is load program, so a block always runs straight through
+ *     unless a store changes segment 0 under it.
+ *
+ *     The code cache is never writable and executable at once. It is
+ *     mapped read-write, and compile_block() opens only the pages it is
+ *     about to write, then makes them read-execute again before anything
+ *     runs. No code is patched after that: a jump between blocks goes
+ *     through the slot table. If the pages cannot be switched, compiled
+ *     code is dropped and the rest of the run stays on the interpreting
+ *     tier.
+ *
+ *     A compiled block is a function taking the jit_context and returning
+ *     the next program counter. Its registers live in host registers
+ *     between calls into C; around every call they are spilled to
+ *     context->r and reloaded, so the C side only ever sees context->r.
+ *     Output and input go through the io.h buffers inline, calling C only
+ *     to flush or refill them. A load program with $r[B] = 0 (a jump
+ *     within segment 0) jumps straight into the body of the target's
+ *     compiled block if it has one, so a hot loop never leaves machine code.
+ *
+ *     With check set, every run of a compiled block whose instructions have
+ *     no side effects (everything but store, map, unmap and I/O) is first
+ *     replayed on a copy of the registers by execute_instruction(), and the
+ *     registers, instruction count and next program counter of the two are
+ *     compared.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include "jit.h"
+#include "engine.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <sys/mman.h>
+#include "instructions.h"
+#include "Word.h"
+
+#define JIT_HOT 16                              /* entries before compiling */
+#define JIT_MAX_BLOCK 1024                      /* instructions */
+#define JIT_MAX_INSTRUCTION_BYTES 256           /* machine code, worst case */
+#define JIT_CODE_SIZE ((size_t)32 << 20)        /* bytes of code cache */
+
+struct jit_context;
+typedef uint32_t (*block_fn)(struct jit_context *context);
+
+/* what the dispatcher knows about one entry point of segment 0 */
+struct jit_slot {
+        block_fn entry;                 /* compiled block, or NULL */
+        uint8_t *body;                  /* entry, past the prologue */
+        uint32_t heat;                  /* entries while not compiled */
+        uint32_t end;                   /* one past the block's last */
+        bool pure;                      /* no side effects: checkable */
+};
+
+struct jit {
+        uint8_t *code;                  /* the code cache */
+        size_t code_used;
+        size_t page;                    /* host page size */
+        bool compiling;                 /* false once mprotect() fails */
+        struct jit_slot *slots;         /* indexed by program counter */
+        uint8_t *covered;               /* nonzero if compiled into a block */
+        uint32_t *starts;               /* entry points of compiled blocks */
+        uint32_t block_count;
+        uint32_t length;                /* size of segment 0 */
+        bool chain;                     /* jump between blocks directly */
+        uint64_t generation;            /* of segment 0 when compiled */
+        struct jit_stats *stats;
+};
+
+/* everything a compiled block or its helper calls can reach */
+struct jit_context {
+        uint32_t r[8];                  /* registers, outside host code */
+        uint32_t next_pc;               /* set by a load program helper */
+        uint64_t count;                 /* instructions executed */
+        struct segment_table *table;
+        struct input *in;
+        struct output *out;
+        struct jit *jit;
+};
+
+/* x86-64 register numbers */
+enum { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6,
+       RDI = 7, R8 = 8, R9 = 9, R10 = 10, R12 = 12, R13 = 13, R14 = 14,
+       R15 = 15 };
+
+/*
+ * the host register that holds each UM register inside compiled code. RBX
+ * holds the jit_context; RAX, RCX and RDX are scratch
+ */
+static const unsigned host[8] = { RBP, R12, R13, R14, R15, R8, R9, R10 };
+
+/* condition codes for emit_jump */
+enum { CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_A = 0x7 };
+
+/********** emitter helpers ********
+ *
+ * Each appends one x86-64 instruction (or a piece of one) at *p. Register
+ * operands are 0-15 and all arithmetic is 32 bit unless wide is set.
+ ************************/
+static void emit_byte(uint8_t **p, uint8_t byte)
+{
+        *(*p)++ = byte;
+}
+
+static void emit_u32(uint8_t **p, uint32_t value)
+{
+        memcpy(*p, &value, sizeof(value));
+        *p += sizeof(value);
+}
+
+static void emit_u64(uint8_t **p, uint64_t value)
+{
+        memcpy(*p, &value, sizeof(value));
+        *p += sizeof(value);
+}
+
+static void emit_rex(uint8_t **p, bool wide, unsigned reg, unsigned index,
+                     unsigned base)
+{
+        uint8_t rex = 0x40 | wide << 3 | (reg >> 3) << 2 | (index >> 3) << 1 |
+                      base >> 3;
+        if (rex != 0x40) {
+                emit_byte(p, rex);
+        }
+}
+
+static void emit_opcode(uint8_t **p, unsigned opcode)
+{
+        if (opcode > 0xFF) { /* two-byte opcode, 0x0F xx */
+                emit_byte(p, opcode >> 8);
+        }
+        emit_byte(p, opcode & 0xFF);
+}
+
+/* op reg, rm with both operands registers */
+static void emit_rr(uint8_t **p, bool wide, unsigned opcode, unsigned reg,
+                    unsigned rm)
+{
+        emit_rex(p, wide, reg, 0, rm);
+        emit_opcode(p, opcode);
+        emit_byte(p, 0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+/* op reg, [base + disp] */
+static void emit_mem(uint8_t **p, bool wide, unsigned opcode, unsigned reg,
+                     unsigned base, uint32_t disp)
+{
+        emit_rex(p, wide, reg, 0, base);
+        emit_opcode(p, opcode);
+        emit_byte(p, 0x80 | (reg & 7) << 3 | (base & 7));
+        if ((base & 7) == RSP) {
+                emit_byte(p, 0x24);
+        }
+        emit_u32(p, disp);
+}
+
+/* op reg, [base + index << scale + disp], where base is not RBP or R13 */
+static void emit_sib(uint8_t **p, bool wide, unsigned opcode, unsigned reg,
+                     unsigned base, unsigned index, unsigned scale,
+                     uint32_t disp)
+{
+        emit_rex(p, wide, reg, index, base);
+        emit_opcode(p, opcode);
+        emit_byte(p, (disp != 0 ? 0x80 : 0) | (reg & 7) << 3 | 4);
+        emit_byte(p, scale << 6 | (index & 7) << 3 | (base & 7));
+        if (disp != 0) {
+                emit_u32(p, disp);
+        }
+}
+
+static void emit_mov_imm32(uint8_t **p, unsigned reg, uint32_t value)
+{
+        emit_rex(p, false, 0, 0, reg);
+        emit_byte(p, 0xB8 + (reg & 7));
+        emit_u32(p, value);
+}
+
+static void emit_mov_imm64(uint8_t **p, unsigned reg, uint64_t value)
+{
+        emit_rex(p, true, 0, 0, reg);
+        emit_byte(p, 0xB8 + (reg & 7));
+        emit_u64(p, value);
+}
+
+static void emit_push(uint8_t **p, unsigned reg)
+{
+        emit_rex(p, false, 0, 0, reg);
+        emit_byte(p, 0x50 + (reg & 7));
+}
+
+static void emit_pop(uint8_t **p, unsigned reg)
+{
+        emit_rex(p, false, 0, 0, reg);
+        emit_byte(p, 0x58 + (reg & 7));
+}
+
+/* jump (cc == 0) or conditional jump to a target patched in later */
+static uint8_t *emit_jump(uint8_t **p, unsigned cc)
+{
+        if (cc == 0) {
+                emit_byte(p, 0xE9);
+        } else {
+                emit_byte(p, 0x0F);
+                emit_byte(p, 0x80 | cc);
+        }
+        uint8_t *rel = *p;
+        emit_u32(p, 0);
+        return rel;
+}
+
+static void patch_jump(uint8_t *rel, const uint8_t *target)
+{
+        int32_t offset = target - (rel + 4);
+        memcpy(rel, &offset, sizeof(offset));
+}
+
+/* mov [rbx + context->r[i]], host[i] for every register */
+static void emit_spill(uint8_t **p)
+{
+        for (unsigned i = 0; i < 8; i++) {
+                emit_mem(p, false, 0x89, host[i], RBX,
+                         offsetof(struct jit_context, r) + 4 * i);
+        }
+}
+
+/* mov host[i], [rbx + context->r[i]] for every register */
+static void emit_reload(uint8_t **p)
+{
+        for (unsigned i = 0; i < 8; i++) {
+                emit_mem(p, false, 0x8B, host[i], RBX,
+                         offsetof(struct jit_context, r) + 4 * i);
+        }
+}
+
+/********** emit_exit ********
+ *
+ * Emits a return from the block to the dispatcher, after count of its
+ * instructions have run, with the next program counter next or, if
+ * next_from_context is set, context->next_pc
+ ************************/
+static void emit_exit(uint8_t **p, const uint8_t *epilogue, uint32_t count,
+                      uint32_t next, bool next_from_context)
+{
+        emit_mem(p, true, 0x81, 0, RBX, offsetof(struct jit_context, count));
+        emit_u32(p, count);
+        if (next_from_context) {
+                emit_mem(p, false, 0x8B, RAX, RBX,
+                         offsetof(struct jit_context, next_pc));
+        } else {
+                emit_mov_imm32(p, RAX, next);
+        }
+        patch_jump(emit_jump(p, 0), epilogue);
+}
+
+/********** plain_instruction ********
+ *
+ * Returns the pre-decoded instruction at pc as the plain UM instruction it
+ * starts with. Both tiers run superinstructions one instruction at a time.
+ ************************/
+static struct instruction plain_instruction(const struct segment_table *table,
+                                            uint32_t pc)
+{
+        struct instruction ins = table->program[pc];
+        ins.opcode = plain_opcode(ins.opcode);
+        return ins;
+}
+
+/********** jit_flush ********
+ *
+ * Function that throws away every compiled block. Blocks that were compiled
+ * start cold again, so code that keeps rewriting itself is not recompiled
+ * on every entry.
+ ************************/
+static void jit_flush(struct jit *jit)
+{
+        for (uint32_t i = 0; i < jit->block_count; i++) {
+                struct jit_slot *slot = &jit->slots[jit->starts[i]];
+                memset(&jit->covered[jit->starts[i]], 0,
+                       slot->end - jit->starts[i]);
+                memset(slot, 0, sizeof(*slot));
+        }
+        jit->block_count = 0;
+        jit->code_used = 0;
+        jit->stats->flushes++;
+}
+
+/********** jit_reset ********
+ *
+ * Function that drops all compiled code and per-instruction state and
+ * sizes it for the current segment 0
+ ************************/
+static void jit_reset(struct jit *jit, struct segment_table *table)
+{
+        if (jit->block_count > 0) {
+                jit->stats->flushes++;
+        }
+        free(jit->slots);
+        free(jit->covered);
+        free(jit->starts);
+        jit->length = table->segments[0].size;
+        jit->generation = table->generation;
+        jit->slots = calloc((size_t)jit->length + 1, sizeof(struct jit_slot));
+        jit->covered = calloc((size_t)jit->length + 1, 1);
+        jit->starts = malloc(((size_t)jit->length + 1) * sizeof(uint32_t));
+        assert(jit->slots != NULL && jit->covered != NULL &&
+               jit->starts != NULL);
+        jit->block_count = 0;
+        jit->code_used = 0;
+}
+
+/********** jit_protect ********
+ *
+ * Function that sets the protection of the pages of the code cache that
+ * hold bytes from to to - 1
+ *
+ * Return: true, or false if mprotect() failed
+ ************************/
+static bool jit_protect(struct jit *jit, size_t from, size_t to, int prot)
+{
+        size_t first = from / jit->page * jit->page;
+        size_t last = (to + jit->page - 1) / jit->page * jit->page;
+        return mprotect(jit->code + first, last - first, prot) == 0;
+}
+
+/********** jit_store ********
+ *
+ * Function that runs a store instruction for either tier, and drops the
+ * compiled code if the store changed an instruction it covers
+ *
+ * Return: true if compiled code was dropped
+ ************************/
+static bool jit_store(struct jit_context *context, uint32_t ra, uint32_t rb,
+                      uint32_t rc)
+{
+        uint32_t id = context->r[ra];
+        uint32_t offset = context->r[rb];
+        store_memory(ra, rb, rc, context->r, context->table);
+        if (id == 0 && context->jit->covered[offset]) {
+                jit_flush(context->jit);
+                return true;
+        }
+        return false;
+}
+
+/********** over_cap ********
+ *
+ * Reports a map or load program the segment caps refused and fails, as
+ * run_engine() does
+ ************************/
+static void over_cap(struct jit_context *context)
+{
+        output_flush(context->out);
+        report_cap(context->table);
+        exit(EXIT_FAILURE);
+}
+
+/********** jit_load_program ********
+ *
+ * Function that runs a load program instruction for either tier, and
+ * resets the JIT if segment 0 was replaced
+ *
+ * Return: the new program counter
+ ************************/
+static uint32_t jit_load_program(struct jit_context *context, uint32_t rb,
+                                 uint32_t rc)
+{
+        uint32_t pc;
+        if (!load_program(rb, rc, context->r, context->table, &pc)) {
+                over_cap(context);
+        }
+        if (context->table->generation != context->jit->generation) {
+                jit_reset(context->jit, context->table);
+        }
+        return pc;
+}
+
+/********** input_instruction ********
+ *
+ * Returns the next input byte, flushing output first if it has to wait
+ ************************/
+static uint32_t input_instruction(struct jit_context *context)
+{
+        if (context->in->next == context->in->end) {
+                output_flush(context->out);
+        }
+        return input_byte(context->in);
+}
+
+/********** invalid_opcode ********
+ *
+ * Reports an invalid instruction and fails, as run_engine() does
+ ************************/
+static void invalid_opcode(struct jit_context *context, unsigned opcode,
+                           uint32_t pc)
+{
+        output_flush(context->out);
+        fprintf(stderr, "um: invalid opcode %u at %u\n", opcode, pc);
+        exit(EXIT_FAILURE);
+}
+
+/********** jit_helper ********
+ *
+ * Function that compiled code calls to run the instruction at pc with the
+ * registers in context->r: a store that may touch segment 0, map, unmap,
+ * input once the buffer is empty, or a load program that may replace
+ * segment 0. For output, which compiled code has already put in the
+ * buffer, it flushes the buffer.
+ *
+ * Return: nonzero if the block must return to the dispatcher, because
+ *         compiled code was dropped or control was transferred (then the
+ *         next program counter is in context->next_pc)
+ ************************/
+static uint32_t jit_helper(struct jit_context *context, uint32_t pc)
+{
+        struct instruction ins = plain_instruction(context->table, pc);
+        uint32_t *r = context->r;
+        switch (ins.opcode) {
+        case 2:
+                return jit_store(context, ins.ra, ins.rb, ins.rc);
+        case 8:
+                if (!map_segment(ins.rb, ins.rc, r, context->table)) {
+                        over_cap(context);
+                }
+                return 0;
+        case 9:
+                unmap_segment(ins.rc, r, context->table);
+                return 0;
+        case 10:
+                output_flush(context->out);
+                return 0;
+        case 11:
+                r[ins.rc] = input_instruction(context);
+                return 0;
+        case 12:
+                context->next_pc = jit_load_program(context, ins.rb, ins.rc);
+                return 1;
+        }
+        assert(0);
+        return 1;
+}
+
+/********** emit_instruction ********
+ *
+ * Emits the machine code for the instruction at pc, the index-th of its
+ * block
+ ************************/
+static void emit_instruction(uint8_t **p, const uint8_t *epilogue,
+                             struct jit_context *context, uint32_t pc,
+                             uint32_t index)
+{
+        struct instruction ins = plain_instruction(context->table, pc);
+        unsigned a = host[ins.ra], b = host[ins.rb], c = host[ins.rc];
+        uint64_t table = (uintptr_t)context->table;
+        struct jit *jit = context->jit;
+        uint8_t *skip, *slow, *slow_line;
+        uint8_t *done[2] = { NULL, NULL };
+
+        switch (ins.opcode) {
+        case 0: /* conditional move */
+                if (ins.ra != ins.rb) {
+                        emit_rr(p, false, 0x85, c, c);          /* test */
+                        emit_rr(p, false, 0x0F45, a, b);        /* cmovne */
+                }
+                return;
+        case 1: /* segmented load */
+                emit_mov_imm64(p, RAX, table);
+                emit_mem(p, true, 0x8B, RAX, RAX,
+                         offsetof(struct segment_table, segments));
+                emit_rr(p, false, 0x8B, RCX, b);
+                emit_rr(p, true, 0xC1, 4, RCX);                 /* shl */
+                emit_byte(p, 4);
+                emit_sib(p, true, 0x8B, RAX, RAX, RCX, 0, 0);
+                emit_rr(p, false, 0x8B, RCX, c);
+                emit_sib(p, false, 0x8B, a, RAX, RCX, 2, 0);
+                return;
+        case 2: /* segmented store; segment 0 and a shared one go to C */
+                emit_rr(p, false, 0x85, a, a);
+                slow = emit_jump(p, CC_E);
+                emit_mov_imm64(p, RAX, table);
+                emit_mem(p, false, 0x3B, a, RAX,
+                         offsetof(struct segment_table, shared_with));
+                skip = emit_jump(p, CC_E);
+                emit_mem(p, true, 0x8B, RAX, RAX,
+                         offsetof(struct segment_table, segments));
+                emit_rr(p, false, 0x8B, RCX, a);
+                emit_rr(p, true, 0xC1, 4, RCX);
+                emit_byte(p, 4);
+                emit_sib(p, true, 0x8B, RAX, RAX, RCX, 0, 0);
+                emit_rr(p, false, 0x8B, RCX, b);
+                emit_sib(p, false, 0x89, c, RAX, RCX, 2, 0);
+                done[0] = emit_jump(p, 0);
+                patch_jump(slow, *p);
+                patch_jump(skip, *p);
+                break; /* to the helper call */
+        case 3: /* addition */
+                emit_rr(p, false, 0x8B, RAX, b);
+                emit_rr(p, false, 0x03, RAX, c);
+                emit_rr(p, false, 0x8B, a, RAX);
+                return;
+        case 4: /* multiplication */
+                emit_rr(p, false, 0x8B, RAX, b);
+                emit_rr(p, false, 0x0FAF, RAX, c);
+                emit_rr(p, false, 0x8B, a, RAX);
+                return;
+        case 5: /* division */
+                emit_rr(p, false, 0x8B, RAX, b);
+                emit_rr(p, false, 0x33, RDX, RDX);              /* xor */
+                emit_rr(p, false, 0xF7, 6, c);                  /* div */
+                emit_rr(p, false, 0x8B, a, RAX);
+                return;
+        case 6: /* bitwise NAND */
+                emit_rr(p, false, 0x8B, RAX, b);
+                emit_rr(p, false, 0x23, RAX, c);
+                emit_rr(p, false, 0xF7, 2, RAX);                /* not */
+                emit_rr(p, false, 0x8B, a, RAX);
+                return;
+        case 13: /* load value */
+                emit_mov_imm32(p, host[ins.ra], ins.value);
+                return;
+        case 10: /* output into the buffer; flush it in C when full */
+                emit_rr(p, false, 0x81, 7, c);                  /* cmp */
+                emit_u32(p, 255);
+                done[1] = emit_jump(p, CC_A);
+                emit_mov_imm64(p, RAX, (uintptr_t)context->out);
+                emit_mem(p, true, 0x8B, RCX, RAX,
+                         offsetof(struct output, used));
+                emit_rr(p, false, 0x8B, RDX, c);
+                emit_sib(p, false, 0x88, RDX, RAX, RCX, 0,
+                         offsetof(struct output, buffer));
+                emit_rr(p, true, 0xFF, 0, RCX);                 /* inc */
+                emit_mem(p, true, 0x89, RCX, RAX,
+                         offsetof(struct output, used));
+                emit_rr(p, true, 0x81, 7, RCX);
+                emit_u32(p, OUTPUT_BUFFER_SIZE);
+                slow = emit_jump(p, CC_E);
+                slow_line = NULL;
+                if (context->out->line_buffered) {
+                        emit_rr(p, false, 0x83, 7, RDX);
+                        emit_byte(p, '\n');
+                        slow_line = emit_jump(p, CC_E);
+                }
+                done[0] = emit_jump(p, 0);
+                patch_jump(slow, *p);
+                if (slow_line != NULL) {
+                        patch_jump(slow_line, *p);
+                }
+                break;
+        case 11: /* input from the buffer; refill it in C when empty */
+                emit_mov_imm64(p, RAX, (uintptr_t)context->in);
+                emit_mem(p, true, 0x8B, RCX, RAX,
+                         offsetof(struct input, next));
+                emit_mem(p, true, 0x3B, RCX, RAX,
+                         offsetof(struct input, end));
+                slow = emit_jump(p, CC_AE);
+                emit_mem(p, false, 0x0FB6, c, RCX, 0);          /* movzx */
+                emit_rr(p, true, 0xFF, 0, RCX);
+                emit_mem(p, true, 0x89, RCX, RAX,
+                         offsetof(struct input, next));
+                emit_mem(p, true, 0xFF, 0, RAX,
+                         offsetof(struct input, bytes));
+                done[0] = emit_jump(p, 0);
+                patch_jump(slow, *p);
+                break;
+        case 12: /* a jump within segment 0 stays in compiled code */
+                emit_rr(p, false, 0x85, b, b);
+                slow = emit_jump(p, CC_NE);
+                emit_rr(p, false, 0x8B, RAX, c);
+                emit_mem(p, true, 0x81, 0, RBX,
+                         offsetof(struct jit_context, count));
+                emit_u32(p, index + 1);
+                if (jit->chain) {
+                        emit_mov_imm64(p, RCX, (uintptr_t)&jit->length);
+                        emit_mem(p, false, 0x3B, RAX, RCX, 0);
+                        skip = emit_jump(p, CC_AE);
+                        emit_mov_imm64(p, RCX, (uintptr_t)&jit->slots);
+                        emit_mem(p, true, 0x8B, RCX, RCX, 0);
+                        emit_rr(p, false, 0x8B, RDX, RAX);
+                        emit_rr(p, true, 0xC1, 4, RDX);         /* shl */
+                        emit_byte(p, 5);
+                        emit_sib(p, true, 0x8B, RCX, RCX, RDX, 0,
+                                 offsetof(struct jit_slot, body));
+                        emit_rr(p, true, 0x85, RCX, RCX);
+                        slow_line = emit_jump(p, CC_E);
+                        emit_rr(p, false, 0xFF, 4, RCX);        /* jmp */
+                        patch_jump(skip, *p);
+                        patch_jump(slow_line, *p);
+                }
+                patch_jump(emit_jump(p, 0), epilogue);
+                patch_jump(slow, *p);
+                break;
+        default: /* map, unmap */
+                break;
+        }
+
+        emit_spill(p);
+        emit_rr(p, true, 0x89, RBX, RDI);                       /* mov */
+        emit_mov_imm32(p, RSI, pc);
+        emit_mov_imm64(p, RAX, (uintptr_t)jit_helper);
+        emit_rr(p, false, 0xFF, 2, RAX);                        /* call */
+        emit_reload(p);
+        if (ins.opcode == 12) {
+                emit_exit(p, epilogue, index + 1, 0, true);
+        } else {
+                emit_rr(p, false, 0x85, RAX, RAX);
+                skip = emit_jump(p, CC_E);
+                emit_exit(p, epilogue, index + 1, pc + 1, false);
+                patch_jump(skip, *p);
+        }
+        for (int i = 0; i < 2; i++) {
+                if (done[i] != NULL) {
+                        patch_jump(done[i], *p);
+                }
+        }
+}
+
+/********** ends_block ********
+ *
+ * Returns whether an opcode cannot be part of a block: halt and the invalid
+ * opcodes are left to the interpreter
+ ************************/
+static bool ends_block(unsigned opcode)
+{
+        return opcode == 7 || opcode > 13;
+}
+
+/********** compile_block ********
+ *
+ * Function that compiles the block entered at start, if there is one
+ *
+ * Parameters:
+ *      struct jit_context *context: the context, whose jit gets the block
+ *      uint32_t start:       the entry point, which is in segment 0
+ *
+ * Return: void
+ *
+ * Notes:
+ *     the pages written are writable only while it runs; if they cannot
+ *     be made writable or executable again, every compiled block is
+ *     dropped and nothing more is compiled.
+ *
+ *     the code is laid out as the epilogue (store the registers and return)
+ *     followed by the entry point, so every exit is a jump back. Every
+ *     block's frame is the same, so a jump from one block into another's
+ *     body returns through the first block's epilogue.
+ ************************/
+static void compile_block(struct jit_context *context, uint32_t start)
+{
+        struct jit *jit = context->jit;
+        const struct segment_table *table = context->table;
+        uint32_t end = start;
+        bool pure = true;
+        while (end - start < JIT_MAX_BLOCK &&
+               !ends_block(plain_instruction(table, end).opcode)) {
+                unsigned opcode = plain_instruction(table, end++).opcode;
+                if (opcode == 2 || (opcode >= 8 && opcode <= 11)) {
+                        pure = false;
+                } else if (opcode == 12) {
+                        break;
+                }
+        }
+        if (end == start) {
+                return;
+        }
+        size_t worst = (size_t)(end - start + 2) * JIT_MAX_INSTRUCTION_BYTES;
+        if (JIT_CODE_SIZE - jit->code_used < worst) {
+                jit_flush(jit);
+        }
+        size_t from = jit->code_used;
+        if (!jit_protect(jit, from, from + worst, PROT_READ | PROT_WRITE)) {
+                goto unprotected;
+        }
+
+        uint8_t *base = jit->code + jit->code_used;
+        uint8_t *p = base;
+
+        const uint8_t *epilogue = p;
+        emit_spill(&p);
+        emit_rr(&p, true, 0x83, 0, RSP);                        /* add */
+        emit_byte(&p, 8);
+        emit_pop(&p, R15);
+        emit_pop(&p, R14);
+        emit_pop(&p, R13);
+        emit_pop(&p, R12);
+        emit_pop(&p, RBP);
+        emit_pop(&p, RBX);
+        emit_byte(&p, 0xC3);                                    /* ret */
+
+        uint8_t *entry = p;
+        emit_push(&p, RBX);
+        emit_push(&p, RBP);
+        emit_push(&p, R12);
+        emit_push(&p, R13);
+        emit_push(&p, R14);
+        emit_push(&p, R15);
+        emit_rr(&p, true, 0x83, 5, RSP);                        /* sub */
+        emit_byte(&p, 8);
+        emit_rr(&p, true, 0x89, RDI, RBX);
+        emit_reload(&p);
+        uint8_t *body = p;
+
+        for (uint32_t pc = start; pc < end; pc++) {
+                emit_instruction(&p, epilogue, context, pc, pc - start);
+        }
+        if (plain_instruction(table, end - 1).opcode != 12) {
+                emit_exit(&p, epilogue, end - start, end, false);
+        }
+        if (!jit_protect(jit, from, from + worst, PROT_READ | PROT_EXEC)) {
+                goto unprotected;
+        }
+
+        jit->code_used += p - base;
+        jit->stats->code_bytes += p - base;
+        jit->stats->blocks++;
+        struct jit_slot *slot = &jit->slots[start];
+        memcpy(&slot->entry, &entry, sizeof(slot->entry));
+        slot->body = body;
+        slot->end = end;
+        slot->pure = pure;
+        memset(&jit->covered[start], 1, end - start);
+        jit->starts[jit->block_count++] = start;
+        return;
+
+unprotected: /* other blocks may share the pages, so drop them all */
+        output_flush(context->out);
+        fprintf(stderr, "um: cannot protect the code cache, not compiling "
+                "any more\n");
+        jit_flush(jit);
+        jit->compiling = false;
+}
+
+/********** run_checked ********
+ *
+ * Function that runs a compiled block without side effects after
+ * replaying it on the reference engine, and fails if they disagree
+ *
+ * Return: the next program counter
+ ************************/
+static uint32_t run_checked(struct jit_context *context, uint32_t pc)
+{
+        struct jit_slot slot = context->jit->slots[pc];
+        uint32_t expected[8];
+        memcpy(expected, context->r, sizeof(expected));
+        uint32_t counter = pc;
+        uint32_t next = slot.end;
+        uint64_t count = 0;
+        const uint32_t *words = context->table->segments[0].address;
+
+        while (counter < slot.end) {
+                uint32_t word = words[counter];
+                uint32_t opcode = get_opcode(word);
+                count++;
+                if (opcode == 12) { /* the block ends here */
+                        next = expected[get_rc(word)];
+                        if (expected[get_rb(word)] != 0) {
+                                expected[get_rb(word)] = 0;
+                        }
+                        break;
+                }
+                execute_instruction(opcode, word, expected, context->table,
+                                    &counter, context->in, context->out);
+        }
+
+        uint64_t before = context->count;
+        uint32_t got = slot.entry(context);
+        context->jit->stats->checked++;
+        if (got != next || context->count - before != count ||
+            memcmp(expected, context->r, sizeof(expected)) != 0) {
+                output_flush(context->out);
+                fprintf(stderr, "um: jit mismatch in the block at %u\n", pc);
+                for (int i = 0; i < 8; i++) {
+                        fprintf(stderr, "  r%d: expected %u, got %u\n", i,
+                                expected[i], context->r[i]);
+                }
+                fprintf(stderr, "  next: expected %u, got %u\n", next, got);
+                exit(EXIT_FAILURE);
+        }
+        return got;
+}
+
+/********** interpret_block ********
+ *
+ * Function that runs instructions from pc with the registers in
+ * context->r, up to and including the next load program
+ *
+ * Return: the next program counter; *halted is set if the UM stopped
+ ************************/
+static uint32_t interpret_block(struct jit_context *context, uint32_t pc,
+                                bool *halted)
+{
+        uint32_t *r = context->r;
+        struct segment_table *table = context->table;
+        for (;;) {
+                struct instruction ins = plain_instruction(table, pc++);
+                context->count++;
+                switch (ins.opcode) {
+                case 0:
+                        if (r[ins.rc] != 0) {
+                                r[ins.ra] = r[ins.rb];
+                        }
+                        break;
+                case 1:
+                        r[ins.ra] = table->segments[r[ins.rb]].address
+                                    [r[ins.rc]];
+                        break;
+                case 2:
+                        jit_store(context, ins.ra, ins.rb, ins.rc);
+                        break;
+                case 3:
+                        r[ins.ra] = r[ins.rb] + r[ins.rc];
+                        break;
+                case 4:
+                        r[ins.ra] = r[ins.rb] * r[ins.rc];
+                        break;
+                case 5:
+                        r[ins.ra] = r[ins.rb] / r[ins.rc];
+                        break;
+                case 6:
+                        r[ins.ra] = ~(r[ins.rb] & r[ins.rc]);
+                        break;
+                case 7: /* leave the counter on the halt */
+                        pc--;
+                        if (pc == context->jit->length) {
+                                context->count--; /* the sentinel */
+                        }
+                        *halted = true;
+                        return pc;
+                case 8:
+                        if (!map_segment(ins.rb, ins.rc, r, table)) {
+                                over_cap(context);
+                        }
+                        break;
+                case 9:
+                        unmap_segment(ins.rc, r, table);
+                        break;
+                case 10:
+                        if (r[ins.rc] <= 255) {
+                                output_byte(context->out, r[ins.rc]);
+                        }
+                        break;
+                case 11:
+                        r[ins.rc] = input_instruction(context);
+                        break;
+                case 12:
+                        return jit_load_program(context, ins.rb, ins.rc);
+                case 13:
+                        r[ins.ra] = ins.value;
+                        break;
+                default:
+                        invalid_opcode(context, ins.opcode, pc - 1);
+                }
+        }
+}
+
+/********** run_jit ********
+ *
+ * Function that runs the program in segment 0 on the tiered engine until it
+ * halts or the program counter runs off the end of segment 0
+ *
+ * Parameters:
+ *      uint32_t *registers:  a pointer to the registers (an array of 8
+ *                            uint32_t values that represent the registers
+ *                            of the UM), copied in on entry and written
+ *                            back on exit
+ *      uint32_t *counter     a pointer to the program counter, copied in on
+ *                            entry and written back on exit
+ *      struct segment_table *table: the segment table
+ *      struct input *in:     the input buffer
+ *      struct output *out:   the output buffer
+ *      bool check:           check compiled blocks against the reference
+ *                            engine as they run
+ *      struct jit_stats *stats: filled in with what the JIT did
+ *
+ * Return: the number of instructions executed
+ *
+ * Expects
+ *     registers, counter and stats are not null, and the table is in its
+ *     proper state with segment 0 loaded
+ *
+ * Notes:
+ *     if the code cache cannot be mapped, the program runs on run_engine()
+ *     instead
+ ************************/
+uint64_t run_jit(uint32_t *registers, uint32_t *counter,
+                 struct segment_table *table, struct input *in,
+                 struct output *out, bool check, struct jit_stats *stats)
+{
+        memset(stats, 0, sizeof(*stats));
+        /* compiled code indexes these by shifting */
+        assert(sizeof(struct segment) == 16 && sizeof(struct jit_slot) == 32);
+        void *code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (code == MAP_FAILED) {
+                fprintf(stderr, "um: no memory for compiled code, not "
+                        "compiling\n");
+                return run_engine(registers, counter, table, in, out);
+        }
+
+        struct jit jit = { code, 0, sysconf(_SC_PAGESIZE), true, NULL, NULL,
+                           NULL, 0, 0, !check, 0, stats };
+        jit_reset(&jit, table);
+        struct jit_context context;
+        memcpy(context.r, registers, sizeof(context.r));
+        context.next_pc = 0;
+        context.count = 0;
+        context.table = table;
+        context.in = in;
+        context.out = out;
+        context.jit = &jit;
+
+        uint32_t pc = *counter;
+        bool halted = false;
+        while (!halted && pc < jit.length) {
+                struct jit_slot *slot = &jit.slots[pc];
+                if (slot->entry == NULL && ++slot->heat >= JIT_HOT &&
+                    jit.compiling) {
+                        slot->heat = 0;
+                        compile_block(&context, pc);
+                }
+                if (slot->entry == NULL) {
+                        pc = interpret_block(&context, pc, &halted);
+                } else if (check && slot->pure) {
+                        pc = run_checked(&context, pc);
+                } else {
+                        pc = slot->entry(&context);
+                }
+        }
+
+        memcpy(registers, context.r, sizeof(context.r));
+        *counter = pc;
+        free(jit.slots);
+        free(jit.covered);
+        free(jit.starts);
+        munmap(code, JIT_CODE_SIZE);
+        return context.count;
+}
+
+#else
+
+uint64_t run_jit(uint32_t *registers, uint32_t *counter,
+                 struct segment_table *table, struct input *in,
+                 struct output *out, bool check, struct jit_stats *stats)
+{
+        (void)check;
+        memset(stats, 0, sizeof(*stats));
+        return run_engine(registers, counter, table, in, out);
+}
+
+#endif
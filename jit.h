@@ -0,0 +1,38 @@
+/*
+ *     jit.h
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: jit.h defines the tiered execution engine. Segment 0 starts
+ *              out interpreted; every place a block of code is entered
+ *              (the start of the program, and every load program target)
+ *              keeps a count, and once it gets hot the block is compiled to
+ *              x86-64 machine code that keeps the eight UM registers in host
+ *              registers. Map, unmap, I/O, load program and any store that
+ *              could touch segment 0 call back into memory.c and io.c.
+ *              Compiled code is thrown away when a store changes an
+ *              instruction it covers, or a load program replaces segment 0.
+ *
+ *              On other hosts run_jit() runs the fast interpreter instead.
+ */
+
+#ifndef JIT_INCLUDED
+#define JIT_INCLUDED
+#include <stdbool.h>
+#include <stdint.h>
+#include "memory.h"
+#include "io.h"
+
+struct jit_stats {
+        uint64_t blocks;                /* blocks compiled */
+        uint64_t flushes;               /* times compiled code was dropped */
+        uint64_t code_bytes;            /* machine code emitted */
+        uint64_t checked;               /* block runs checked (check mode) */
+};
+
+uint64_t run_jit(uint32_t *registers, uint32_t *counter,
+                 struct segment_table *table, struct input *in,
+                 struct output *out, bool check, struct jit_stats *stats);
+
+#endif
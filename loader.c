@@ -0,0 +1,222 @@
+/*
+ *     loader.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: loader.c contains the implementation of the program loader.
+ *     A .um file stores its instructions as big-endian 32 bit words; the
+ *     loader turns the whole file into host-order words with swap_words(),
+ *     which uses an AVX2 or SSSE3 byte-shuffle kernel when the CPU has one
+ *     and a plain shift-and-or loop otherwise.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "loader.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_SWAP 1
+#include <immintrin.h>
+#endif
+
+/* bytes requested per read() when the program comes from a pipe */
+#define READ_CHUNK (1 << 16)
+
+/********** swap_scalar ********
+ *
+ * Function that converts big-endian words to host-order words one at a time
+ *
+ * Parameters:
+ *      uint32_t *dst:        where the host-order words go
+ *      const uint8_t *src:   the big-endian words, 4 bytes each
+ *      size_t count:         the number of words
+ *
+ * Return: void
+ *
+ * Expects
+ *     dst and src are not null. dst may be the same buffer as src.
+ ************************/
+static void swap_scalar(uint32_t *dst, const uint8_t *src, size_t count)
+{
+        for (size_t i = 0; i < count; i++) {
+                const uint8_t *bytes = src + 4 * i;
+                dst[i] = ((uint32_t)bytes[0] << 24) |
+                         ((uint32_t)bytes[1] << 16) |
+                         ((uint32_t)bytes[2] << 8) |
+                          (uint32_t)bytes[3];
+        }
+}
+
+#ifdef SIMD_SWAP
+/********** swap_avx2 ********
+ *
+ * Same as swap_scalar, 8 words per shuffle
+ ************************/
+__attribute__((target("avx2")))
+static void swap_avx2(uint32_t *dst, const uint8_t *src, size_t count)
+{
+        const __m256i order = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                                               11, 10, 9, 8, 15, 14, 13, 12,
+                                               3, 2, 1, 0, 7, 6, 5, 4,
+                                               11, 10, 9, 8, 15, 14, 13, 12);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+                __m256i words = _mm256_loadu_si256((const __m256i *)
+                                                   (src + 4 * i));
+                _mm256_storeu_si256((__m256i *)(dst + i),
+                                    _mm256_shuffle_epi8(words, order));
+        }
+        swap_scalar(dst + i, src + 4 * i, count - i);
+}
+
+/********** swap_ssse3 ********
+ *
+ * Same as swap_scalar, 4 words per shuffle
+ ************************/
+__attribute__((target("ssse3")))
+static void swap_ssse3(uint32_t *dst, const uint8_t *src, size_t count)
+{
+        const __m128i order = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                                            11, 10, 9, 8, 15, 14, 13, 12);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+                __m128i words = _mm_loadu_si128((const __m128i *)
+                                                (src + 4 * i));
+                _mm_storeu_si128((__m128i *)(dst + i),
+                                 _mm_shuffle_epi8(words, order));
+        }
+        swap_scalar(dst + i, src + 4 * i, count - i);
+}
+#endif
+
+/********** swap_words ********
+ *
+ * Function that converts big-endian words, as stored in a .um file, to
+ * host-order words, using the widest byte-shuffle the CPU supports
+ *
+ * Parameters:
+ *      uint32_t *dst:        where the host-order words go
+ *      const uint8_t *src:   the big-endian words, 4 bytes each
+ *      size_t count:         the number of words
+ *
+ * Return: void
+ *
+ * Expects
+ *     dst and src are not null. dst may be the same buffer as src, so the
+ *     conversion can be done in place.
+ ************************/
+void swap_words(uint32_t *dst, const uint8_t *src, size_t count)
+{
+#ifdef SIMD_SWAP
+        if (__builtin_cpu_supports("avx2")) {
+                swap_avx2(dst, src, count);
+                return;
+        }
+        if (__builtin_cpu_supports("ssse3")) {
+                swap_ssse3(dst, src, count);
+                return;
+        }
+#endif
+        swap_scalar(dst, src, count);
+}
+
+/********** read_stream ********
+ *
+ * Function that reads everything left in a file descriptor that cannot be
+ * memory-mapped (a pipe or a terminal) into one heap buffer
+ *
+ * Parameters:
+ *      int fd:               the open file descriptor
+ *      size_t *size:         set to the number of bytes read
+ *
+ * Return: the buffer, which the caller must free
+ ************************/
+static uint8_t *read_stream(int fd, size_t *size)
+{
+        size_t capacity = READ_CHUNK;
+        size_t used = 0;
+        uint8_t *buffer = malloc(capacity);
+        assert(buffer != NULL);
+
+        for (;;) {
+                if (capacity - used < READ_CHUNK) {
+                        capacity *= 2;
+                        buffer = realloc(buffer, capacity);
+                        assert(buffer != NULL);
+                }
+                ssize_t got = read(fd, buffer + used, capacity - used);
+                assert(got >= 0);
+                if (got == 0) {
+                        break;
+                }
+                used += got;
+        }
+        *size = used;
+        return buffer;
+}
+
+/********** read_image ********
+ *
+ * Function that reads a .um file into an array of host-order words
+ *
+ * Parameters:
+ *      const char *path:     the pathname of the .um file
+ *      uint32_t *length:     set to the number of words in the file
+ *      struct pool *pool:    the allocator the words come from
+ *
+ * Return: the words, in a buffer from pool_alloc() for *length words (this
+ *         is what initialize_zero() expects)
+ *
+ * Expects
+ *     the file can be opened and holds a whole number of 32 bit words
+ *
+ * Notes:
+ *     a regular file is memory-mapped and converted straight into the
+ *     result. Anything else is read whole into a heap buffer by
+ *     read_stream(), which doubles it as it fills, and only then
+ *     converted into the result, since its size is not known until the
+ *     end.
+ ************************/
+uint32_t *read_image(const char *path, uint32_t *length, struct pool *pool)
+{
+        int fd = open(path, O_RDONLY);
+        assert(fd >= 0);
+
+        struct stat info;
+        int status = fstat(fd, &info);
+        assert(status == 0);
+
+        uint32_t *words;
+        size_t size;
+        if (S_ISREG(info.st_mode) && info.st_size > 0) {
+                size = info.st_size;
+                assert((size % 4) == 0); /* make sure that file is properly
+                                            formatted */
+                uint8_t *bytes = mmap(NULL, size, PROT_READ, MAP_PRIVATE,
+                                      fd, 0);
+                assert(bytes != MAP_FAILED);
+                madvise(bytes, size, MADV_SEQUENTIAL);
+
+                words = pool_alloc(pool, size / 4);
+                swap_words(words, bytes, size / 4);
+                munmap(bytes, size);
+        } else {
+                uint8_t *bytes = read_stream(fd, &size);
+                assert((size % 4) == 0);
+                words = pool_alloc(pool, size / 4);
+                swap_words(words, bytes, size / 4);
+                free(bytes);
+        }
+        close(fd);
+
+        *length = size / 4;
+        return words;
+}
@@ -0,0 +1,23 @@
+/*
+ *     loader.h
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: loader.h defines the functions that read a .um file into
+ *              memory as host-order words, ready to become segment 0.
+ *              Regular files are memory-mapped and byte-swapped in bulk;
+ *              anything else (a pipe, a terminal) is read in large chunks.
+ */
+
+#ifndef LOADER_INCLUDED
+#define LOADER_INCLUDED
+#include <stddef.h>
+#include <stdint.h>
+#include "pool.h"
+
+uint32_t *read_image(const char *path, uint32_t *length, struct pool *pool);
+
+void swap_words(uint32_t *dst, const uint8_t *src, size_t count);
+
+#endif
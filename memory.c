@@ -2,11 +2,11 @@
  *     memory.c
  *     Sophie Zhou (szhou13), Angela Yan (yyan08)
  *     11/19/2024
- *     CS40 HW6 
- * 
+ *     CS40 HW6
+ *
  *     Purpose: memory.c contains implementation of the memory class. These
- *     functions are used by um.c and instructions.c to make changes to 
- *     memory. 
+ *     functions are used by um.c and instructions.c to make changes to
+ *     memory.
  */
 
 
@@ -14,92 +14,481 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
-#include "bitpack.h"
-#include "stack.h"
-#include "seq.h"
+#include <string.h>
+#include <sys/mman.h>
+#include "Word.h"
 #include "assert.h"
 #include "memory.h"
+#include "guard.h"
 
-/********** initialize_zero ********
+/********** decode_instruction ********
+ *
+ * Function that splits a 32 bit word into a pre-decoded instruction
  *
- * Function initializes the 0th segment with the instructions provided in the
- * input um file. The new segment is stored in the Sequence ids.
- * 
  * Parameters:
- *      FILE *fp:             file pointer that represents the input file
- *                            holding all the instructions
- *      int arrsize:          integer representing the size of segment 0,
- *                            or how many instructions the input file holds
- *      Seq_T *ids:           a pointer to the Hanson sequence that stores 
- *                            struct pointers containing the id of each segment 
- *                            (its index in the sequence), the 64-bit address 
- *                            of the segment in memory, and the size of the 
- *                            segment.
- *     
+ *      uint32_t word:        a 32 bit word that represents a given
+ *                            instruction
+ *      struct instruction *ins: the pre-decoded instruction to fill in
+ *
  * Return: void
  *
  * Expects
- *     expects that the file pointer is not null and is a valid .um file,
- *     the arrsize is correct corresponding to the input file, and that 
- *     the Sequence is not null.
- * 
- * Notes:
- *     if the opcode is not within range or the word doesn't represent a 
- *     valid instruction, the UM is allowed to fail. This function is called
- *     within our um.c.
- *    
+ *     ins is not null. Any word can be decoded, even if it is data rather
+ *     than an instruction.
+ ************************/
+static void decode_instruction(uint32_t word, struct instruction *ins)
+{
+        ins->opcode = get_opcode(word);
+        if (ins->opcode == 13) { /* load value */
+                ins->ra = get_lv_ra(word);
+                ins->rb = 0;
+                ins->rc = 0;
+                ins->value = get_lv_val(word);
+        } else {
+                ins->ra = get_ra(word);
+                ins->rb = get_rb(word);
+                ins->rc = get_rc(word);
+                ins->value = 0;
+        }
+}
+
+/********** fuse_instruction ********
+ *
+ * Function that turns the pre-decoded instruction at i into a
+ * superinstruction if it starts one of the idioms in memory.h:
+ *      nand $r[A], $r[B], $r[B]            becomes OP_NOT
+ *      load value $r[X]; load program $r[B], $r[X]   becomes OP_JUMP
+ *      load value; load value              becomes OP_LOAD_PAIR
+ *
+ * Parameters:
+ *      struct segment_table *table: the segment table, whose decoded copy
+ *                            of segment 0 has plain instructions at i and
+ *                            decoded instructions after it
+ *      uint32_t i:           an index into segment 0
+ *
+ * Return: void
  ************************/
-void initialize_zero(FILE *fp, int arrsize, Seq_T *ids) 
+static void fuse_instruction(struct segment_table *table, uint32_t i)
 {
+        struct instruction *ins = &table->program[i];
+        const struct instruction *next = ins + 1; /* at worst the sentinel */
+        unsigned fused;
+
+        if (ins->opcode == 6 && ins->rb == ins->rc) {
+                fused = OP_NOT;
+        } else if (ins->opcode == 13 && plain_opcode(next->opcode) == 12 &&
+                   next->rc == ins->ra) {
+                fused = OP_JUMP;
+        } else if (ins->opcode == 13 && plain_opcode(next->opcode) == 13) {
+                fused = OP_LOAD_PAIR;
+        } else {
+                return;
+        }
+        ins->opcode = fused;
+        table->fusion.sites[fused - OP_NOT]++;
+}
 
-        /* make new segment */
-        uint32_t(*address) = malloc(arrsize * sizeof(uint32_t)); 
-        assert(address!= NULL);
-        
-        /* make instance of struct */
-        struct segment *new_segment = malloc(sizeof(struct segment)); 
-        assert(new_segment != NULL);
-        new_segment->address = address; 
-        new_segment->id = 0; 
-        new_segment->size = arrsize;
-        Seq_addhi(*ids, new_segment); /* add to sequence */
-
-        /* initialize segment with instructions inside input file */
-        for (int i = 0; i < arrsize; i++ ) {         
-                char ch;
-                uint32_t word = 0;
-                for (int i = 0; i < 4; i ++) {
-                        ch = getc(fp);
-                        word = Bitpack_newu(word, 8, 24 - 8*i, (uint8_t)ch);
+/********** redecode ********
+ *
+ * Function that brings the pre-decoded copy of segment 0 up to date after a
+ * store to word i of segment 0. The superinstruction at i - 1 may have
+ * lost its second half, and the new word may start an idiom of its own, so
+ * both are decoded and fused again.
+ *
+ * Parameters:
+ *      struct segment_table *table: the segment table
+ *      uint32_t i:           the index of the word that was stored
+ *
+ * Return: void
+ ************************/
+static void redecode(struct segment_table *table, uint32_t i)
+{
+        const uint32_t *words = table->segments[0].address;
+        uint32_t first = (i > 0) ? i - 1 : 0;
+        for (uint32_t j = first; j <= i; j++) {
+                struct instruction *ins = &table->program[j];
+                if (ins->opcode >= OP_NOT) {
+                        table->fusion.sites[ins->opcode - OP_NOT]--;
                 }
-                address[i] = word;  
+                decode_instruction(words[j], ins);
+        }
+        if (!table->fuse) {
+                return;
+        }
+        for (uint32_t j = first; j <= i; j++) {
+                fuse_instruction(table, j);
+        }
+}
+
+/********** decode_program ********
+ *
+ * Function that rebuilds the pre-decoded copy of segment 0 after segment 0
+ * has been replaced. One extra halt instruction is decoded past the end, so
+ * that running off the end of segment 0 stops the machine without the
+ * interpreter checking the program counter on every fetch. Each rebuild
+ * bumps table->generation, so anything cached from the old segment 0 (such
+ * as compiled code) can tell that it is stale. Unless fusion is turned off,
+ * common idioms are then fused into superinstructions.
+ *
+ * Parameters:
+ *      struct segment_table *table: the segment table, with segment 0
+ *                            already filled in
+ *
+ * Return: void
+ *
+ * Expects
+ *     table is not null and segment 0 is mapped
+ ************************/
+static void decode_program(struct segment_table *table)
+{
+        struct segment *seg = &table->segments[0];
+        free(table->program);
+
+        struct instruction *decoded = pool_malloc(&table->pool,
+                                                  ((size_t)seg->size + 1) *
+                                                  sizeof(struct instruction));
+        for (uint32_t i = 0; i < seg->size; i++) {
+                decode_instruction(seg->address[i], &decoded[i]);
+        }
+        decode_instruction((uint32_t)7 << 28, &decoded[seg->size]);
+        table->program = decoded;
+        table->generation++;
+
+        memset(table->fusion.sites, 0, sizeof(table->fusion.sites));
+        if (table->fuse) {
+                for (uint32_t i = 0; i < seg->size; i++) {
+                        fuse_instruction(table, i);
+                }
+        }
+}
+
+/********** watch ********
+ *
+ * Function that sets the words past which a table's growth takes the cold
+ * path, after its peak has moved
+ ************************/
+static void watch(struct segment_table *table)
+{
+        table->watch_words = table->memory.peak_words < table->max_words ?
+                             table->memory.peak_words : table->max_words;
+}
+
+/********** count_segment ********
+ *
+ * Function that counts a newly mapped segment of size words, for the
+ * callers that build a table rather than run it, which no cap applies to
+ ************************/
+static void count_segment(struct segment_table *table, uint32_t size)
+{
+        struct memory_stats *memory = &table->memory;
+        memory->live_segments++;
+        memory->live_words += size;
+        if (memory->live_words > memory->peak_words) {
+                memory->peak_words = memory->live_words;
+                watch(table);
+        }
+        if (size > memory->largest) {
+                memory->largest = size;
+        }
+}
+
+/********** check_growth ********
+ *
+ * Function that is the cold path of the accounting, taken only when a map
+ * or load program would make the table's live words pass its peak, its
+ * segments reach a cap, or a segment larger than the largest yet: checks
+ * the caps and, if the growth is allowed, moves the peak and the largest
+ *
+ * Parameters:
+ *      struct segment_table *table: the table
+ *      uint32_t segments:    segments it grows by, 0 or 1
+ *      uint64_t words:       the live words it would then hold
+ *      uint32_t size:        the segment mapped or loaded
+ *
+ * Return: true, or false if the growth would take the table over a cap, in
+ *         which case the refusal is counted and nothing else changes
+ *
+ * Notes:
+ *     watch_words is the lesser of the peak and the cap on words, so a
+ *     growth past either is caught by one comparison
+ ************************/
+static bool __attribute__((noinline, cold))
+check_growth(struct segment_table *table, uint32_t segments, uint64_t words,
+             uint32_t size)
+{
+        struct memory_stats *memory = &table->memory;
+        if (memory->live_segments + (uint64_t)segments > table->max_segments ||
+            words > table->max_words) {
+                memory->refused++;
+                memory->refused_words = size;
+                return false;
+        }
+        if (words > memory->peak_words) {
+                memory->peak_words = words;
+                watch(table);
+        }
+        if (size > memory->largest) {
+                memory->largest = size;
+        }
+        return true;
+}
+
+/********** safe_fail ********
+ *
+ * Function that reports, in safe mode, an instruction given segment id when
+ * that is not a mapped segment it can use, and fails the UM. Kept out of
+ * line so that its report buffer stays off the frame of its callers.
+ ************************/
+static void __attribute__((noinline, cold))
+safe_fail(const char *instruction, uint32_t id)
+{
+        char report[96];
+        snprintf(report, sizeof(report), "um: --safe: %s %u, which is not "
+                 "mapped\n", instruction, id);
+        guard_fail(report);
+}
+
+/********** grow_segments ********
+ *
+ * Function that makes room in a table for capacity entries
+ *
+ * Parameters:
+ *      struct segment_table *table: the segment table
+ *      uint32_t capacity:    the entries needed, more than it has room for
+ *
+ * Return: void
+ *
+ * Notes:
+ *     a safe table only makes more of its reservation accessible, so its
+ *     entries never move and the new ones are zero
+ ************************/
+static void grow_segments(struct segment_table *table, uint32_t capacity)
+{
+        if (table->safe) {
+                int status = mprotect(table->segments, (size_t)capacity *
+                                      sizeof(struct segment),
+                                      PROT_READ | PROT_WRITE);
+                assert(status == 0);
+        } else {
+                table->segments = realloc(table->segments, (size_t)capacity *
+                                          sizeof(struct segment));
+                assert(table->segments != NULL);
+        }
+        table->capacity = capacity;
+        id_map_grow(&table->free_ids, capacity);
+}
+
+/********** free_segments ********
+ *
+ * Function that frees the entries of a table
+ ************************/
+static void free_segments(struct segment_table *table)
+{
+        if (table->safe) {
+                munmap(table->segments, SAFE_TABLE_BYTES);
+        } else {
+                free(table->segments);
+        }
+}
+
+/********** append_id ********
+ *
+ * Function that hands out a new entry at the end of a table, which doubles
+ * in size when it is full; new_id() calls it when no id is unmapped
+ ************************/
+static uint32_t append_id(struct segment_table *table)
+{
+        if (table->length == table->capacity) {
+                grow_segments(table, table->capacity * 2);
+        }
+        return table->length++;
+}
+
+/********** new_id ********
+ *
+ * Function that hands out a segment id: the lowest unmapped id if there is
+ * one, otherwise a new entry at the end of the table.
+ *
+ * Parameters:
+ *      struct segment_table *table: the segment table
+ *
+ * Return: the id, whose table entry the caller must fill in
+ *
+ * Expects
+ *     table is not null
+ *
+ * Notes:
+ *     always inline, and kept to the reuse of an id, which is what a
+ *     program that maps and unmaps in a loop does every time
+ ************************/
+static inline __attribute__((always_inline))
+uint32_t new_id(struct segment_table *table)
+{
+        if (table->free_ids.free != 0) { /* reuse an unmapped id */
+                return id_map_take(&table->free_ids);
+        }
+        return append_id(table);
+}
+
+/********** unshare ********
+ *
+ * Function that gives one side of a copy-on-write pair (segment 0 and the
+ * segment it was loaded from) its own copy of the words they share, just 
+ * before that side is written
+ *
+ * Parameters:
+ *      struct segment_table *table: the segment table
+ *      uint32_t id:          the segment about to be written, either 0 or
+ *                            table->shared_with
+ *
+ * Return: void
+ *
+ * Expects
+ *     table is not null and segment 0 currently shares its words
+ *
+ * Notes:
+ *     the copy has the same contents, so the pre-decoded copy of segment 0
+ *     stays valid either way
+ ************************/
+static void unshare(struct segment_table *table, uint32_t id)
+{
+        struct segment *seg = &table->segments[id];
+        uint32_t *address = pool_alloc(&table->pool, seg->size);
+        memcpy(address, seg->address, (size_t)seg->size * sizeof(uint32_t));
+        seg->address = address;
+        table->shared_with = NO_SEGMENT;
+}
+
+/********** unborrow ********
+ *
+ * Function that gives a table its own copy of a borrowed segment 0, words
+ * and decoded copy, just before either is written
+ *
+ * Parameters:
+ *      struct segment_table *table: the segment table, borrowing segment 0
+ *
+ * Return: void
+ ************************/
+static void unborrow(struct segment_table *table)
+{
+        const struct shared_program *shared = table->borrowed;
+        uint32_t *words = pool_alloc(&table->pool, shared->size);
+        memcpy(words, shared->words, (size_t)shared->size * sizeof(uint32_t));
+        table->segments[0].address = words;
+
+        size_t bytes = ((size_t)shared->size + 1) * sizeof(struct instruction);
+        table->program = pool_malloc(&table->pool, bytes);
+        memcpy(table->program, shared->program, bytes);
+        table->borrowed = NULL;
+}
+
+/********** release_words ********
+ *
+ * Function that gives back the words of a segment that is going away:
+ * to the pool, unless they are part of a restored snapshot's mapping
+ *
+ * Parameters:
+ *      struct segment_table *table: the segment table
+ *      uint32_t *address:    the segment's words, or NULL
+ *      uint32_t size:        the segment's size in words
+ *
+ * Return: void
+ ************************/
+static void release_words(struct segment_table *table, uint32_t *address,
+                          uint32_t size)
+{
+        char *bytes = (char *)address;
+        char *image = table->image;
+        if (image != NULL && bytes >= image &&
+            bytes < image + table->image_size) {
+                return; /* munmapped with the rest of the image */
         }
+        pool_free(&table->pool, address, size);
 }
 
-/********** make_sequence ********
+/********** make_table ********
+ *
+ * Function that creates a new, empty segment table
+ *
+ * Parameters:
+ *      const struct memory_options *options: settings for the table
  *
- * Function that creates a new Hanson Sequence
- *     
- * Return: the new instance of a Hanson Sequence
+ * Return: a pointer to the new segment table
  ************************/
-Seq_T make_sequence() 
+struct segment_table *make_table(const struct memory_options *options)
 {
-        Seq_T ids = Seq_new(10); /* make sequence */
-        assert(ids != NULL);
-        return ids;
+        struct segment_table *table = malloc(sizeof(struct segment_table));
+        assert(table != NULL);
+        table->safe = options->safe;
+        table->segments = NULL;
+        if (table->safe) {
+                table->segments = mmap(NULL, SAFE_TABLE_BYTES, PROT_NONE,
+                                       MAP_PRIVATE | MAP_ANONYMOUS |
+                                       MAP_NORESERVE, -1, 0);
+                assert(table->segments != MAP_FAILED);
+        }
+        id_map_init(&table->free_ids);
+        grow_segments(table, 10);
+        table->length = 0;
+        table->shared_with = NO_SEGMENT;
+        table->program = NULL;
+        table->borrowed = NULL;
+        table->image = NULL;
+        table->image_size = 0;
+        table->generation = 0;
+        pool_init(&table->pool, options->pool_cap, options->mmap_threshold);
+        if (table->safe) {
+                table->pool.guard = POOL_GUARD_BYTES;
+        } else {
+                table->pool.hugepages = options->hugepages;
+        }
+        table->fuse = options->fuse;
+        table->max_words = options->max_words != 0 ? options->max_words :
+                           UINT64_MAX;
+        table->max_segments = options->max_segments != 0 ?
+                              options->max_segments : UINT64_MAX;
+        memset(&table->memory, 0, sizeof(table->memory));
+        table->watch_words = 0; /* the peak, so far */
+        memset(&table->fusion, 0, sizeof(table->fusion));
+        return table;
 }
 
-/********** make_stack ********
+/********** initialize_zero ********
+ *
+ * Function initializes the 0th segment with the instructions read from the
+ * input um file. The new segment is stored at index 0 of the segment table.
+ *
+ * Parameters:
+ *      uint32_t *words:      the instructions, as host-order words in a
+ *                            buffer from pool_alloc() on the table's pool
+ *                            (see read_image in loader.h). Segment 0 takes
+ *                            ownership of the buffer.
+ *      uint32_t arrsize:     integer representing the size of segment 0,
+ *                            or how many instructions the input file holds
+ *      struct segment_table *table: the segment table, which must be empty
+ *
+ * Return: void
+ *
+ * Expects
+ *     expects that words is not null, the arrsize is correct corresponding
+ *     to the input file, and that the table is not null.
+ *
+ * Notes:
+ *     if the opcode is not within range or the word doesn't represent a
+ *     valid instruction, the UM is allowed to fail. This function is called
+ *     within our um.c.
  *
- * Function that creates a new Hanson Stack
- *     
- * Return: the new instance of a Hanson Stack
  ************************/
-Stack_T make_stack() 
+void initialize_zero(uint32_t *words, uint32_t arrsize,
+                     struct segment_table *table)
 {
-        Stack_T unmapped = Stack_new(); /* make stack */
-        assert(unmapped != NULL);
-        return unmapped;
+        assert(words != NULL);
+        uint32_t id = new_id(table);
+        assert(id == 0);
+        table->segments[id].address = words;
+        table->segments[id].size = arrsize;
+        count_segment(table, arrsize);
+        decode_program(table);
 }
 
 /********** load_memory ********
@@ -114,32 +503,29 @@ Stack_T make_stack()
  *                            32 bit instruction
  *      uint32_t rc:          uint32_t that represents the rc value of a
  *                            32 bit instruction
- *      uint32_t *registers:  a pointer to the registers (an array of 8 
- *                            uint32_t values that represent the registers 
+ *      uint32_t *registers:  a pointer to the registers (an array of 8
+ *                            uint32_t values that represent the registers
  *                            of the UM)
- *      Seq_T *ids:           a Hanson sequence that stores struct pointers
- *                            containing the id of each segment (its index
- *                            in the sequence), the 64-bit address of the 
- *                            segment in memory, and the size of the segment.
- * 
+ *      struct segment_table *table: the segment table, which holds the
+ *                            64-bit address and the size of every segment,
+ *                            indexed by segment id
+ *
  * Return: void
  *
  * Expects
- *     expects that ra, rb, and rc are valid, the registers array 
- *     is not null and initalized properly, and the ids Sequence is not null
+ *     expects that ra, rb, and rc are valid, the registers array
+ *     is not null and initalized properly, and the table is not null
  *     and is in its proper state
- * 
+ *
  * Notes:
  *      this function is used in instructions.c to implement the instruction_1
  *      helper function, called inside execute_instruction
  ************************/
-void load_memory(uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers, 
-                Seq_T *ids) 
+void load_memory(uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers,
+                struct segment_table *table)
 {
-        struct segment *info = Seq_get(*ids, registers[rb]);
-        uint32_t *array = info->address;
-        int index = registers[rc];
-        registers[ra] = array[index];
+        uint32_t *array = table->segments[registers[rb]].address;
+        registers[ra] = array[registers[rc]];
 }
 
 /********** store_memory ********
@@ -154,304 +540,438 @@ void load_memory(uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers,
  *                            32 bit instruction
  *      uint32_t rc:          uint32_t that represents the rc value of a
  *                            32 bit instruction
- *      uint32_t *registers:  a pointer to the registers (an array of 8 
- *                            uint32_t values that represent the registers 
+ *      uint32_t *registers:  a pointer to the registers (an array of 8
+ *                            uint32_t values that represent the registers
  *                            of the UM)
- *      Seq_T *ids:           a Hanson sequence that stores struct pointers
- *                            containing the id of each segment (its index
- *                            in the sequence), the 64-bit address of the 
- *                            segment in memory, and the size of the segment.
- * 
+ *      struct segment_table *table: the segment table, which holds the
+ *                            64-bit address and the size of every segment,
+ *                            indexed by segment id
+ *
  * Return: void
  *
  * Expects
- *     expects that ra, rb, and rc are valid, the registers array 
- *     is not null and initalized properly, and the ids Sequence is not null
+ *     expects that ra, rb, and rc are valid, the registers array
+ *     is not null and initalized properly, and the table is not null
  *     and is in its proper state
- * 
+ *
  * Notes:
  *      this function is used in instructions.c to implement the instruction_2
- *      helper function, called inside execute_instruction
+ *      helper function, called inside execute_instruction. A store to either
+ *      segment of a copy-on-write pair first gives it its own copy.
  ************************/
-void store_memory (uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers, 
-                   Seq_T *ids) 
+void store_memory (uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers,
+                   struct segment_table *table)
 {
-        struct segment *array = Seq_get(*ids, registers[ra]);
-        array->address[registers[rb]] = registers[rc];
+        uint32_t id = registers[ra];
+        if (id == 0 && table->borrowed != NULL) {
+                unborrow(table);
+        }
+        if (table->shared_with != NO_SEGMENT &&
+            (id == 0 || id == table->shared_with)) { /* copy on write */
+                unshare(table, id);
+        }
+
+        table->segments[id].address[registers[rb]] = registers[rc];
+        if (id == 0) { /* self-modifying store to segment 0 */
+                redecode(table, registers[rb]);
+        }
 }
 
 /********** map_segment ********
  *
- * function that maps a segment to memory and adds it to the
- * correct spot in the Hanson Sequence ids.
+ * function that maps a segment to memory and records it in the segment
+ * table, under a previously unmapped id if there is one.
  *
  * Parameters:
  *      uint32_t rb:          uint32_t that represents the rb value of a
  *                            32 bit instruction
  *      uint32_t rc:          uint32_t that represents the rc value of a
  *                            32 bit instruction
- *      uint32_t *registers:  a pointer to the registers (an array of 8 
- *                            uint32_t values that represent the registers 
+ *      uint32_t *registers:  a pointer to the registers (an array of 8
+ *                            uint32_t values that represent the registers
  *                            of the UM)
- *      Seq_T *ids:           a pointer to the Hanson sequence that stores 
- *                            struct pointers containing the id of each segment 
- *                            (its index in the sequence), the 64-bit address 
- *                            of the segment in memory, and the size of the 
- *                            segment.
- * 
- *      Stack_T *unmapped     a pointer to the Hanson stack that stores
- *                            the uint32_t pointers that represent the ids of 
- *                            the most recently unmapped segments 
- * 
- * Return: void
+ *      struct segment_table *table: the segment table, which holds the
+ *                            64-bit address and the size of every segment,
+ *                            indexed by segment id, and the list of
+ *                            unmapped ids
+ *
+ * Return: true, or false if the segment would take the table over one of
+ *         its caps, in which case nothing is mapped and the refusal is
+ *         counted for report_cap()
  *
  * Expects
- *     expects that rb, and rc are valid, the registers array 
- *     is not null and initalized properly, the ids Sequence is not null
- *     and is in its proper state, and that the unmapped Stack is not null
+ *     expects that rb, and rc are valid, the registers array
+ *     is not null and initalized properly, and the table is not null
  *     and is in its proper state
- * 
+ *
  * Notes:
  *      this function is used in instructions.c to implement the instruction_8
  *      helper function, called inside execute_instruction
  ************************/
-void map_segment(uint32_t rb, uint32_t rc, uint32_t *registers, 
-                Stack_T *unmapped, Seq_T *ids) 
+bool map_segment(uint32_t rb, uint32_t rc, uint32_t *registers,
+                 struct segment_table *table)
 {
-
-        /* creates new segment */
-        uint32_t *address = malloc(registers[rc] * (sizeof (uint32_t))); 
-        assert(address!= NULL);
-        for (uint32_t i = 0; i < registers[rc]; i++) {
-                address[i]  = (uint32_t)0; /* initializes all indices to 0 */
-        }
-        
-        /* if there are no indices to be reused */
-        if (Stack_empty(*unmapped)){ 
-                struct segment *new_segment = malloc(sizeof(struct segment)); 
-                new_segment->address = address; 
-                new_segment -> size = registers[rc];
-                new_segment->id = Seq_length(*ids);
-                
-                Seq_addhi(*ids, new_segment); /* add to back of sequence */
-                registers[rb] = new_segment->id; 
-        
-        /* else, add to last unmapped index in the sequence */  
-        } else { 
-                uint32_t index = (uint32_t)(uintptr_t)Stack_pop(*unmapped); 
-                struct segment *old_segment = Seq_get(*ids, index);
-                old_segment->id = index;
-                old_segment-> address = address;
-                old_segment->size = registers[rc];
-                registers[rb] = index;       
+        uint32_t size = registers[rc];
+        struct memory_stats *memory = &table->memory;
+        uint64_t words = memory->live_words + size;
+        if ((words > table->watch_words || size > memory->largest ||
+             memory->live_segments >= table->max_segments) &&
+            !check_growth(table, 1, words, size)) {
+                return false;
         }
-}
+        memory->live_words = words;
+        memory->live_segments++;
+        memory->maps++;
 
-/********** free_memory ********
- *
- * function that frees memory stored in the index Sequence. 
- *
- * Parameters:
- *      int seg_num:          integer representing the id of the segment we 
- *                            want to free
- *      Seq_T *ids:           a pointer to the Hanson sequence that stores 
- *                            struct pointers containing the id of each segment 
- *                            (its index in the sequence), the 64-bit address 
- *                            of the segment in memory, and the size of the 
- *                            segment.
- *      bool seg0:            boolean representing if we want to free the 
- *                            struct pointer
- *      bool arr:             boolean representing if we want to free the 
- *                            array address
- *                     
- * Return: void
- *
- * Expects
- *     expects that seg_num is within range of the Sequence, and that sequence
- *     is not null.
- ************************/
-uint32_t free_memory(int seg_num, Seq_T *ids, bool seg0, bool arr) 
-{
-        assert(ids != NULL);
-        uint32_t index = 0;
-        
-        struct segment *old_segment = Seq_get(*ids, seg_num);
-        if (old_segment != NULL) { 
-                index = old_segment -> id; 
-                uint32_t *array = old_segment->address; 
-                if (arr) {
-                        free(array);         
-                }
-                if (seg0) { 
-                        free (old_segment);
-                }
-        }
-        return index;  /* return id of segment we just freed */
+        uint32_t id = new_id(table);
+        registers[rb] = id;
+        /* creates new segment, with all indices initialized to 0; last, so
+           that only the entry lives across the call */
+        struct segment *seg = &table->segments[id];
+        seg->size = size;
+        seg->address = pool_calloc(&table->pool, size);
+        return true;
 }
 
-
 /********** unmap_segment ********
  *
- * function that given rc value of an instruction, the 
- * registers, and the segment, unmaps a given segment in memory.
+ * function that given rc value of an instruction, the
+ * registers, and the segment table, unmaps a given segment in memory and
+ * puts its id at the front of the list of unmapped ids.
  *
  * Parameters:
  *      uint32_t rc:          uint32_t that represents the rc value of a
  *                            32 bit instruction
- *      uint32_t *registers:  a pointer to the registers (an array of 8 
- *                            uint32_t values that represent the registers 
+ *      uint32_t *registers:  a pointer to the registers (an array of 8
+ *                            uint32_t values that represent the registers
  *                            of the UM)
- *      Seq_T *ids:           a pointer to the Hanson sequence that stores 
- *                            struct pointers containing the id of each segment 
- *                            (its index in the sequence), the 64-bit address 
- *                            of the segment in memory, and the size of the 
- *                            segment.
- *      Stack_T *unmapped     a pointer to the Hanson stack that stores
- *                            the uint32_t pointers that represent the ids of 
- *                            the most recently unmapped segments 
- * 
+ *      struct segment_table *table: the segment table, which holds the
+ *                            64-bit address and the size of every segment,
+ *                            indexed by segment id, and the list of
+ *                            unmapped ids
+ *
  * Return: void
  *
  * Expects
- *     expects that rc is valid, the registers array 
- *     is not null and initalized properly, the ids Sequence is not null
- *     and is in its proper state, and that the unmapped Stack is not null
+ *     expects that rc is valid, the registers array
+ *     is not null and initalized properly, and the table is not null
  *     and is in its proper state
- * 
+ *
  * Notes:
  *      this function is used in instructions.c to implement the instruction_9
  *      helper function, called inside execute_instruction
  ************************/
-void unmap_segment (uint32_t rc, uint32_t *registers, Stack_T *unmapped, 
-                    Seq_T *ids) 
+void unmap_segment (uint32_t rc, uint32_t *registers,
+                    struct segment_table *table)
 {
-        int seg_num = registers[rc];
-        uint32_t index = free_memory(seg_num, ids, false, true);
-        Stack_push(*unmapped, (void*)(uintptr_t)index);
+        uint32_t id = registers[rc];
+        struct segment *seg = &table->segments[id];
+        if (table->safe && id == 0) {
+                guard_fail("um: --safe: unmap of segment 0\n");
+        }
+        if (table->safe && !segment_mapped(table, id)) {
+                safe_fail("unmap of segment", id);
+        }
+        uint32_t *address = seg->address;
+        uint32_t size = seg->size;
+        table->memory.unmaps++;
+        table->memory.live_segments--;
+        table->memory.live_words -= size; /* never a new peak */
+        seg->address = NULL;
+        seg->size = 0;
+        id_map_put(&table->free_ids, id);
+        /* last, so that nothing lives across the call */
+        if (id == table->shared_with) { /* segment 0 keeps the words */
+                table->shared_with = NO_SEGMENT;
+        } else {
+                release_words(table, address, size);
+        }
 }
 
 /********** load_program ********
  *
- * function that duplicates the segment in $m[$r[B]], replaces $m[0] with the 
- * duplicate, and abandons what was previously in $m[0]. The program counter is 
- * set to point to $m[0][$r[C]]. 
+ * function that duplicates the segment in $m[$r[B]], replaces $m[0] with the
+ * duplicate, and abandons what was previously in $m[0]. The program counter is
+ * set to point to $m[0][$r[C]].
+ *
+ * The duplicate is copy-on-write: segment 0 shares $m[$r[B]]'s words until
+ * either one is stored to (see store_memory), so loading a program costs 
+ * nothing but the decode of segment 0, and loading the same segment again
+ * while it is still shared costs nothing at all.
  *
  * Parameters:
  *      uint32_t rb:          uint32_t that represents the rb value of a
  *                            32 bit instruction
  *      uint32_t rc:          uint32_t that represents the rc value of a
  *                            32 bit instruction
- *      uint32_t *registers:  a pointer to the registers (an array of 8 
- *                            uint32_t values that represent the registers 
+ *      uint32_t *registers:  a pointer to the registers (an array of 8
+ *                            uint32_t values that represent the registers
  *                            of the UM)
- *      Seq_T *ids:           a pointer to the Hanson sequence that stores 
- *                            struct pointers containing the id of each segment 
- *                            (its index in the sequence), the 64-bit address 
- *                            of the segment in memory, and the size of the 
- *                            segment.
+ *      struct segment_table *table: the segment table, which holds the
+ *                            64-bit address and the size of every segment,
+ *                            indexed by segment id
  *      uint32_t *counter     a pointer to a uint32_t variable that represents
  *                            the program counter, or which index of segment 0
  *                            we are in within our execution loop
- *      
- * Return: void
+ *
+ * Return: true, or false if the duplicate would take the table over its cap
+ *         on words, in which case neither segment 0 nor the counter change
  *
  * Expects
- *     expects that rb, and rc are valid, the registers array 
- *     is not null and initalized properly, the ids Sequence is not null
+ *     expects that rb, and rc are valid, the registers array
+ *     is not null and initalized properly, the table is not null
  *     and is in its proper state, and that counter is not null
- * 
+ *
  * Notes:
  *      this function is used in instructions.c to implement the instruction_12
  *      helper function, called inside execute_instruction
  ************************/
-void load_program(uint32_t rb, uint32_t rc, uint32_t *registers, Seq_T *ids, 
-                uint32_t *counter) 
+bool load_program(uint32_t rb, uint32_t rc, uint32_t *registers,
+                  struct segment_table *table, uint32_t *counter)
 {
-        *counter = registers[rc]; 
-        if (registers[rb] == 0) {
-                return;
-        } 
-
-        uint32_t i = free_memory(0, ids, true, true); /* free segment 0 */
-        (void) i;
-
-        /* make a copy of segment m[rb]*/
-        struct segment* old = Seq_get(*ids, registers[rb]); 
-        int arrsize = old -> size;
-        uint32_t *address = malloc(arrsize * (sizeof (uint32_t))); 
-        assert(address!= NULL);
-        
-        for (int i = 0; i < arrsize; i++) { /* copy every element over */
-                address[i]  = old->address [i];
-        }
-
-        /* make instance of struct */
-        struct segment *new_segment = malloc(sizeof(struct segment)); 
-        //printf("size of segment is %lu\n", sizeof(struct segment));
-        new_segment->address = address;
-        new_segment->id = 0;
-        new_segment->size = arrsize;
-        
+        uint32_t id = registers[rb];
+        if (id == 0) {
+                *counter = registers[rc];
+                return true;
+        }
+
+        if (table->safe && !segment_mapped(table, id)) {
+                safe_fail("load program from segment", id);
+        }
+        if (id == table->shared_with) { /* already loaded, unchanged */
+                *counter = registers[rc];
+                registers[rb] = 0;
+                return true;
+        }
+
+        /* the duplicate replaces segment 0 */
+        uint32_t size = table->segments[id].size;
+        uint64_t words = table->memory.live_words + size -
+                         table->segments[0].size;
+        if ((words > table->watch_words ||
+             size > table->memory.largest) &&
+            !check_growth(table, 0, words, size)) {
+                return false;
+        }
+        *counter = registers[rc];
+        table->memory.live_words = words;
+        /* free segment 0, unless m[shared_with] still uses it or it is
+           borrowed */
+        if (table->borrowed != NULL) {
+                table->program = NULL;
+                table->borrowed = NULL;
+        } else if (table->shared_with == NO_SEGMENT) {
+                release_words(table, table->segments[0].address,
+                              table->segments[0].size);
+        }
+
+        /* share the words of segment m[rb] */
+        struct segment *old = &table->segments[id];
+        table->segments[0].address = old->address;
+        table->segments[0].size = old->size;
+        table->shared_with = id;
+        decode_program(table);
+
         registers[rb] = 0;
-        Seq_put(*ids, 0, new_segment);  /* put new segment into Sequence */ 
+        return true;
 }
 
 /********** free_all ********
  *
- * function that frees all heap-allocated memory at the end of program 
+ * function that frees all heap-allocated memory at the end of program
  * execution
  *
  * Parameters:
- *      Seq_T ids:            a Hanson sequence that stores 
- *                            struct pointers containing the id of each segment 
- *                            (its index in the sequence), the 64-bit address 
- *                            of the segment in memory, and the size of the 
- *                            segment.
- *     Stack_T *unmapped      a Hanson stack that stores
- *                            the uint32_t pointers that represent the ids of 
- *                            the most recently unmapped segments 
- *                     
+ *      struct segment_table *table: the segment table, which holds the
+ *                            64-bit address and the size of every segment,
+ *                            indexed by segment id
+ *
  * Return: void
  *
  * Expects
- *     expects that ids is not null, and unmapped is not null
+ *     expects that table is not null
  ************************/
-void free_all(Seq_T ids, Stack_T unmapped) {
-        
-        /* identifies all of the indices in the sequence that are not storing
-        memory addresses */
-        while (!Stack_empty(unmapped)) {
-                uint32_t index = (uint32_t)(uintptr_t)Stack_pop(unmapped); 
-                struct segment *empty = (void*)(uintptr_t)Seq_get(ids, index);
-                empty->size = -10;
-        }
-
-        if (Seq_length(ids) != 0) {
-                
-                for (int i = 0; i < Seq_length(ids); i++) {   
-                        struct segment *old_segment = Seq_get(ids, i); 
-
-                        /* if index stores memory address, free both struct 
-                        pointer and address */
-                        if (old_segment->size != -10) {    
-                             free_memory(i, &ids, true, true);
-
-                        /* if index doesn't memory address, just free 
-                        struct pointer */
-                        } else {
-                                free_memory(i, &ids, true, false);
-                        }     
+void free_all(struct segment_table *table) {
+
+        /* unmapped ids have a NULL address, so freeing every entry is safe,
+        as long as words shared with segment 0 are only freed once */
+        for (uint32_t i = 0; i < table->length; i++) {
+                if (i != table->shared_with &&
+                    (i != 0 || table->borrowed == NULL)) {
+                        release_words(table, table->segments[i].address,
+                                      table->segments[i].size);
                 }
         }
-        Seq_free(&ids);
-        Stack_free(&unmapped);  
+        pool_release(&table->pool);
+        if (table->image != NULL) {
+                munmap(table->image, table->image_size);
+        }
+        if (table->borrowed == NULL) {
+                free(table->program);
+        }
+        free_segments(table);
+        id_map_free(&table->free_ids);
+        free(table);
 }
 
-    
-      
+/********** share_program ********
+ *
+ * Function that turns the segment 0 of a table that has just been loaded
+ * into a shared_program, and frees the rest of the table
+ *
+ * Parameters:
+ *      struct segment_table *table: a table with only segment 0 mapped, as
+ *                            left by initialize_zero()
+ *
+ * Return: the shared program, to be freed with free_shared() once no table
+ *         borrows it
+ ************************/
+struct shared_program *share_program(struct segment_table *table)
+{
+        assert(table != NULL && table->length == 1 &&
+               table->borrowed == NULL);
+        struct shared_program *shared = malloc(sizeof(*shared));
+        assert(shared != NULL);
+        shared->words = table->segments[0].address;
+        shared->size = table->segments[0].size;
+        shared->program = table->program;
+        memcpy(shared->sites, table->fusion.sites, sizeof(shared->sites));
+        pool_release(&table->pool);
+        shared->pool = table->pool; /* so its words are freed the same way */
 
- 
+        free_segments(table);
+        id_map_free(&table->free_ids);
+        free(table);
+        return shared;
+}
+
+/********** borrow_program ********
+ *
+ * Function that makes a shared program segment 0 of an empty table. The
+ * table reads the shared words and decoded copy in place; it makes its
+ * own copy of both if it stores to segment 0 (see store_memory), and lets
+ * go of them if it loads another program.
+ *
+ * Parameters:
+ *      const struct shared_program *shared: the shared program, which must
+ *                            outlive the table's use of it
+ *      struct segment_table *table: a table from make_table(), with nothing
+ *                            mapped
+ *
+ * Return: void
+ *
+ * Notes:
+ *     nothing borrow_program() or a borrowing table does writes to shared,
+ *     so tables on different threads can borrow the same one
+ ************************/
+void borrow_program(const struct shared_program *shared,
+                    struct segment_table *table)
+{
+        assert(shared != NULL && table != NULL);
+        uint32_t id = new_id(table);
+        assert(id == 0);
+        table->segments[0].address = shared->words;
+        table->segments[0].size = shared->size;
+        table->program = shared->program;
+        table->borrowed = shared;
+        table->generation++;
+        count_segment(table, shared->size);
+        memcpy(table->fusion.sites, shared->sites, sizeof(shared->sites));
+}
 
+/********** free_shared ********
+ *
+ * Function that frees a shared program
+ *
+ * Parameters:
+ *      struct shared_program *shared: the shared program, which no table
+ *                            borrows any more
+ *
+ * Return: void
+ ************************/
+void free_shared(struct shared_program *shared)
+{
+        if (shared == NULL) {
+                return;
+        }
+        pool_free(&shared->pool, shared->words, shared->size);
+        pool_release(&shared->pool);
+        free(shared->program);
+        free(shared);
+}
 
+/********** restore_table ********
+ *
+ * Function that fills an empty table with the segments of a restored
+ * snapshot and decodes its segment 0
+ *
+ * Parameters:
+ *      struct segment_table *table: a table from make_table(), with nothing
+ *                            mapped
+ *      const struct segment *segments: the table entries, indexed by id:
+ *                            mapped ones point into image, unmapped ones
+ *                            hold NULL and 0
+ *      uint32_t length:      ids handed out, at least 1 (segment 0)
+ *      uint32_t shared_with: the id whose words segment 0 shares, or
+ *                            NO_SEGMENT
+ *      void *image:          the private mapping of the snapshot, which
+ *                            the table now owns
+ *      size_t image_size:    bytes mapped at image
+ *
+ * Return: void
+ *
+ * Notes:
+ *     the words are not copied: pages of the snapshot are read in as the
+ *     program first touches them, and copied by the kernel as it first
+ *     writes them. Only segment 0 is read up front, to decode it.
+ ************************/
+void restore_table(struct segment_table *table,
+                   const struct segment *segments, uint32_t length,
+                   uint32_t shared_with, void *image, size_t image_size)
+{
+        assert(table != NULL && table->length == 0 && length > 0);
+        if (length > table->capacity) {
+                grow_segments(table, length);
+        }
+        memcpy(table->segments, segments, length * sizeof(struct segment));
+        table->length = length;
+        table->shared_with = shared_with;
+        table->image = image;
+        table->image_size = image_size;
+        for (uint32_t id = 0; id < length; id++) {
+                if (segments[id].address != NULL) {
+                        count_segment(table, segments[id].size);
+                } else {
+                        id_map_put(&table->free_ids, id);
+                }
+        }
+        decode_program(table);
+}
 
-       
\ No newline at end of file
+/********** report_cap ********
+ *
+ * Function that reports to stderr the map or load program a table's caps
+ * just refused
+ *
+ * Parameters:
+ *      const struct segment_table *table: the segment table
+ *
+ * Return: void
+ ************************/
+void report_cap(const struct segment_table *table)
+{
+        const struct memory_stats *memory = &table->memory;
+        fprintf(stderr, "um: a segment of %u words would take the program "
+                "over its memory cap (%u segments of %llu words mapped",
+                memory->refused_words, memory->live_segments,
+                (unsigned long long)memory->live_words);
+        if (table->max_segments != UINT64_MAX) {
+                fprintf(stderr, "; at most %llu segments",
+                        (unsigned long long)table->max_segments);
+        }
+        if (table->max_words != UINT64_MAX) {
+                fprintf(stderr, "; at most %llu words",
+                        (unsigned long long)table->max_words);
+        }
+        fprintf(stderr, ")\n");
+}
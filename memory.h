@@ -2,17 +2,41 @@
  *     memory.h
  *     Sophie Zhou (szhou13), Angela Yan (yyan08)
  *     11/19/2024
- *     CS40 HW6 
- * 
+ *     CS40 HW6
+ *
  *     Purpose: memory.h defines instructions that deal with and maniuplate
- *              memory. It defines a segement struct, which includes the 
- *              64 bit address for each segment, an integer representing the
- *              segment's id, and the size of the segment. Pointers to this 
- *              struct will be placed in the Hanson sequence (made using 
- *              make_sequence(), that "coatchecks" each segment). make_stack()
- *              creates a new Hanson stack, which we use to keep track of 
- *              unmapped indices. The functions defined in memory.h deal 
- *              with these data structures. 
+ *              memory. Segments are "coatchecked" in a segment table: one
+ *              contiguous, growable array of segments indexed by segment
+ *              id, where each entry holds the 64 bit address of the
+ *              segment's words and its size. Ids that have been unmapped
+ *              are kept in a hierarchical bitmap (idmap.h), and a map
+ *              always reuses the lowest of them, so live segments stay
+ *              packed at the start of the table. Mapping and unmapping
+ *              take a few bit operations; loading and storing are O(1).
+ *              Segment 0 also carries a pre-decoded copy of its
+ *              instructions, which store_memory() and load_program() keep
+ *              up to date. After a load program, segment 0 shares the 
+ *              words of the segment it was loaded from, copy-on-write.
+ *              Common instruction idioms in the decoded copy are fused
+ *              into superinstructions that the interpreter runs in one
+ *              dispatch.
+ *              Segment words come from the recycling allocator in pool.h.
+ *              A table can also borrow segment 0, words and decoded copy
+ *              alike, from a shared_program that any number of tables (on
+ *              any number of threads) run at once; it gets its own copy
+ *              only if it stores to segment 0.
+ *              A table restored from a snapshot (snapshot.h) starts with its
+ *              segments pointing into the snapshot's private mapping; those
+ *              words go back with the mapping, never to the pool.
+ *              In safe mode (memory_options.safe) every segment has guard
+ *              pages after it (see pool.h), and the entries sit at the
+ *              start of a reservation large enough for every id, with the
+ *              entries not yet in use zero: a bad index or id faults
+ *              instead of reaching other memory, for guard.h to report.
+ *              Each table keeps a running account of the memory its
+ *              segments use (struct memory_stats), and refuses a map or
+ *              load program that would take it over the caps it was
+ *              made with.
  */
 
 
@@ -21,41 +45,192 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
-#include "stack.h"
-#include "seq.h"
+#include <stdbool.h>
 #include "assert.h"
- 
+#include "pool.h"
+#include "idmap.h"
 
+/* no segment id, as in segment_table.shared_with */
+#define NO_SEGMENT UINT32_MAX
+
+/*
+ * a pre-decoded instruction; segment 0 keeps one per word alongside its raw
+ * words so that the interpreter never decodes in its hot loop. value holds
+ * the 25-bit immediate of a load-value instruction (whose register is in ra)
+ */
+struct instruction {
+        uint8_t opcode;               /* 0-15, or a superinstruction */
+        uint8_t ra;
+        uint8_t rb;
+        uint8_t rc;
+        uint32_t value;
+};
+
+/*
+ * superinstructions. The fusion pass puts one of these in place of the first
+ * instruction of an idiom; the instructions after it keep their own
+ * decoding, so a jump into the middle of an idiom still works, and so does
+ * any code that reads the first one through plain_opcode()
+ */
+#define OP_NOT 16           /* NAND of $r[B] with itself: $r[A] := ~$r[B] */
+#define OP_LOAD_PAIR 17     /* load value, then another load value */
+#define OP_JUMP 18          /* load value, then load program from it */
+#define OP_COUNT 19
+#define FUSION_KINDS (OP_COUNT - OP_NOT)
+
+/********** plain_opcode ********
+ *
+ * Returns the opcode of the UM instruction a pre-decoded opcode starts with
+ ************************/
+static inline unsigned plain_opcode(unsigned opcode)
+{
+        switch (opcode) {
+        case OP_NOT:
+                return 6;
+        case OP_LOAD_PAIR:
+        case OP_JUMP:
+                return 13;
+        default:
+                return opcode;
+        }
+}
+
+/* how much superinstruction fusion did, indexed by opcode - OP_NOT */
+struct fusion_stats {
+        uint64_t sites[FUSION_KINDS]; /* fused in segment 0 right now */
+        uint64_t fired[FUSION_KINDS]; /* run by run_engine() */
+};
+
+/*
+ * one entry of the segment table. While an id is unmapped its address is
+ * NULL and its size 0
+ */
 struct segment {
-        int id; 
         uint32_t (*address);
-        int size;
+        uint32_t size;
+};
+
+/* settings chosen when the segment table is made */
+struct memory_options {
+        size_t pool_cap;              /* bytes of free segments to keep */
+        uint32_t mmap_threshold;      /* words from which segments are
+                                         anonymous mappings; 0 never */
+        bool fuse;                    /* fuse superinstructions */
+        bool safe;                    /* guard every segment (um --safe) */
+        uint64_t max_words;           /* most words mapped at once; 0 for
+                                         no cap */
+        uint32_t max_segments;        /* most segments mapped at once,
+                                         counting segment 0; 0 for no cap */
+        bool hugepages;               /* back large segments and the
+                                         decoded segment 0 with huge pages
+                                         (not with safe) */
+};
+
+/*
+ * what a table's segments add up to. Segment 0 counts as a segment of its
+ * own even while it shares the words of the segment it was loaded from, so
+ * these are what the program has asked for, which is at least what it
+ * holds. Every figure is kept up to date in O(1) by map, unmap and load
+ * program, which compare a growth with the table's watch_words, the
+ * largest and the cap on segments and only check caps and move the peak
+ * when it crosses one of them.
+ */
+struct memory_stats {
+        uint32_t live_segments;       /* mapped ids, counting segment 0 */
+        uint64_t live_words;          /* words in those segments */
+        uint64_t peak_words;          /* most live_words has been */
+        uint64_t maps;
+        uint64_t unmaps;
+        uint32_t largest;             /* words in the largest ever mapped */
+        uint64_t refused;             /* maps and loads refused by a cap */
+        uint32_t refused_words;       /* the size of the last one refused */
+};
+
+/* bytes of address space a safe table reserves for its entries: enough for
+   every id, so indexing past the entries in use faults */
+#define SAFE_TABLE_BYTES (((size_t)1 << 32) * sizeof(struct segment))
+
+/*
+ * a segment 0 loaded and decoded once, then only read: tables borrow it with
+ * borrow_program() until they store to it or load another program
+ */
+struct shared_program {
+        uint32_t *words;
+        uint32_t size;
+        struct instruction *program;  /* decoded copy, as in a table */
+        uint64_t sites[FUSION_KINDS]; /* superinstructions in program */
+        struct pool pool;             /* the allocator words came from */
+};
+
+struct segment_table {
+        struct segment *segments;     /* indexed by segment id */
+        uint32_t length;              /* ids handed out so far */
+        uint32_t capacity;            /* entries allocated */
+        struct id_map free_ids;       /* unmapped ids below length */
+        uint32_t shared_with;         /* id whose words segment 0 shares */
+        struct instruction *program;  /* pre-decoded copy of segment 0 */
+        const struct shared_program *borrowed; /* segment 0's owner, or
+                                         NULL if the table owns it */
+        void *image;                  /* a restored snapshot that segments
+                                         may still point into, or NULL */
+        size_t image_size;            /* bytes mapped at image */
+        uint64_t generation;          /* bumped when segment 0 is replaced */
+        bool fuse;                    /* fuse superinstructions */
+        bool safe;                    /* entries and words are guarded */
+        uint64_t max_words;           /* caps from memory_options, with */
+        uint64_t max_segments;        /* 0 turned into no cap at all */
+        uint64_t watch_words;         /* the lesser of max_words and the
+                                         peak: live words past it take
+                                         the cold path of a map */
+        struct memory_stats memory;
+        struct fusion_stats fusion;
+        struct pool pool;             /* allocator for segment words */
 };
 
-void initialize_zero(FILE *fp, int arrsize, Seq_T *ids);
+/********** segment_mapped ********
+ *
+ * Returns whether id is a mapped segment of a table, in O(1)
+ ************************/
+static inline bool segment_mapped(const struct segment_table *table,
+                                  uint32_t id)
+{
+        return id < table->length && !id_map_has(&table->free_ids, id);
+}
+
+struct segment_table *make_table(const struct memory_options *options);
+
+void initialize_zero(uint32_t *words, uint32_t arrsize,
+                     struct segment_table *table);
+
+void load_memory(uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers,
+                struct segment_table *table);
+
+void store_memory (uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers,
+                struct segment_table *table);
 
-Seq_T make_sequence();
+bool map_segment(uint32_t rb, uint32_t rc, uint32_t *registers,
+                 struct segment_table *table);
 
-Stack_T make_stack();
+void unmap_segment (uint32_t rc, uint32_t *registers,
+                   struct segment_table *table);
 
-void load_memory(uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers, 
-                Seq_T *ids);
+bool load_program(uint32_t rb, uint32_t rc, uint32_t *registers,
+                  struct segment_table *table, uint32_t *counter);
 
-void store_memory (uint32_t ra, uint32_t rb, uint32_t rc, uint32_t *registers, 
-                Seq_T *ids);
+void report_cap(const struct segment_table *table);
 
-void map_segment(uint32_t rb, uint32_t rc, uint32_t *registers, 
-                Stack_T *unmapped, Seq_T *ids);
+void free_all(struct segment_table *table);
 
-uint32_t free_memory(int seg_num, Seq_T *ids, bool seg0, bool arr);
+struct shared_program *share_program(struct segment_table *table);
 
-void unmap_segment (uint32_t rc, uint32_t *registers, Stack_T *unmapped, 
-                   Seq_T *ids);
+void borrow_program(const struct shared_program *shared,
+                    struct segment_table *table);
 
-void load_program(uint32_t rb, uint32_t rc, uint32_t *registers, Seq_T *ids,
-                  uint32_t *counter);
+void free_shared(struct shared_program *shared);
 
-void free_all(Seq_T ids, Stack_T unmapped);
+void restore_table(struct segment_table *table,
+                   const struct segment *segments, uint32_t length,
+                   uint32_t shared_with, void *image, size_t image_size);
 
 
 
@@ -0,0 +1,447 @@
+/*
+ *     pool.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: pool.c contains the implementation of the segment allocator
+ *     defined in pool.h. A free buffer stores the link to the next free
+ *     buffer of its class in its own first bytes, which is why the smallest
+ *     class holds 2 words rather than 1. Whether a segment is pooled,
+ *     malloced or mapped depends only on its size, so pool_free() can tell
+ *     which way to give a buffer back. A guarded pool keeps its free regions
+ *     on the same free lists, indexed by their number of pages instead. A
+ *     pool with huge pages on maps large segments from aligned regions,
+ *     which it also tells apart by size alone.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "assert.h"
+#include "pool.h"
+
+/********** size_class ********
+ *
+ * Returns the size class of a segment: the log2 of the smallest power of
+ * two, at least 2, that holds words words
+ *
+ * Expects
+ *     words <= POOL_MAX_WORDS
+ ************************/
+static unsigned size_class(uint32_t words)
+{
+        if (words <= 2) {
+                return 1;
+        }
+#ifdef __GNUC__
+        return 32 - __builtin_clz(words - 1);
+#else
+        unsigned k = 1;
+        while (((uint32_t)1 << k) < words) {
+                k++;
+        }
+        return k;
+#endif
+}
+
+/********** is_mapped ********
+ *
+ * Returns whether a segment of words words gets its own anonymous mapping
+ ************************/
+static bool is_mapped(struct pool *pool, uint32_t words)
+{
+        return pool->mmap_threshold != 0 && words >= pool->mmap_threshold;
+}
+
+/********** is_huge ********
+ *
+ * Returns whether a segment of words words gets a mapping aligned for huge
+ * pages
+ ************************/
+static bool is_huge(struct pool *pool, uint32_t words)
+{
+        return pool->hugepages && words >= POOL_HUGE_WORDS;
+}
+
+/********** huge_bytes ********
+ *
+ * Returns the bytes of the mapping a segment of words words is given when
+ * it is aligned for huge pages: its words, rounded up to whole huge pages
+ ************************/
+static size_t huge_bytes(uint32_t words)
+{
+        size_t bytes = (size_t)words * sizeof(uint32_t);
+        return (bytes + POOL_HUGE_BYTES - 1) / POOL_HUGE_BYTES *
+               POOL_HUGE_BYTES;
+}
+
+/********** map_huge ********
+ *
+ * Function that gives a segment its own anonymous mapping, starting on a
+ * huge page boundary and a whole number of huge pages long, and asks for
+ * it to be backed by transparent huge pages. mmap() only promises page
+ * alignment, so a huge page more is reserved and the ends trimmed off.
+ * If the kernel has transparent huge pages turned off the mapping still
+ * works, with small pages.
+ ************************/
+static uint32_t *map_huge(struct pool *pool, uint32_t words)
+{
+        pool->mapped++;
+        pool->huge++;
+        size_t bytes = huge_bytes(words);
+        char *region = mmap(NULL, bytes + POOL_HUGE_BYTES,
+                            PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        assert(region != MAP_FAILED);
+        uintptr_t start = ((uintptr_t)region + POOL_HUGE_BYTES - 1) /
+                          POOL_HUGE_BYTES * POOL_HUGE_BYTES;
+        char *aligned = (char *)start;
+        if (aligned > region) {
+                munmap(region, aligned - region);
+        }
+        munmap(aligned + bytes, region + POOL_HUGE_BYTES - aligned);
+        madvise(aligned, bytes, MADV_HUGEPAGE);
+        return (uint32_t *)aligned;
+}
+
+/********** map_words ********
+ *
+ * Function that gives a segment its own anonymous mapping, which reads as
+ * zero until it is written
+ ************************/
+static uint32_t *map_words(struct pool *pool, uint32_t words)
+{
+        pool->mapped++;
+        void *address = mmap(NULL, (size_t)words * sizeof(uint32_t),
+                             PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        assert(address != MAP_FAILED);
+        return address;
+}
+
+/********** guarded_bytes ********
+ *
+ * Returns the bytes of accessible pages a guarded segment of words words
+ * is given: its words, rounded up to whole pages
+ ************************/
+static size_t guarded_bytes(uint32_t words)
+{
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t bytes = (size_t)words * sizeof(uint32_t);
+        return (bytes + page - 1) / page * page;
+}
+
+/********** map_guarded ********
+ *
+ * Function that gives a segment its own region: whole pages for its words
+ * followed by pool->guard bytes of guard pages. The words are placed at
+ * the end of the accessible pages, so the first word past the segment is
+ * the first byte of the guard. A freed region of the same number of pages
+ * is reused if there is one, and cleared first if zero is true; a new one
+ * reads as zero, its pages supplied only as they are touched.
+ ************************/
+static uint32_t *map_guarded(struct pool *pool, uint32_t words, bool zero)
+{
+        size_t bytes = guarded_bytes(words);
+        size_t pages = bytes / sysconf(_SC_PAGESIZE);
+        char *region;
+        if (pages > 0 && pages <= POOL_CLASSES &&
+            pool->free_lists[pages] != NULL) {
+                pool->hits++;
+                region = pool->free_lists[pages];
+                memcpy(&pool->free_lists[pages], region, sizeof(void *));
+                pool->retained -= bytes;
+                uint32_t *address = (uint32_t *)(region + bytes) - words;
+                if (zero) {
+                        memset(address, 0, (size_t)words * sizeof(uint32_t));
+                }
+                return address;
+        }
+
+        pool->mapped++;
+        region = mmap(NULL, bytes + pool->guard, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (region == MAP_FAILED ||
+            (bytes > 0 && mprotect(region, bytes,
+                                   PROT_READ | PROT_WRITE) != 0)) {
+                fprintf(stderr, "um: --safe: cannot map a guarded segment of "
+                        "%u words (too many segments for vm.max_map_count?)\n",
+                        words);
+                exit(EXIT_FAILURE);
+        }
+        return (uint32_t *)(region + bytes) - words;
+}
+
+/********** unmap_guarded ********
+ *
+ * Function that gives back a segment from map_guarded(), guard and all. A
+ * region of up to POOL_CLASSES pages goes on the free list for its number
+ * of pages, unless the pool is already holding its cap.
+ ************************/
+static void unmap_guarded(struct pool *pool, uint32_t *address,
+                          uint32_t words)
+{
+        size_t bytes = guarded_bytes(words);
+        size_t pages = bytes / sysconf(_SC_PAGESIZE);
+        char *region = (char *)(address + words) - bytes;
+        if (pages > 0 && pages <= POOL_CLASSES &&
+            pool->retained + bytes <= pool->cap) {
+                memcpy(region, &pool->free_lists[pages], sizeof(void *));
+                pool->free_lists[pages] = region;
+                pool->retained += bytes;
+                return;
+        }
+        munmap(region, bytes + pool->guard);
+}
+
+/********** is_pooled ********
+ *
+ * Returns whether a segment of words words comes from the free lists,
+ * which is what pool_alloc(), pool_calloc() and pool_free() check first.
+ * A segment large enough for huge pages never does, since POOL_HUGE_WORDS
+ * is past POOL_MAX_WORDS.
+ ************************/
+static bool is_pooled(struct pool *pool, uint32_t words)
+{
+        return pool->guard == 0 && words <= POOL_MAX_WORDS &&
+               !is_mapped(pool, words);
+}
+
+/********** take_pooled ********
+ *
+ * Function that takes a buffer for a pooled segment of words words off
+ * the free list of its class, or mallocs one if the list is empty
+ ************************/
+static inline uint32_t *take_pooled(struct pool *pool, uint32_t words)
+{
+        unsigned k = size_class(words);
+        void *address = pool->free_lists[k];
+        if (address != NULL) {
+                pool->hits++;
+                memcpy(&pool->free_lists[k], address, sizeof(void *));
+                pool->retained -= sizeof(uint32_t) << k;
+                return address;
+        }
+
+        pool->misses++;
+        address = malloc(sizeof(uint32_t) << k);
+        assert(address != NULL);
+        return address;
+}
+
+/********** give_pooled ********
+ *
+ * Function that puts the buffer of a pooled segment of words words on the
+ * free list of its class, or frees it if the pool holds its cap already
+ ************************/
+static void give_pooled(struct pool *pool, uint32_t *address, uint32_t words)
+{
+        unsigned k = size_class(words);
+        size_t bytes = sizeof(uint32_t) << k;
+        if (pool->retained + bytes > pool->cap) {
+                free(address);
+                return;
+        }
+        memcpy(address, &pool->free_lists[k], sizeof(void *));
+        pool->free_lists[k] = address;
+        pool->retained += bytes;
+}
+
+/********** pool_init ********
+ *
+ * Function that sets up an empty pool
+ *
+ * Parameters:
+ *      struct pool *pool:    the pool
+ *      size_t cap:           the most bytes of free buffers the pool may
+ *                            keep; 0 turns recycling off
+ *      uint32_t mmap_threshold: segments of at least this many words get
+ *                            their own anonymous mapping; 0 turns that off
+ *
+ * Return: void
+ ************************/
+void pool_init(struct pool *pool, size_t cap, uint32_t mmap_threshold)
+{
+        memset(pool, 0, sizeof(*pool));
+        pool->cap = cap;
+        pool->mmap_threshold = mmap_threshold;
+}
+
+/********** alloc_unpooled ********
+ *
+ * Function that allocates a buffer for a segment too large to pool, with
+ * its first words words zero if zero is set. A mapped segment is zero
+ * already, and stays untouched until used. Out of line, which keeps
+ * pool_alloc() and pool_calloc() short for the pooled ones.
+ ************************/
+static uint32_t * __attribute__((noinline))
+alloc_unpooled(struct pool *pool, uint32_t words, bool zero)
+{
+        if (pool->guard != 0) {
+                return map_guarded(pool, words, zero);
+        }
+        if (is_huge(pool, words)) { /* zero already */
+                return map_huge(pool, words);
+        }
+        if (is_mapped(pool, words)) {
+                return map_words(pool, words);
+        }
+        pool->large++;
+        uint32_t *address = malloc((size_t)words * sizeof(uint32_t));
+        assert(address != NULL);
+        if (zero) {
+                memset(address, 0, (size_t)words * sizeof(uint32_t));
+        }
+        return address;
+}
+
+/********** pool_alloc ********
+ *
+ * Function that allocates a buffer for a segment of words words, reusing a
+ * free buffer of the same size class if there is one. The contents are
+ * not cleared.
+ *
+ * Parameters:
+ *      struct pool *pool:    the pool
+ *      uint32_t words:       the size of the segment
+ *
+ * Return: the buffer
+ *
+ * Expects
+ *     pool is not null. The buffer must be given back with pool_free() and
+ *     the same words.
+ ************************/
+uint32_t *pool_alloc(struct pool *pool, uint32_t words)
+{
+        if (is_pooled(pool, words)) {
+                return take_pooled(pool, words);
+        }
+        return alloc_unpooled(pool, words, false);
+}
+
+/********** pool_calloc ********
+ *
+ * Same as pool_alloc, but the first words words of the buffer are zero.
+ * A mapped segment is zero already, and stays untouched until used.
+ ************************/
+uint32_t *pool_calloc(struct pool *pool, uint32_t words)
+{
+        if (is_pooled(pool, words)) {
+                uint32_t *address = take_pooled(pool, words);
+                memset(address, 0, (size_t)words * sizeof(uint32_t));
+                return address;
+        }
+        return alloc_unpooled(pool, words, true);
+}
+
+/********** free_unpooled ********
+ *
+ * Function that gives back the buffer of a segment too large to pool, the
+ * way it was allocated. Out of line, which keeps pool_free() short for the
+ * pooled ones.
+ ************************/
+static void __attribute__((noinline))
+free_unpooled(struct pool *pool, uint32_t *address, uint32_t words)
+{
+        if (pool->guard != 0) {
+                unmap_guarded(pool, address, words);
+        } else if (is_huge(pool, words)) {
+                munmap(address, huge_bytes(words));
+        } else if (is_mapped(pool, words)) {
+                munmap(address, (size_t)words * sizeof(uint32_t));
+        } else {
+                free(address);
+        }
+}
+
+/********** pool_free ********
+ *
+ * Function that gives back the buffer of a segment of words words. It goes
+ * on the free list of its class, unless the pool is already holding its
+ * cap, or it is too large to pool; then it goes back to the system. A
+ * mapped segment is unmapped, returning its pages to the kernel.
+ *
+ * Parameters:
+ *      struct pool *pool:    the pool
+ *      uint32_t *address:    the buffer, from pool_alloc() or pool_calloc()
+ *      uint32_t words:       the size of the segment it was allocated for
+ *
+ * Return: void
+ ************************/
+void pool_free(struct pool *pool, uint32_t *address, uint32_t words)
+{
+        if (address == NULL) {
+                return;
+        }
+        if (is_pooled(pool, words)) {
+                give_pooled(pool, address, words);
+                return;
+        }
+        free_unpooled(pool, address, words);
+}
+
+/********** pool_malloc ********
+ *
+ * Function that allocates a buffer of bytes bytes that is not a segment
+ * (the decoded copy of segment 0), aligned for huge pages like a large
+ * segment when the pool has them on
+ *
+ * Parameters:
+ *      struct pool *pool:    the pool
+ *      size_t bytes:         the size of the buffer
+ *
+ * Return: the buffer, to be given back with free()
+ *
+ * Notes:
+ *     a fresh buffer this large is untouched memory from the kernel, so
+ *     the advice takes effect as its pages are first written
+ ************************/
+void *pool_malloc(struct pool *pool, size_t bytes)
+{
+        void *address = NULL;
+        if (!pool->hugepages || pool->guard != 0 || bytes < POOL_HUGE_BYTES) {
+                address = malloc(bytes);
+                assert(address != NULL);
+                return address;
+        }
+        int status = posix_memalign(&address, POOL_HUGE_BYTES, bytes);
+        assert(status == 0);
+        pool->huge++;
+        madvise(address, bytes / POOL_HUGE_BYTES * POOL_HUGE_BYTES,
+                MADV_HUGEPAGE);
+        return address;
+}
+
+/********** pool_release ********
+ *
+ * Function that returns every free buffer the pool holds to the system
+ *
+ * Parameters:
+ *      struct pool *pool:    the pool
+ *
+ * Return: void
+ ************************/
+void pool_release(struct pool *pool)
+{
+        for (unsigned k = 0; k <= POOL_CLASSES; k++) {
+                void *address = pool->free_lists[k];
+                while (address != NULL) {
+                        void *next;
+                        memcpy(&next, address, sizeof(void *));
+                        if (pool->guard != 0) { /* k pages and a guard */
+                                munmap(address, k * sysconf(_SC_PAGESIZE) +
+                                                pool->guard);
+                        } else {
+                                free(address);
+                        }
+                        address = next;
+                }
+                pool->free_lists[k] = NULL;
+        }
+        pool->retained = 0;
+}
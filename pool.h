@@ -0,0 +1,71 @@
+/*
+ *     pool.h
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: pool.h defines the allocator for segment words. Segments of
+ *              up to POOL_MAX_WORDS words are rounded up to a power-of-two
+ *              size class, and the buffers of unmapped segments are kept on
+ *              a free list per size class to be handed out again by the
+ *              next map of that class, up to a cap on the bytes retained.
+ *              Larger segments go straight to malloc and free, and
+ *              segments of at least the mmap threshold get their own
+ *              anonymous mapping, so the kernel supplies zero pages only as
+ *              they are touched and takes them all back on unmap. The
+ *              caller always passes the segment's size back when freeing,
+ *              so buffers carry no header.
+ *              A guarded pool (for um --safe) maps every segment on its
+ *              own instead, ending right at a run of inaccessible guard
+ *              pages, so reading or writing past its end faults; small
+ *              regions are recycled the same way.
+ *              With huge pages on, segments of at least a huge page are
+ *              mapped on their own from regions aligned to one, whatever
+ *              the mmap threshold, and marked for transparent huge pages,
+ *              so the kernel can back them with 2MB pages and a random
+ *              access misses the TLB far less often.
+ */
+
+#ifndef POOL_INCLUDED
+#define POOL_INCLUDED
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define POOL_CLASSES 16                         /* 2^1 .. 2^16 words */
+#define POOL_MAX_WORDS ((uint32_t)1 << POOL_CLASSES)
+#define POOL_DEFAULT_CAP ((size_t)64 << 20)     /* bytes retained */
+#define POOL_DEFAULT_MMAP_THRESHOLD ((uint32_t)1 << 18) /* words */
+#define POOL_GUARD_BYTES ((size_t)1 << 20)      /* after a guarded one */
+#define POOL_HUGE_BYTES ((size_t)2 << 20)       /* one transparent huge page */
+#define POOL_HUGE_WORDS ((uint32_t)(POOL_HUGE_BYTES / sizeof(uint32_t)))
+
+struct pool {
+        void *free_lists[POOL_CLASSES + 1]; /* indexed by size class */
+        size_t retained;                    /* bytes on the free lists */
+        size_t cap;                         /* most bytes to retain */
+        uint32_t mmap_threshold;            /* words; 0 never maps */
+        size_t guard;                       /* bytes of guard pages after
+                                               every segment; 0 for none */
+        bool hugepages;                     /* huge-page-align large ones */
+        uint64_t hits;                      /* reused a free buffer */
+        uint64_t misses;                    /* pooled size, had to malloc */
+        uint64_t large;                     /* too large to pool */
+        uint64_t mapped;                    /* given their own mapping */
+        uint64_t huge;                      /* buffers aligned for huge
+                                               pages */
+};
+
+void pool_init(struct pool *pool, size_t cap, uint32_t mmap_threshold);
+
+uint32_t *pool_alloc(struct pool *pool, uint32_t words);
+
+uint32_t *pool_calloc(struct pool *pool, uint32_t words);
+
+void pool_free(struct pool *pool, uint32_t *address, uint32_t words);
+
+void *pool_malloc(struct pool *pool, size_t bytes);
+
+void pool_release(struct pool *pool);
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ *     profile.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: profile.c contains the implementation of the execution
+ *     profile defined in profile.h: the growable count arrays the profiled
+ *     interpreter core fills in, and the JSON report written at halt.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "assert.h"
+#include "profile.h"
+
+static const char *const opcode_names[16] = {
+        "cmov", "load", "store", "add", "mul", "div", "nand", "halt",
+        "map", "unmap", "output", "input", "loadprog", "loadval",
+        "invalid14", "invalid15"
+};
+
+static const char *const fusion_names[FUSION_KINDS] = {
+        "not", "load_pair", "jump"
+};
+
+/********** profile_init ********
+ *
+ * Function that sets up an empty profile
+ *
+ * Parameters:
+ *      struct profile *profile: the profile
+ *
+ * Return: void
+ ************************/
+void profile_init(struct profile *profile)
+{
+        assert(profile != NULL);
+        memset(profile, 0, sizeof(*profile));
+}
+
+/********** profile_grow ********
+ *
+ * Function that grows an array of counts, keeping the counts it has and
+ * zeroing the new ones, so that index is in bounds
+ *
+ * Parameters:
+ *      uint64_t **counts:    the array, which may be NULL when *length is 0
+ *      uint32_t *length:     the number of counts in the array
+ *      uint32_t index:       the index that must fit
+ *
+ * Return: void
+ *
+ * Notes:
+ *     the array at least doubles, so a program that keeps growing segment
+ *     0 costs amortized O(1) per count
+ ************************/
+void profile_grow(uint64_t **counts, uint32_t *length, uint32_t index)
+{
+        uint64_t wanted = (uint64_t)*length * 2;
+        if (wanted <= index) {
+                wanted = (uint64_t)index + 1;
+        }
+        if (wanted < 64) {
+                wanted = 64;
+        }
+        if (wanted > UINT32_MAX) {
+                wanted = UINT32_MAX;
+        }
+        uint64_t *grown = realloc(*counts, wanted * sizeof(uint64_t));
+        assert(grown != NULL);
+        memset(grown + *length, 0, (wanted - *length) * sizeof(uint64_t));
+        *counts = grown;
+        *length = wanted;
+}
+
+/********** write_top ********
+ *
+ * Function that writes, as a JSON array, the PROFILE_TOP largest nonzero
+ * counts of an array, largest first. Each element has the count, its share
+ * of total, and either the pc it belongs to (when width is 1) or the first
+ * and last pc of the range it covers
+ *
+ * Parameters:
+ *      FILE *file:           where to write
+ *      const uint64_t *counts: the counts
+ *      uint32_t length:      the number of counts
+ *      uint32_t width:       how many indexes each count covers
+ *      uint64_t total:       the sum of the counts, for each one's share
+ *
+ * Return: void
+ ************************/
+static void write_top(FILE *file, const uint64_t *counts, uint32_t length,
+                      uint32_t width, uint64_t total)
+{
+        bool *taken = calloc(length > 0 ? length : 1, sizeof(bool));
+        assert(taken != NULL);
+        fprintf(file, "[");
+        for (int n = 0; n < PROFILE_TOP; n++) {
+                uint32_t best = length;
+                for (uint32_t i = 0; i < length; i++) {
+                        if (!taken[i] && counts[i] != 0 &&
+                            (best == length || counts[i] > counts[best])) {
+                                best = i;
+                        }
+                }
+                if (best == length) {
+                        break;
+                }
+                taken[best] = true;
+                uint64_t start = (uint64_t)best * width;
+                fprintf(file, "%s\n      {", n == 0 ? "" : ",");
+                if (width == 1) {
+                        fprintf(file, "\"pc\": %llu, ",
+                                (unsigned long long)start);
+                } else {
+                        fprintf(file, "\"start\": %llu, \"end\": %llu, ",
+                                (unsigned long long)start,
+                                (unsigned long long)(start + width - 1));
+                }
+                fprintf(file, "\"count\": %llu, \"share\": %.4f}",
+                        (unsigned long long)counts[best],
+                        total == 0 ? 0.0 : (double)counts[best] / total);
+        }
+        fprintf(file, "\n    ]");
+        free(taken);
+}
+
+/********** profile_write ********
+ *
+ * Function that writes the profile as a JSON object
+ *
+ * Parameters:
+ *      const struct profile *profile: the profile of a finished run
+ *      const char *path:     the file to write, or "-" for stderr
+ *      uint64_t count:       the number of instructions executed
+ *      uint64_t run_ns:      time from the first instruction to halt
+ *
+ * Return: void
+ *
+ * Notes:
+ *     opcodes counts the UM instructions each superinstruction ran under
+ *     their own opcodes; superinstructions counts the dispatches. ns is
+ *     given for the timed opcodes only, and includes the cost of reading
+ *     the clock twice per instruction. The UM fails if path cannot be
+ *     opened.
+ ************************/
+void profile_write(const struct profile *profile, const char *path,
+                   uint64_t count, uint64_t run_ns)
+{
+        FILE *file = strcmp(path, "-") == 0 ? stderr : fopen(path, "w");
+        if (file == NULL) {
+                fprintf(stderr, "um: cannot write profile to %s\n", path);
+                exit(EXIT_FAILURE);
+        }
+
+        uint64_t counts[16];
+        for (int i = 0; i < 16; i++) {
+                counts[i] = profile->dispatches[i];
+        }
+        counts[6] += profile->dispatches[OP_NOT];
+        counts[13] += 2 * profile->dispatches[OP_LOAD_PAIR] +
+                      profile->dispatches[OP_JUMP];
+        counts[12] += profile->fused_jumps;
+
+        fprintf(file, "{\n  \"instructions\": %llu,\n  \"run_ns\": %llu,\n",
+                (unsigned long long)count, (unsigned long long)run_ns);
+        fprintf(file, "  \"opcodes\": [");
+        for (int i = 0; i < 16; i++) {
+                fprintf(file, "%s\n    {\"opcode\": %d, \"name\": \"%s\", "
+                        "\"count\": %llu", i == 0 ? "" : ",", i,
+                        opcode_names[i], (unsigned long long)counts[i]);
+                if (i >= 8 && i <= 12) {
+                        fprintf(file, ", \"ns\": %llu",
+                                (unsigned long long)profile->ns[i]);
+                }
+                fprintf(file, "}");
+        }
+        fprintf(file, "\n  ],\n  \"superinstructions\": [");
+        for (int i = 0; i < FUSION_KINDS; i++) {
+                fprintf(file, "%s\n    {\"name\": \"%s\", \"count\": %llu}",
+                        i == 0 ? "" : ",", fusion_names[i],
+                        (unsigned long long)profile->dispatches[OP_NOT + i]);
+        }
+        fprintf(file, "\n  ],\n  \"load_program\": {\n");
+        fprintf(file, "    \"count\": %llu,\n    \"new_programs\": %llu,\n"
+                "    \"fused_jumps\": %llu,\n    \"sites\": ",
+                (unsigned long long)counts[12],
+                (unsigned long long)profile->new_programs,
+                (unsigned long long)profile->fused_jumps);
+        write_top(file, profile->sites, profile->site_count, 1, counts[12]);
+        fprintf(file, "\n  },\n  \"hot_ranges\": {\n");
+        fprintf(file, "    \"range_words\": %u,\n    \"ranges\": ",
+                PROFILE_RANGE_WORDS);
+        uint64_t dispatched = 0;
+        for (uint32_t i = 0; i < profile->range_count; i++) {
+                dispatched += profile->ranges[i];
+        }
+        write_top(file, profile->ranges, profile->range_count,
+                  PROFILE_RANGE_WORDS, dispatched);
+        fprintf(file, "\n  }\n}\n");
+
+        if (file != stderr) {
+                fclose(file);
+        }
+}
+
+/********** profile_free ********
+ *
+ * Function that frees the count arrays of a profile
+ *
+ * Parameters:
+ *      struct profile *profile: the profile
+ *
+ * Return: void
+ ************************/
+void profile_free(struct profile *profile)
+{
+        free(profile->ranges);
+        free(profile->sites);
+        profile->ranges = NULL;
+        profile->sites = NULL;
+        profile->range_count = 0;
+        profile->site_count = 0;
+}
@@ -0,0 +1,88 @@
+/*
+ *     profile.h
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: profile.h defines the execution profile that --profile
+ *              collects. The profiled copy of the interpreter core (see
+ *              engine.c) counts every instruction by opcode, times the
+ *              expensive ones (map, unmap, output, input and load
+ *              program), keeps a histogram of how many instructions ran in
+ *              each PROFILE_RANGE_WORDS-word range of segment 0, and counts
+ *              how often each load program instruction ran. At halt
+ *              profile_write() reports all of it as JSON.
+ *
+ *              The ordinary interpreter core has none of this compiled in.
+ */
+
+#ifndef PROFILE_INCLUDED
+#define PROFILE_INCLUDED
+#include <stdint.h>
+#include <time.h>
+#include "memory.h"
+
+/* histogram ranges cover 2^PROFILE_RANGE_SHIFT words of segment 0 */
+#define PROFILE_RANGE_SHIFT 6
+#define PROFILE_RANGE_WORDS ((uint32_t)1 << PROFILE_RANGE_SHIFT)
+
+/* how many of the hottest ranges and load program sites are reported */
+#define PROFILE_TOP 32
+
+struct profile {
+        uint64_t dispatches[OP_COUNT];  /* by pre-decoded opcode */
+        uint64_t ns[16];                /* time spent, by UM opcode */
+        uint64_t fused_jumps;           /* load programs done by OP_JUMP */
+        uint64_t new_programs;          /* load programs that copied */
+        uint64_t *ranges;               /* instructions run, by range */
+        uint32_t range_count;
+        uint64_t *sites;                /* load programs run, by pc */
+        uint32_t site_count;
+};
+
+void profile_init(struct profile *profile);
+
+void profile_grow(uint64_t **counts, uint32_t *length, uint32_t index);
+
+void profile_write(const struct profile *profile, const char *path,
+                   uint64_t count, uint64_t run_ns);
+
+void profile_free(struct profile *profile);
+
+/********** profile_now ********
+ *
+ * Returns a monotonic time in nanoseconds
+ ************************/
+static inline uint64_t profile_now(void)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/********** profile_pc ********
+ *
+ * Counts an instruction dispatched at pc in the histogram of segment 0
+ ************************/
+static inline void profile_pc(struct profile *profile, uint32_t pc)
+{
+        uint32_t range = pc >> PROFILE_RANGE_SHIFT;
+        if (range >= profile->range_count) {
+                profile_grow(&profile->ranges, &profile->range_count, range);
+        }
+        profile->ranges[range]++;
+}
+
+/********** profile_site ********
+ *
+ * Counts a run of the load program instruction at pc
+ ************************/
+static inline void profile_site(struct profile *profile, uint32_t pc)
+{
+        if (pc >= profile->site_count) {
+                profile_grow(&profile->sites, &profile->site_count, pc);
+        }
+        profile->sites[pc]++;
+}
+
+#endif
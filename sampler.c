@@ -0,0 +1,470 @@
+/*
+ *     sampler.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: sampler.c contains the implementation of the sampling
+ *     profiler defined in sampler.h: the timer and its signal handler, which
+ *     counts each sample in a fixed table it never allocates from, and the
+ *     folded stacks and hotspots written at halt.
+ *
+ *     The timer runs on the monotonic clock, since the kernel only checks
+ *     CPU-time timers once a scheduler tick. The handler reads the CPU
+ *     time of the core's thread instead, and a tick in which the UM hardly
+ *     ran (it was waiting for input, or for the CPU) is not counted as a
+ *     sample.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "assert.h"
+#include "sampler.h"
+#include "flight.h"
+
+/* older C libraries name the target thread of SIGEV_THREAD_ID only by the
+   union member the kernel reads */
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+/* what the timer signal adds to; set by sampler_start() */
+static struct sampler *active_sampler;
+
+/* one hotspot of the report: an instruction, or a block by its start */
+struct hotspot {
+        uint64_t generation;
+        uint32_t at;
+        uint64_t count;
+};
+
+/********** cpu_now ********
+ *
+ * Returns the CPU time the calling thread, the one running the core, has
+ * used, in nanoseconds
+ ************************/
+static uint64_t cpu_now(void)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/********** image_transfers ********
+ *
+ * Function that finds how many of the latest transfers went into the
+ * segment 0 being run. A load program that replaces segment 0 is followed
+ * at once by a checkpoint of the new generation (flight.h), so that is the
+ * latest checkpoint of it after the latest one of another generation.
+ *
+ * Parameters:
+ *      const struct flight *flight: the flight recorder
+ *      uint32_t newest:      the low bits of the latest transfer's number
+ *      uint64_t generation:  the generation of segment 0 being run
+ *
+ * Return: the number of transfers, at most FLIGHT_TRANSFERS
+ ************************/
+static uint32_t image_transfers(const struct flight *flight, uint32_t newest,
+                                uint64_t generation)
+{
+        uint64_t kept = flight->checkpoint_count < FLIGHT_CHECKPOINTS ?
+                        flight->checkpoint_count : FLIGHT_CHECKPOINTS;
+        uint32_t other = UINT32_MAX;    /* to the latest of another */
+        for (uint64_t i = 0; i < kept; i++) {
+                const struct flight_checkpoint *checkpoint =
+                        &flight->checkpoints[i];
+                uint32_t distance = newest - (uint32_t)checkpoint->number;
+                if (checkpoint->generation != generation &&
+                    distance < other) {
+                        other = distance;
+                }
+        }
+        if (other >= FLIGHT_TRANSFERS) {
+                return FLIGHT_TRANSFERS;
+        }
+        uint32_t first = 0;             /* to the one that replaced it */
+        for (uint64_t i = 0; i < kept; i++) {
+                const struct flight_checkpoint *checkpoint =
+                        &flight->checkpoints[i];
+                uint32_t distance = newest - (uint32_t)checkpoint->number;
+                if (checkpoint->generation == generation &&
+                    distance < other && distance > first) {
+                        first = distance;
+                }
+        }
+        return first + 1;
+}
+
+/********** build_stack ********
+ *
+ * Function that builds the stack of a sample from the latest transfers:
+ * the blocks they went to, each once, in the order they were last entered,
+ * so that a loop, which keeps jumping back into blocks already on the
+ * stack, does not grow it
+ *
+ * Parameters:
+ *      const struct flight *flight: the flight recorder
+ *      uint32_t newest:      the low bits of the latest transfer's number
+ *      uint32_t chain:       how many transfers to look back over, from 1
+ *      uint32_t *frames:     set to the stack, outermost first
+ *
+ * Return: the depth of the stack, SAMPLE_DEPTH at most
+ ************************/
+static uint32_t build_stack(const struct flight *flight, uint32_t newest,
+                            uint32_t chain, uint32_t *frames)
+{
+        uint32_t depth = 0;             /* innermost first, until the end */
+        for (uint32_t back = 0; back < chain && depth < SAMPLE_DEPTH;
+             back++) {
+                uint32_t number = newest - back;
+                uint32_t slot = number % FLIGHT_TRANSFERS;
+                if (number == 0 || flight->transfer_number[slot] != number) {
+                        break; /* before the first transfer */
+                }
+                uint32_t to = flight->transfer_to[slot];
+                uint32_t i = 0;
+                while (i < depth && frames[i] != to) {
+                        i++;
+                }
+                if (i == depth) {
+                        frames[depth++] = to;
+                }
+        }
+        for (uint32_t i = 0; i < depth / 2; i++) {
+                uint32_t frame = frames[i];
+                frames[i] = frames[depth - 1 - i];
+                frames[depth - 1 - i] = frame;
+        }
+        return depth;
+}
+
+/********** same_stack ********
+ *
+ * Returns whether two samples are of the same program counter under the
+ * same stack
+ ************************/
+static bool same_stack(const struct sample_stack *a,
+                       const struct sample_stack *b)
+{
+        return a->generation == b->generation && a->pc == b->pc &&
+               a->depth == b->depth &&
+               memcmp(a->frames, b->frames,
+                      a->depth * sizeof(a->frames[0])) == 0;
+}
+
+/********** hash_stack ********
+ *
+ * Returns the FNV-1a hash of a sample's program counter and stack
+ ************************/
+static uint64_t hash_stack(const struct sample_stack *stack)
+{
+        const unsigned char *bytes = (const unsigned char *)stack;
+        size_t start = offsetof(struct sample_stack, generation);
+        size_t end = offsetof(struct sample_stack, frames) +
+                     stack->depth * sizeof(stack->frames[0]);
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = start; i < end; i++) {
+                hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+        return hash;
+}
+
+/********** take_sample ********
+ *
+ * Function that counts a sample of the running core in its slot of the
+ * table, taking a free one for a new stack while the table is less than
+ * three quarters full
+ *
+ * Parameters:
+ *      struct sampler *sampler: the sampler
+ *      const struct flight *flight: the running core's flight recorder
+ *
+ * Return: void
+ ************************/
+static void take_sample(struct sampler *sampler, const struct flight *flight)
+{
+        struct sample_stack sample;
+        memset(&sample, 0, sizeof(sample));
+        sample.generation = flight->table->generation;
+        uint32_t newest = flight_newest(flight);
+        uint32_t chain = image_transfers(flight, newest, sample.generation);
+        sample.depth = build_stack(flight, newest, chain, sample.frames);
+
+        /* the core is in the block of the latest transfer, at or past it */
+        uint32_t block = sample.depth > 0 ? sample.frames[sample.depth - 1] :
+                         0;
+        uint32_t next = *flight->pc;
+        sample.pc = next > block ? next - 1 : block;
+
+        uint64_t hash = hash_stack(&sample);
+        for (uint32_t i = 0;; i++) {
+                struct sample_stack *slot =
+                        &sampler->stacks[(hash + i) % SAMPLE_SLOTS];
+                if (slot->count == 0) {
+                        if (sampler->used >= SAMPLE_SLOTS / 4 * 3) {
+                                sampler->dropped++;
+                                return;
+                        }
+                        *slot = sample;
+                        sampler->used++;
+                }
+                if (same_stack(slot, &sample)) {
+                        slot->count++;
+                        sampler->samples++;
+                        return;
+                }
+        }
+}
+
+/********** on_tick ********
+ *
+ * The SIGPROF handler: samples the running core, unless the UM hardly ran
+ * since the last tick or the core is not running
+ ************************/
+static void on_tick(int signal)
+{
+        (void)signal;
+        int saved = errno;
+        struct sampler *sampler = active_sampler;
+        const struct flight *flight = &flight_recorder;
+        uint64_t cpu_ns = cpu_now();
+        bool ran = cpu_ns - sampler->cpu_ns >= sampler->period_ns / 2;
+        sampler->cpu_ns = cpu_ns;
+
+        if (flight->pc == NULL) {
+                sampler->outside++;
+        } else if (!ran) {
+                sampler->waiting++;
+        } else {
+                take_sample(sampler, flight);
+        }
+        errno = saved;
+}
+
+/********** sampler_start ********
+ *
+ * Function that starts sampling the calling thread's interpreter core
+ *
+ * Parameters:
+ *      struct sampler *sampler: the sampler, set up here
+ *      uint32_t period_us:   the microseconds between samples
+ *
+ * Return: void
+ *
+ * Expects
+ *     period_us is not 0, and no other sampler is running: there is one
+ *     SIGPROF handler per process
+ *
+ * Notes:
+ *     the timer signals the calling thread alone (SIGEV_THREAD_ID), since
+ *     a process-directed tick may be taken by any thread, and would then
+ *     find no core running there and count as outside
+ ************************/
+void sampler_start(struct sampler *sampler, uint32_t period_us)
+{
+        assert(sampler != NULL && period_us > 0 && active_sampler == NULL);
+        memset(sampler, 0, sizeof(*sampler));
+        sampler->stacks = calloc(SAMPLE_SLOTS, sizeof(struct sample_stack));
+        assert(sampler->stacks != NULL);
+        sampler->period_ns = (uint64_t)period_us * 1000;
+        sampler->cpu_ns = cpu_now();
+        active_sampler = sampler;
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = on_tick;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        int status = sigaction(SIGPROF, &action, NULL);
+        assert(status == 0);
+
+        struct sigevent event;
+        memset(&event, 0, sizeof(event));
+        event.sigev_notify = SIGEV_THREAD_ID; /* not to any thread */
+        event.sigev_signo = SIGPROF;
+        event.sigev_notify_thread_id = syscall(SYS_gettid);
+        status = timer_create(CLOCK_MONOTONIC, &event, &sampler->timer);
+        assert(status == 0);
+        struct itimerspec period;
+        period.it_interval.tv_sec = sampler->period_ns / 1000000000;
+        period.it_interval.tv_nsec = sampler->period_ns % 1000000000;
+        period.it_value = period.it_interval;
+        status = timer_settime(sampler->timer, 0, &period, NULL);
+        assert(status == 0);
+}
+
+/********** sampler_stop ********
+ *
+ * Function that stops taking samples
+ *
+ * Parameters:
+ *      struct sampler *sampler: a sampler that was started
+ *
+ * Return: void
+ ************************/
+void sampler_stop(struct sampler *sampler)
+{
+        assert(sampler != NULL && sampler == active_sampler);
+        timer_delete(sampler->timer);
+        signal(SIGPROF, SIG_IGN); /* a tick may still be pending */
+        active_sampler = NULL;
+}
+
+/********** compare_place ********
+ *
+ * qsort comparison of hotspots by generation, then address
+ ************************/
+static int compare_place(const void *a, const void *b)
+{
+        const struct hotspot *x = a;
+        const struct hotspot *y = b;
+        if (x->generation != y->generation) {
+                return x->generation < y->generation ? -1 : 1;
+        }
+        return x->at < y->at ? -1 : x->at > y->at;
+}
+
+/********** compare_count ********
+ *
+ * qsort comparison of hotspots by count, largest first
+ ************************/
+static int compare_count(const void *a, const void *b)
+{
+        const struct hotspot *x = a;
+        const struct hotspot *y = b;
+        return x->count > y->count ? -1 : x->count < y->count;
+}
+
+/********** report_top ********
+ *
+ * Function that prints to stderr the SAMPLE_TOP instructions, or blocks,
+ * with the most samples
+ *
+ * Parameters:
+ *      const struct sampler *sampler: the sampler
+ *      bool blocks:          whether to report blocks (by the address a
+ *                            jump went to) rather than instructions
+ *
+ * Return: void
+ ************************/
+static void report_top(const struct sampler *sampler, bool blocks)
+{
+        struct hotspot *spots = malloc((sampler->used + 1) *
+                                       sizeof(struct hotspot));
+        assert(spots != NULL);
+        uint32_t length = 0;
+        for (uint32_t i = 0; i < SAMPLE_SLOTS; i++) {
+                const struct sample_stack *slot = &sampler->stacks[i];
+                if (slot->count == 0) {
+                        continue;
+                }
+                spots[length].generation = slot->generation;
+                spots[length].at = !blocks ? slot->pc :
+                                   slot->depth > 0 ?
+                                   slot->frames[slot->depth - 1] : 0;
+                spots[length].count = slot->count;
+                length++;
+        }
+
+        qsort(spots, length, sizeof(struct hotspot), compare_place);
+        uint32_t merged = 0;
+        for (uint32_t i = 0; i < length; i++) {
+                if (merged > 0 && compare_place(&spots[merged - 1],
+                                                &spots[i]) == 0) {
+                        spots[merged - 1].count += spots[i].count;
+                } else {
+                        spots[merged++] = spots[i];
+                }
+        }
+        qsort(spots, merged, sizeof(struct hotspot), compare_count);
+
+        fprintf(stderr, "um: hottest %s:\n",
+                blocks ? "blocks, by the address jumped to" :
+                "instructions");
+        for (uint32_t i = 0; i < merged && i < SAMPLE_TOP; i++) {
+                fprintf(stderr, "um:   %5.1f%%  %8llu  image %llu, %s %u\n",
+                        100.0 * spots[i].count / sampler->samples,
+                        (unsigned long long)spots[i].count,
+                        (unsigned long long)spots[i].generation,
+                        blocks ? "block at" : "pc", spots[i].at);
+        }
+        free(spots);
+}
+
+/********** sampler_write ********
+ *
+ * Function that writes the samples as folded stacks, one line per program
+ * counter and stack with its count, and prints the hottest instructions
+ * and blocks to stderr
+ *
+ * Parameters:
+ *      const struct sampler *sampler: a sampler that was stopped
+ *      const char *path:     the file to write, or "-" for stderr
+ *
+ * Return: void
+ *
+ * Notes:
+ *     a line reads, e.g., "image1;b0;b57;b91;pc93 120": segment 0 of
+ *     generation 1, the blocks jumped to, outermost first, and the
+ *     instruction the samples were taken at. The UM fails if path cannot
+ *     be opened.
+ ************************/
+void sampler_write(const struct sampler *sampler, const char *path)
+{
+        assert(sampler != NULL && sampler != active_sampler);
+        FILE *file = strcmp(path, "-") == 0 ? stderr : fopen(path, "w");
+        if (file == NULL) {
+                fprintf(stderr, "um: cannot write samples to %s\n", path);
+                exit(EXIT_FAILURE);
+        }
+        for (uint32_t i = 0; i < SAMPLE_SLOTS; i++) {
+                const struct sample_stack *slot = &sampler->stacks[i];
+                if (slot->count == 0) {
+                        continue;
+                }
+                fprintf(file, "image%llu",
+                        (unsigned long long)slot->generation);
+                for (uint32_t j = 0; j < slot->depth; j++) {
+                        fprintf(file, ";b%u", slot->frames[j]);
+                }
+                fprintf(file, ";pc%u %llu\n", slot->pc,
+                        (unsigned long long)slot->count);
+        }
+        if (file != stderr) {
+                fclose(file);
+        }
+
+        fprintf(stderr, "um: %llu samples, one every %llu us the UM ran "
+                "(%llu more while it waited, %llu dropped)\n",
+                (unsigned long long)sampler->samples,
+                (unsigned long long)(sampler->period_ns / 1000),
+                (unsigned long long)sampler->waiting,
+                (unsigned long long)sampler->dropped);
+        if (sampler->samples > 0) {
+                report_top(sampler, false);
+                report_top(sampler, true);
+        }
+}
+
+/********** sampler_free ********
+ *
+ * Function that frees the table of a sampler
+ *
+ * Parameters:
+ *      struct sampler *sampler: the sampler
+ *
+ * Return: void
+ ************************/
+void sampler_free(struct sampler *sampler)
+{
+        free(sampler->stacks);
+        sampler->stacks = NULL;
+        sampler->used = 0;
+}
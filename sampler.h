@@ -0,0 +1,68 @@
+/*
+ *     sampler.h
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: sampler.h defines the sampling profiler that --sample runs.
+ *              Where --profile (profile.h) counts every instruction in a
+ *              copy of the interpreter core built for it, the sampler
+ *              leaves the ordinary core alone: a timer interrupts the UM
+ *              every so often, and the handler reads where the core is
+ *              from its flight recorder (flight.h), which the core keeps
+ *              anyway: the program counter, the segment 0 it is running
+ *              (by generation, so a replaced program is told apart), and
+ *              the last jumps it made.
+ *
+ *              Each sample is counted under its stack: the blocks of
+ *              straight-line code the latest jumps went to, each once, in
+ *              the order they were last entered, so each jump is a call
+ *              edge from the block whose load program made it, and a loop
+ *              does not deepen the stack however often it goes round. At
+ *              halt sampler_write() writes the counts in the folded-stack
+ *              format flame graph tools read, and prints the hottest
+ *              instructions and blocks to stderr.
+ */
+
+#ifndef SAMPLER_INCLUDED
+#define SAMPLER_INCLUDED
+#include <stdint.h>
+#include <time.h>
+
+#define SAMPLE_DEPTH 16                 /* frames kept per stack */
+#define SAMPLE_SLOTS ((uint32_t)1 << 16) /* distinct stacks kept */
+#define SAMPLE_TOP 10                   /* hotspots reported */
+#define SAMPLE_DEFAULT_US 1000          /* default period */
+
+/* the samples taken at one program counter under one stack */
+struct sample_stack {
+        uint64_t count;                 /* 0 for a free slot */
+        uint64_t generation;            /* of segment 0 (memory.h) */
+        uint32_t pc;
+        uint32_t depth;
+        uint32_t frames[SAMPLE_DEPTH];  /* where the jumps on the stack
+                                           went, outermost first */
+};
+
+struct sampler {
+        struct sample_stack *stacks;    /* SAMPLE_SLOTS, open addressing */
+        uint32_t used;                  /* slots in use */
+        uint64_t samples;               /* counted */
+        uint64_t waiting;               /* while the UM did not run, as
+                                           when waiting for input */
+        uint64_t outside;               /* while the core was not running */
+        uint64_t dropped;               /* with no slot left for them */
+        uint64_t period_ns;
+        uint64_t cpu_ns;                /* CPU time at the last tick */
+        timer_t timer;
+};
+
+void sampler_start(struct sampler *sampler, uint32_t period_us);
+
+void sampler_stop(struct sampler *sampler);
+
+void sampler_write(const struct sampler *sampler, const char *path);
+
+void sampler_free(struct sampler *sampler);
+
+#endif
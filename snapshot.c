@@ -0,0 +1,320 @@
+/*
+ *     snapshot.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: snapshot.c contains the implementation of snapshots, defined
+ *     in snapshot.h. Segment 0 is saved once even while it shares the words
+ *     of another segment (after a load program): both directory entries
+ *     point at the same words, and the restored table shares them again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "snapshot.h"
+
+#define SNAPSHOT_MAGIC "UMSNAP\r\n"     /* 8 bytes, no terminator */
+#define BYTE_ORDER_MARK 0x01020304      /* reads back the same way round */
+
+/* the directory offset of an unmapped id */
+#define UNMAPPED UINT64_MAX
+
+/* 64-bit FNV-1a, taken a word at a time */
+#define CHECKSUM_SEED 14695981039346656037ULL
+#define CHECKSUM_PRIME 1099511628211ULL
+
+struct header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t registers[8];
+        uint32_t counter;
+        uint32_t length;                /* directory entries */
+        uint32_t free_ids;              /* unmapped entries */
+        uint32_t shared_with;
+        uint64_t data_offset;           /* bytes from the start of the file */
+        uint64_t data_words;
+        uint64_t data_checksum;         /* of the words, in directory order */
+        uint64_t header_checksum;       /* of the header, with this field 0,
+                                           and then the directory */
+};
+
+/* one entry of the directory, for the segment id it is indexed by */
+struct entry {
+        uint64_t offset;                /* words from the start of the data,
+                                           or UNMAPPED */
+        uint32_t size;                  /* words, or 0 */
+        uint32_t unused;
+};
+
+/********** checksum ********
+ *
+ * Returns hash updated with count words
+ ************************/
+static uint64_t checksum(uint64_t hash, const uint32_t *words, size_t count)
+{
+        for (size_t i = 0; i < count; i++) {
+                hash ^= words[i];
+                hash *= CHECKSUM_PRIME;
+        }
+        return hash;
+}
+
+/********** header_checksum ********
+ *
+ * Returns the checksum of a header, which must have its own checksum field
+ * zero, followed by its directory
+ ************************/
+static uint64_t header_checksum(const struct header *header,
+                                const struct entry *entries)
+{
+        uint64_t hash = checksum(CHECKSUM_SEED, (const uint32_t *)header,
+                                 sizeof(*header) / sizeof(uint32_t));
+        return checksum(hash, (const uint32_t *)entries,
+                        (size_t)header->length * sizeof(struct entry) /
+                        sizeof(uint32_t));
+}
+
+/********** has_words ********
+ *
+ * Returns whether the words of segment id are saved under its own entry:
+ * it is mapped and is not segment 0 sharing another segment's words
+ ************************/
+static bool has_words(uint32_t id, uint64_t offset, uint32_t shared_with)
+{
+        return offset != UNMAPPED && (id != 0 || shared_with == NO_SEGMENT);
+}
+
+/********** bad_snapshot ********
+ *
+ * Function that reports a snapshot that cannot be restored and fails
+ ************************/
+static void bad_snapshot(const char *path, const char *why)
+{
+        fprintf(stderr, "um: cannot restore %s: %s\n", path, why);
+        exit(EXIT_FAILURE);
+}
+
+/********** snapshot_write ********
+ *
+ * Function that saves the complete state of a machine to a snapshot file
+ *
+ * Parameters:
+ *      const char *path:     the file to write, replaced if it exists
+ *      const uint32_t *registers: the 8 registers
+ *      uint32_t counter:     the program counter
+ *      const struct segment_table *table: the segment table
+ *
+ * Return: void
+ *
+ * Expects
+ *     the table does not borrow its segment 0 (see borrow_program), and the
+ *     file can be created; the UM fails otherwise
+ *
+ * Notes:
+ *     the machine's input and output are not part of the state: output
+ *     should be flushed first, and the machine restored with the input it
+ *     has not read yet
+ ************************/
+void snapshot_write(const char *path, const uint32_t *registers,
+                    uint32_t counter, const struct segment_table *table)
+{
+        assert(registers != NULL && table != NULL &&
+               table->borrowed == NULL);
+        FILE *file = fopen(path, "wb");
+        if (file == NULL) {
+                fprintf(stderr, "um: cannot create snapshot %s\n", path);
+                exit(EXIT_FAILURE);
+        }
+
+        struct header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.byte_order = BYTE_ORDER_MARK;
+        memcpy(header.registers, registers, sizeof(header.registers));
+        header.counter = counter;
+        header.length = table->length;
+        header.free_ids = table->free_ids.free;
+        header.shared_with = table->shared_with;
+
+        /* lay out the words of each mapped segment, in id order */
+        struct entry *entries = calloc(table->length, sizeof(struct entry));
+        assert(entries != NULL);
+        for (uint32_t id = 0; id < table->length; id++) {
+                const struct segment *seg = &table->segments[id];
+                entries[id].size = seg->size;
+                if (seg->address == NULL) {
+                        entries[id].offset = UNMAPPED;
+                } else if (id != 0 || table->shared_with == NO_SEGMENT) {
+                        entries[id].offset = header.data_words;
+                        header.data_words += seg->size;
+                }
+        }
+        if (table->shared_with != NO_SEGMENT) {
+                entries[0].offset = entries[table->shared_with].offset;
+        }
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t used = sizeof(header) + table->length * sizeof(struct entry);
+        header.data_offset = (used + page - 1) / page * page;
+
+        /* the header goes in again at the end, with its checksums */
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(entries, sizeof(struct entry), table->length, file);
+        for (; used < header.data_offset; used++) {
+                putc(0, file);
+        }
+        uint64_t hash = CHECKSUM_SEED;
+        for (uint32_t id = 0; id < table->length; id++) {
+                if (has_words(id, entries[id].offset, table->shared_with)) {
+                        const struct segment *seg = &table->segments[id];
+                        fwrite(seg->address, sizeof(uint32_t), seg->size,
+                               file);
+                        hash = checksum(hash, seg->address, seg->size);
+                }
+        }
+        header.data_checksum = hash;
+        header.header_checksum = header_checksum(&header, entries);
+        rewind(file);
+        fwrite(&header, sizeof(header), 1, file);
+        free(entries);
+
+        bool failed = ferror(file) != 0;
+        if (fclose(file) != 0 || failed) {
+                fprintf(stderr, "um: cannot write snapshot %s\n", path);
+                exit(EXIT_FAILURE);
+        }
+}
+
+/********** snapshot_restore ********
+ *
+ * Function that restores a machine from a snapshot file
+ *
+ * Parameters:
+ *      const char *path:     the snapshot file
+ *      const struct memory_options *options: settings for the new table
+ *      bool verify:          whether to check the checksum of the words
+ *                            too, which reads every page of the file
+ *      uint32_t *registers:  set to the 8 saved registers
+ *      uint32_t *counter:    set to the saved program counter
+ *
+ * Return: the restored segment table, to be freed with free_all()
+ *
+ * Expects
+ *     registers and counter are not null. A file that is not a snapshot,
+ *     is of another version or byte order, fails a checksum or does not
+ *     hold together is reported, and the UM fails.
+ *
+ * Notes:
+ *     the header and directory are always checked; the words are only
+ *     checked with verify, since that defeats reading them in lazily
+ ************************/
+struct segment_table *snapshot_restore(const char *path,
+                                       const struct memory_options *options,
+                                       bool verify, uint32_t *registers,
+                                       uint32_t *counter)
+{
+        assert(registers != NULL && counter != NULL);
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+                bad_snapshot(path, "cannot open it");
+        }
+        struct stat info;
+        int status = fstat(fd, &info);
+        assert(status == 0);
+        size_t size = info.st_size;
+        if (!S_ISREG(info.st_mode) || size < sizeof(struct header)) {
+                bad_snapshot(path, "not a snapshot");
+        }
+        char *image = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                           fd, 0);
+        assert(image != MAP_FAILED);
+        close(fd);
+
+        struct header header;
+        memcpy(&header, image, sizeof(header));
+        if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+                bad_snapshot(path, "not a snapshot");
+        }
+        if (header.byte_order != BYTE_ORDER_MARK) {
+                bad_snapshot(path, "saved with the other byte order");
+        }
+        if (header.version != SNAPSHOT_VERSION) {
+                fprintf(stderr, "um: cannot restore %s: version %u, not %u\n",
+                        path, header.version, SNAPSHOT_VERSION);
+                exit(EXIT_FAILURE);
+        }
+        size_t directory = (size_t)header.length * sizeof(struct entry);
+        if (header.length == 0 ||
+            directory > size - sizeof(header) ||
+            header.data_offset % sizeof(uint32_t) != 0 ||
+            header.data_offset > size ||
+            header.data_words > (size - header.data_offset) /
+                                sizeof(uint32_t)) {
+                bad_snapshot(path, "truncated or malformed");
+        }
+        const struct entry *entries = (const struct entry *)
+                                      (image + sizeof(header));
+        uint64_t expected = header.header_checksum;
+        header.header_checksum = 0;
+        if (header_checksum(&header, entries) != expected) {
+                bad_snapshot(path, "header checksum mismatch");
+        }
+
+        uint32_t *data = (uint32_t *)(image + header.data_offset);
+        struct segment *segments = malloc(header.length *
+                                          sizeof(struct segment));
+        assert(segments != NULL);
+        uint64_t hash = CHECKSUM_SEED;
+        uint32_t unmapped = 0;
+        for (uint32_t id = 0; id < header.length; id++) {
+                const struct entry *entry = &entries[id];
+                segments[id].size = entry->size;
+                if (entry->offset == UNMAPPED) {
+                        segments[id].address = NULL;
+                        segments[id].size = 0;
+                        unmapped++;
+                        continue;
+                }
+                if (entry->offset > header.data_words ||
+                    entry->size > header.data_words - entry->offset) {
+                        bad_snapshot(path, "segment outside the data");
+                }
+                /* an empty segment still needs an address in the image */
+                segments[id].address = entry->size > 0 ?
+                                       data + entry->offset :
+                                       (uint32_t *)image;
+                if (verify && has_words(id, entry->offset,
+                                        header.shared_with)) {
+                        hash = checksum(hash, segments[id].address,
+                                        entry->size);
+                }
+        }
+        if (segments[0].address == NULL ||
+            header.counter > segments[0].size ||
+            unmapped != header.free_ids ||
+            (header.shared_with != NO_SEGMENT &&
+             (header.shared_with == 0 ||
+              header.shared_with >= header.length ||
+              entries[header.shared_with].offset != entries[0].offset))) {
+                bad_snapshot(path, "inconsistent segment table");
+        }
+        if (verify && hash != header.data_checksum) {
+                bad_snapshot(path, "data checksum mismatch");
+        }
+
+        struct segment_table *table = make_table(options);
+        restore_table(table, segments, header.length, header.shared_with,
+                      image, size);
+        free(segments);
+        memcpy(registers, header.registers, sizeof(header.registers));
+        *counter = header.counter;
+        return table;
+}
@@ -0,0 +1,40 @@
+/*
+ *     snapshot.h
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: snapshot.h defines snapshots: the complete state of a
+ *              machine (registers, program counter, every entry of the
+ *              segment table with the words of each mapped segment, and
+ *              which ids are unmapped) saved to a file, so that a
+ *              program's start-up work can be done once and the machine
+ *              started again from where it left off. A snapshot is
+ *              restored by memory-mapping it: segments point straight into
+ *              the private mapping, and their pages are read in only as
+ *              the program touches them.
+ *
+ *              The file is a header, a directory of table entries, and
+ *              then, from the next page boundary, the words of every
+ *              mapped segment. Numbers are in host byte order. The header
+ *              carries a version, a byte order mark, and checksums of
+ *              itself with the directory and of the words.
+ */
+
+#ifndef SNAPSHOT_INCLUDED
+#define SNAPSHOT_INCLUDED
+#include <stdbool.h>
+#include <stdint.h>
+#include "memory.h"
+
+#define SNAPSHOT_VERSION 2
+
+void snapshot_write(const char *path, const uint32_t *registers,
+                    uint32_t counter, const struct segment_table *table);
+
+struct segment_table *snapshot_restore(const char *path,
+                                       const struct memory_options *options,
+                                       bool verify, uint32_t *registers,
+                                       uint32_t *counter);
+
+#endif
@@ -0,0 +1,181 @@
+/*
+ *     cases.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: cases writes the small .um programs the scripts in tests/
+ *     run to stdout. Each is a case that once went wrong; the script that
+ *     runs it says what the UM must do with it.
+ *
+ *     Usage: cases <case> > program.um
+ *
+ *     Cases:
+ *      map-div     maps a segment, then divides by zero; the flight
+ *                  recorder must blame the division, not the map
+ *      map-load    maps a 4-word segment, then loads word 9 of it, which
+ *                  --safe stops at; the load must be blamed, not the map
+ *      store-div   overwrites its own first instruction (a load value of
+ *                  1 into r3) with a load value of 2, then divides r3 by
+ *                  zero; the replay must not run the stored instruction
+ *                  as if it had been there from the start
+ *      jump-halt   prints A, B, C and so on round a loop that ends in a
+ *                  fused jump back to its top, until on the 20th time
+ *                  round it overwrites the load program of that jump with
+ *                  a halt, just ahead of itself; every engine must stop
+ *                  there, after printing A to T, whether or not the loop
+ *                  was compiled or the jump fused
+ *      invalid     prints A, reaches opcode 14, then would print B; every
+ *                  engine must fail there, after printing only A
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* a program being assembled */
+struct program {
+        uint32_t *words;
+        size_t length;
+        size_t capacity;
+};
+
+/********** emit ********
+ *
+ * Appends one word to a program and returns its index
+ ************************/
+static size_t emit(struct program *p, uint32_t word)
+{
+        if (p->length == p->capacity) {
+                p->capacity = p->capacity ? 2 * p->capacity : 64;
+                p->words = realloc(p->words, p->capacity * sizeof(uint32_t));
+                if (p->words == NULL) {
+                        perror("cases");
+                        exit(1);
+                }
+        }
+        p->words[p->length] = word;
+        return p->length++;
+}
+
+/* three-register instruction */
+static uint32_t op(unsigned opcode, unsigned a, unsigned b, unsigned c)
+{
+        return (uint32_t)opcode << 28 | a << 6 | b << 3 | c;
+}
+
+/* load value; value must fit in 25 bits */
+static uint32_t loadval(unsigned a, uint32_t value)
+{
+        return (uint32_t)13 << 28 | a << 25 | value;
+}
+
+static void case_map_div(struct program *p)
+{
+        emit(p, loadval(1, 4));
+        emit(p, op(8, 0, 2, 1));        /* map r2, 4 words */
+        emit(p, loadval(3, 10));
+        emit(p, loadval(4, 0));
+        emit(p, op(5, 5, 3, 4));        /* r5 = 10 / 0 */
+        emit(p, op(7, 0, 0, 0));
+}
+
+static void case_map_load(struct program *p)
+{
+        emit(p, loadval(1, 4));
+        emit(p, op(8, 0, 2, 1));        /* map r2, 4 words */
+        emit(p, loadval(3, 10));
+        emit(p, loadval(4, 9));
+        emit(p, op(1, 5, 2, 4));        /* r5 = m[r2][9] */
+        emit(p, op(7, 0, 0, 0));
+}
+
+static void case_store_div(struct program *p)
+{
+        uint32_t stored = loadval(3, 2);
+
+        emit(p, loadval(3, 1));         /* word 0, overwritten below */
+        emit(p, loadval(7, 0));
+        emit(p, loadval(1, stored >> 16));
+        emit(p, loadval(2, 1 << 16));
+        emit(p, op(4, 1, 1, 2));
+        emit(p, loadval(2, stored & 0xFFFF));
+        emit(p, op(3, 1, 1, 2));        /* r1 = loadval r3, 2 */
+        emit(p, op(2, 7, 7, 1));        /* m[0][0] = r1 */
+        emit(p, loadval(4, 0));
+        emit(p, op(5, 5, 3, 4));        /* r5 = 1 / 0 */
+        emit(p, op(7, 0, 0, 0));
+}
+
+static void case_jump_halt(struct program *p)
+{
+        const uint32_t top = 2, store = 15, jump = 20;
+
+        emit(p, loadval(1, 40));        /* r1 counts down to 20 */
+        emit(p, loadval(2, 'A'));
+        emit(p, op(10, 0, 0, 2));       /* top: output r2 */
+        emit(p, loadval(7, 1));
+        emit(p, op(3, 2, 2, 7));        /* r2 = r2 + 1 */
+        emit(p, loadval(7, 0));
+        emit(p, op(6, 7, 7, 7));
+        emit(p, op(3, 1, 1, 7));        /* r1 = r1 - 1 */
+        emit(p, loadval(7, 19));
+        emit(p, op(6, 7, 7, 7));
+        emit(p, op(3, 5, 1, 7));        /* r5 = r1 - 20 */
+        emit(p, loadval(6, store));
+        emit(p, loadval(7, jump));
+        emit(p, op(0, 6, 7, 5));        /* skip the store unless r1 = 20 */
+        emit(p, op(12, 0, 0, 6));       /* lands on store or jump */
+        emit(p, loadval(3, 0x7000));    /* store: */
+        emit(p, loadval(4, 1 << 16));
+        emit(p, op(4, 3, 3, 4));        /* r3 = halt */
+        emit(p, loadval(4, jump + 1));
+        emit(p, op(2, 0, 4, 3));        /* m[0][jump + 1] = halt */
+        emit(p, loadval(6, top));       /* jump: fused with the next */
+        emit(p, op(12, 0, 0, 6));
+}
+
+static void case_invalid(struct program *p)
+{
+        emit(p, loadval(1, 'A'));
+        emit(p, op(10, 0, 0, 1));
+        emit(p, op(14, 0, 0, 0));       /* not an instruction */
+        emit(p, loadval(1, 'B'));
+        emit(p, op(10, 0, 0, 1));
+        emit(p, op(7, 0, 0, 0));
+}
+
+int main(int argc, char *argv[])
+{
+        if (argc != 2) {
+                fprintf(stderr, "usage: %s <case>\n", argv[0]);
+                return 1;
+        }
+        struct program p = { NULL, 0, 0 };
+
+        if (strcmp(argv[1], "map-div") == 0) {
+                case_map_div(&p);
+        } else if (strcmp(argv[1], "map-load") == 0) {
+                case_map_load(&p);
+        } else if (strcmp(argv[1], "store-div") == 0) {
+                case_store_div(&p);
+        } else if (strcmp(argv[1], "jump-halt") == 0) {
+                case_jump_halt(&p);
+        } else if (strcmp(argv[1], "invalid") == 0) {
+                case_invalid(&p);
+        } else {
+                fprintf(stderr, "%s: unknown case %s\n", argv[0], argv[1]);
+                return 1;
+        }
+
+        for (size_t i = 0; i < p.length; i++) {
+                uint32_t w = p.words[i];
+                putchar(w >> 24);
+                putchar(w >> 16);
+                putchar(w >> 8);
+                putchar(w);
+        }
+        free(p.words);
+        return 0;
+}
@@ -0,0 +1,94 @@
+#!/bin/sh
+#
+#     differential.sh
+#
+#     Runs the jump-halt and invalid cases from cases.c, then random
+#     programs from randprog.c, on every engine and checks each against
+#     --reference: the output, the exit status, the instructions= count
+#     --stats prints and any "um:" report of a failure must be the same.
+#     Each program reads its own bytes as input. Prints each program that
+#     differs, with the commands that show it, and exits with status 1 if
+#     any did.
+#
+#     Usage: UM=path/to/um tests/differential.sh [count [first seed]]
+#
+#     count defaults to 200 programs, first seed to 1. A run that takes
+#     longer than LIMIT seconds (default 10) is killed and counts as a
+#     difference, since every program halts within a fraction of one.
+#
+
+UM=${UM:-./um}
+CC=${CC:-cc}
+TESTS=$(dirname "$0")
+COUNT=${1:-200}
+SEED=${2:-1}
+LIMIT=${LIMIT:-10}
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+$CC -O2 -o "$WORK/randprog" "$TESTS/randprog.c" || exit 1
+$CC -O2 -o "$WORK/cases" "$TESTS/cases.c" || exit 1
+failed=0
+
+# run NAME [UM OPTIONS]: runs prog.um, leaving its output and exit status
+# in NAME.out and its instruction count and any report in NAME.count
+run() {
+        name=$1
+        shift
+        timeout "$LIMIT" "$UM" --stats "$@" "$WORK/prog.um" \
+                < "$WORK/prog.um" > "$WORK/$name.out" 2> "$WORK/$name.err"
+        echo "status $?" >> "$WORK/$name.out"
+        grep -o "instructions=[0-9]*\|^um: .*" "$WORK/$name.err" \
+                > "$WORK/$name.count"
+}
+
+# compare WHAT MAKE: runs prog.um on every engine and reports each that
+# differs from --reference, with MAKE, the command that writes prog.um
+compare() {
+        run reference --reference
+        run default
+        for name in jit jit-check no-fuse; do
+                run $name --$name
+        done
+        for name in default jit jit-check no-fuse; do
+                if ! cmp -s "$WORK/reference.out" "$WORK/$name.out" ||
+                   ! cmp -s "$WORK/reference.count" "$WORK/$name.count"
+                then
+                        options=" --$name"
+                        [ $name = default ] && options=
+                        echo "FAIL $1: $name differs from --reference;" \
+                             "to see it," >&2
+                        echo "  $2 &&" >&2
+                        echo "  $UM --stats$options prog.um < prog.um" >&2
+                        failed=1
+                fi
+        done
+}
+
+# the cases of cases.c that every engine must run alike
+"$WORK/cases" jump-halt > "$WORK/prog.um"
+compare jump-halt "$CC -o cases $TESTS/cases.c && ./cases jump-halt > prog.um"
+if ! grep -q "^ABCDEFGHIJKLMNOPQRSTstatus 0$" "$WORK/reference.out"; then
+        echo "FAIL jump-halt: did not stop after printing A to T" >&2
+        failed=1
+fi
+"$WORK/cases" invalid > "$WORK/prog.um"
+compare invalid "$CC -o cases $TESTS/cases.c && ./cases invalid > prog.um"
+if ! grep -q "^Astatus 1$" "$WORK/reference.out" ||
+   ! grep -q "^um: invalid opcode 14 at 2$" "$WORK/reference.count"; then
+        echo "FAIL invalid: did not fail at opcode 14 after printing A" >&2
+        failed=1
+fi
+
+end=$((SEED + COUNT))
+while [ "$SEED" -lt "$end" ]; do
+        "$WORK/randprog" "$SEED" > "$WORK/prog.um"
+        compare "seed $SEED" "$CC -o randprog $TESTS/randprog.c &&
+  ./randprog $SEED > prog.um"
+        SEED=$((SEED + 1))
+done
+
+if [ $failed -eq 0 ]; then
+        echo "differential: the cases and $COUNT programs agreed"
+fi
+exit $failed
@@ -0,0 +1,54 @@
+#!/bin/sh
+#
+#     flight.sh
+#
+#     Runs the fault cases cases.c makes and checks the flight recorder
+#     dump of each: the instruction marked "=>" must be the one that
+#     failed, with the right reason, and a replay must not show code that
+#     was stored into segment 0 after it ran. Prints each case that fails
+#     and exits with status 1 if any did.
+#
+#     Usage: UM=path/to/um tests/flight.sh
+#
+
+UM=${UM:-./um}
+CC=${CC:-cc}
+TESTS=$(dirname "$0")
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+$CC -O2 -o "$WORK/cases" "$TESTS/cases.c" || exit 1
+failed=0
+
+# expect CASE PATTERN [UM OPTIONS]: the "=>" line of the dump of CASE
+# must match PATTERN
+expect() {
+        name=$1
+        pattern=$2
+        shift 2
+        "$WORK/cases" "$name" > "$WORK/$name.um"
+        "$UM" "$@" "$WORK/$name.um" < /dev/null > /dev/null \
+                2> "$WORK/$name.err"
+        if ! grep "^=>" "$WORK/$name.err" | grep -q "$pattern"; then
+                echo "FAIL $name: wanted => $pattern" >&2
+                cat "$WORK/$name.err" >&2
+                failed=1
+        fi
+}
+
+expect map-div "  4  .*div r5, r3, r4 .*divided by zero"
+if ! grep -q "^um: Floating point exception$" "$WORK/map-div.err"; then
+        echo "FAIL map-div: did not name the signal" >&2
+        failed=1
+fi
+expect map-load "  4  .*load r5, r2, r4 .*past the end of the segment" --safe
+expect store-div "  9  .*div r5, r3, r4 .*divided by zero"
+if grep -q "loadval r3, 2" "$WORK/store-div.err"; then
+        echo "FAIL store-div: replayed the stored instruction" >&2
+        failed=1
+fi
+
+if [ $failed -eq 0 ]; then
+        echo "flight: all cases passed"
+fi
+exit $failed
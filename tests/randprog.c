@@ -0,0 +1,287 @@
+/*
+ *     randprog.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: randprog writes a random .um program to stdout, the same
+ *     one for the same seed on every host. Every program halts, or fails
+ *     at an invalid opcode, without any other fault, so any two engines
+ *     must agree on its output and on how many instructions it ran;
+ *     tests/differential.sh checks that they do.
+ *
+ *     A program is a few counted loops of random instructions, each run
+ *     often enough for the JIT to compile it, followed by a second stage
+ *     the program stores into a new segment and loads as segment 0. The
+ *     instructions cover every opcode and the fused idioms: arithmetic on
+ *     four data registers, loads and stores within a mapped segment that
+ *     is sometimes unmapped and mapped again, output, input, jumps over a
+ *     halt or an invalid opcode (14 or 15), and stores into segment 0
+ *     that rewrite a load value just ahead or one the loop already ran.
+ *     One program in four ends at an invalid opcode instead of a halt, so
+ *     every engine must fail there, with the same output and report.
+ *
+ *     Registers: r0 to r3 hold data, r4 the mapped segment, r5 the loop
+ *     count; r6 and r7 are scratch.
+ *
+ *     Usage: randprog <seed> > program.um
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define MAX_PLACEHOLDERS 64             /* load values a loop may rewrite */
+
+/* a program being assembled */
+struct program {
+        uint32_t *words;
+        size_t length;
+        size_t capacity;
+};
+
+static uint64_t state;                  /* of the generator */
+
+/* xorshift64*: the next random number, below bound */
+static uint32_t random_below(uint32_t bound)
+{
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return (uint32_t)((state * 0x2545F4914F6CDD1DULL) >> 32) % bound;
+}
+
+/********** emit ********
+ *
+ * Appends one word to a program and returns its index
+ ************************/
+static size_t emit(struct program *p, uint32_t word)
+{
+        if (p->length == p->capacity) {
+                p->capacity = p->capacity ? 2 * p->capacity : 64;
+                p->words = realloc(p->words, p->capacity * sizeof(uint32_t));
+                if (p->words == NULL) {
+                        perror("randprog");
+                        exit(1);
+                }
+        }
+        p->words[p->length] = word;
+        return p->length++;
+}
+
+/* three-register instruction */
+static uint32_t op(unsigned opcode, unsigned a, unsigned b, unsigned c)
+{
+        return (uint32_t)opcode << 28 | a << 6 | b << 3 | c;
+}
+
+/* load value; value must fit in 25 bits */
+static uint32_t loadval(unsigned a, uint32_t value)
+{
+        return (uint32_t)13 << 28 | a << 25 | value;
+}
+
+/* a random word that is not an instruction */
+static uint32_t invalid(void)
+{
+        return (uint32_t)(14 + random_below(2)) << 28 |
+               random_below(1 << 28);
+}
+
+/* a random data register */
+static unsigned data(void)
+{
+        return random_below(4);
+}
+
+/********** load_constant ********
+ *
+ * Emits instructions that put any 32 bit value in r6, clobbering r7
+ ************************/
+static void load_constant(struct program *p, uint32_t value)
+{
+        emit(p, loadval(6, value >> 16));
+        emit(p, loadval(7, 1 << 16));
+        emit(p, op(4, 6, 6, 7));
+        emit(p, loadval(7, value & 0xFFFF));
+        emit(p, op(3, 6, 6, 7));
+}
+
+/********** rewrite ********
+ *
+ * Emits a store into segment 0 that makes the load value at index target,
+ * which loads register a, load a new random value. r3 is clobbered.
+ ************************/
+static void rewrite(struct program *p, size_t target, unsigned a)
+{
+        load_constant(p, loadval(a, random_below(1 << 25)));
+        emit(p, loadval(7, target));
+        emit(p, loadval(3, 0));
+        emit(p, op(2, 3, 7, 6));
+}
+
+/********** random_instruction ********
+ *
+ * Emits one random instruction, with whatever it needs around it.
+ * placeholders holds the indices of the load values emitted since top,
+ * which a store may rewrite; segment is the size of the segment in r4.
+ ************************/
+static void random_instruction(struct program *p, size_t *placeholders,
+                               unsigned *count, uint32_t segment)
+{
+        unsigned a = data(), b = data(), c = data();
+        size_t at;
+
+        switch (random_below(16)) {
+        case 0:
+                emit(p, op(0, a, b, c));                /* cmov */
+                break;
+        case 1:
+                emit(p, op(3, a, b, c));                /* add */
+                break;
+        case 2:
+                emit(p, op(4, a, b, c));                /* mul */
+                break;
+        case 3:
+                emit(p, op(6, a, b, c));                /* nand */
+                break;
+        case 4:
+                emit(p, op(6, a, b, b));                /* not */
+                break;
+        case 5:
+                emit(p, loadval(7, 1 + random_below((1 << 25) - 1)));
+                emit(p, op(5, a, b, 7));                /* div */
+                break;
+        case 6:
+                at = emit(p, loadval(a, random_below(1 << 25)));
+                if (*count < MAX_PLACEHOLDERS) {
+                        placeholders[(*count)++] = at;
+                }
+                break;
+        case 7:                                         /* load pair */
+                emit(p, loadval(a, random_below(1 << 25)));
+                emit(p, loadval((a + 1) % 4, random_below(1 << 25)));
+                break;
+        case 8:                                         /* output a byte */
+                emit(p, loadval(7, 255));
+                emit(p, op(6, 6, a, 7));
+                emit(p, op(6, 6, 6, 6));
+                emit(p, op(10, 0, 0, 6));
+                break;
+        case 9:
+                emit(p, loadval(7, random_below(segment)));
+                emit(p, op(1, a, 4, 7));                /* load */
+                break;
+        case 10:
+                emit(p, loadval(7, random_below(segment)));
+                emit(p, op(2, 4, 7, a));                /* store */
+                break;
+        case 11:
+                emit(p, op(11, 0, 0, a));               /* input */
+                break;
+        case 12:                        /* jump over a halt or worse */
+                emit(p, loadval(7, 0));
+                emit(p, loadval(6, p->length + 3));
+                emit(p, op(12, 0, 7, 6));
+                emit(p, random_below(2) ? op(7, 0, 0, 0) : invalid());
+                break;
+        case 13:                                        /* remap */
+                emit(p, op(9, 0, 0, 4));
+                emit(p, loadval(7, segment));
+                emit(p, op(8, 0, 4, 7));
+                break;
+        case 14: /* rewrite a load value the loop has run */
+                if (*count > 0) {
+                        at = placeholders[random_below(*count)];
+                        rewrite(p, at, p->words[at] >> 25 & 7);
+                }
+                break;
+        default: /* rewrite the load value just ahead */
+                rewrite(p, p->length + 8, a);
+                emit(p, loadval(a, random_below(1 << 25)));
+                break;
+        }
+}
+
+/********** random_loop ********
+ *
+ * Emits a loop of up to 30 random instructions, run up to 100 times
+ ************************/
+static void random_loop(struct program *p, uint32_t segment)
+{
+        size_t placeholders[MAX_PLACEHOLDERS];
+        unsigned count = 0;
+        unsigned length = 1 + random_below(30);
+
+        emit(p, loadval(5, 1 + random_below(100)));
+        size_t top = p->length;
+        for (unsigned i = 0; i < length; i++) {
+                random_instruction(p, placeholders, &count, segment);
+        }
+        emit(p, loadval(7, 0));
+        emit(p, op(6, 7, 7, 7));                        /* r7 := ~0 */
+        emit(p, op(3, 5, 5, 7));                        /* r5 := r5 - 1 */
+        emit(p, loadval(6, p->length + 5));             /* after the loop */
+        emit(p, loadval(7, top));
+        emit(p, op(0, 6, 7, 5));                        /* loop while r5 */
+        emit(p, loadval(7, 0));
+        emit(p, op(12, 0, 7, 6));
+}
+
+/********** random_stage ********
+ *
+ * Emits the code of one stage: data registers seeded, a segment of
+ * segment words mapped in r4, and one to four random loops
+ ************************/
+static void random_stage(struct program *p, uint32_t segment)
+{
+        for (unsigned r = 0; r < 4; r++) {
+                emit(p, loadval(r, random_below(1 << 25)));
+        }
+        emit(p, loadval(7, segment));
+        emit(p, op(8, 0, 4, 7));
+        unsigned loops = 1 + random_below(4);
+        for (unsigned i = 0; i < loops; i++) {
+                random_loop(p, segment);
+        }
+}
+
+int main(int argc, char *argv[])
+{
+        if (argc != 2) {
+                fprintf(stderr, "usage: %s <seed>\n", argv[0]);
+                return 1;
+        }
+        state = strtoull(argv[1], NULL, 0) * 2 + 1; /* never 0 */
+        struct program p = { NULL, 0, 0 };
+        struct program second = { NULL, 0, 0 };
+        uint32_t segment = 1 + random_below(64);
+
+        random_stage(&p, segment);
+        random_stage(&second, segment);
+        emit(&second, random_below(4) ? op(7, 0, 0, 0) : invalid());
+
+        /* store the second stage into a new segment, which r4 keeps
+           while it runs as segment 0 */
+        emit(&p, op(9, 0, 0, 4));
+        emit(&p, loadval(5, second.length));
+        emit(&p, op(8, 0, 4, 5));
+        for (size_t i = 0; i < second.length; i++) {
+                load_constant(&p, second.words[i]);
+                emit(&p, loadval(7, i));
+                emit(&p, op(2, 4, 7, 6));
+        }
+        emit(&p, loadval(7, 0));
+        emit(&p, op(12, 0, 4, 7));
+
+        for (size_t i = 0; i < p.length; i++) {
+                uint32_t w = p.words[i];
+                putchar(w >> 24);
+                putchar(w >> 16);
+                putchar(w >> 8);
+                putchar(w);
+        }
+        free(p.words);
+        free(second.words);
+        return 0;
+}
@@ -0,0 +1,424 @@
+/*
+ *     trace.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: trace.c contains the implementation of I/O traces, defined
+ *     in trace.h. A replay reads the whole trace up front into one array
+ *     of input bytes and one of output bytes, so feeding the program and
+ *     checking what it writes are both a memcpy or memcmp per buffer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "io.h"
+#include "trace.h"
+
+#define TRACE_MAGIC "UMTRACE\n"         /* 8 bytes, no terminator */
+
+/* the kinds of event, in the low two bits of a tag */
+#define EVENT_INPUT 0                   /* a byte was read */
+#define EVENT_EOF 1                     /* an input found the input ended */
+#define EVENT_OUTPUT 2                  /* a byte was written */
+#define EVENT_END 3                     /* the run ended */
+
+/* 64-bit FNV-1a, taken a word at a time, as in snapshot.c */
+#define CHECKSUM_SEED 14695981039346656037ULL
+#define CHECKSUM_PRIME 1099511628211ULL
+
+/********** program_checksum ********
+ *
+ * Returns the checksum of the words of segment 0
+ ************************/
+static uint64_t program_checksum(const struct segment_table *table)
+{
+        const struct segment *program = &table->segments[0];
+        uint64_t hash = CHECKSUM_SEED;
+        for (uint32_t i = 0; i < program->size; i++) {
+                hash = (hash ^ program->address[i]) * CHECKSUM_PRIME;
+        }
+        return hash;
+}
+
+/********** put_number ********
+ *
+ * Writes value to a trace as an unsigned LEB128 number
+ ************************/
+static void put_number(struct trace *trace, uint64_t value)
+{
+        while (value >= 0x80) {
+                putc((int)(value & 0x7f) | 0x80, trace->file);
+                value >>= 7;
+        }
+        putc((int)value, trace->file);
+}
+
+/********** put_event ********
+ *
+ * Writes the tag of an event of a kind that happened after count
+ * instructions
+ ************************/
+static void put_event(struct trace *trace, uint64_t count, unsigned kind)
+{
+        assert(count >= trace->last);
+        put_number(trace, (count - trace->last) << 2 | kind);
+        trace->last = count;
+        trace->events++;
+}
+
+/********** trace_create ********
+ *
+ * Function that starts recording a trace of a run of the program in
+ * segment 0
+ *
+ * Parameters:
+ *      struct trace *trace:  the trace to set up
+ *      const char *path:     the file to write it to, which is replaced
+ *      const struct segment_table *table: the segment table, with the
+ *                            program about to run in segment 0
+ *
+ * Return: void
+ *
+ * Notes:
+ *     exits with status 1 if the file cannot be created
+ ************************/
+void trace_create(struct trace *trace, const char *path,
+                  const struct segment_table *table)
+{
+        trace->path = path;
+        trace->last = 0;
+        trace->events = 0;
+        trace->file = fopen(path, "wb");
+        if (trace->file == NULL) {
+                fprintf(stderr, "um: cannot create trace %s\n", path);
+                exit(EXIT_FAILURE);
+        }
+        fwrite(TRACE_MAGIC, 1, 8, trace->file);
+        put_number(trace, TRACE_VERSION);
+        put_number(trace, table->segments[0].size);
+        put_number(trace, program_checksum(table));
+}
+
+/********** trace_input ********
+ *
+ * Function that records what an input instruction read
+ *
+ * Parameters:
+ *      struct trace *trace:  the trace
+ *      uint64_t count:       instructions run before the input
+ *      uint32_t value:       what it read: a byte, or INPUT_EOF
+ *
+ * Return: void
+ ************************/
+void trace_input(struct trace *trace, uint64_t count, uint32_t value)
+{
+        if (value == INPUT_EOF) {
+                put_event(trace, count, EVENT_EOF);
+        } else {
+                put_event(trace, count, EVENT_INPUT);
+                putc((int)value, trace->file);
+        }
+}
+
+/********** trace_output ********
+ *
+ * Function that records a byte an output instruction wrote
+ *
+ * Parameters:
+ *      struct trace *trace:  the trace
+ *      uint64_t count:       instructions run before the output
+ *      uint8_t byte:         the byte
+ *
+ * Return: void
+ ************************/
+void trace_output(struct trace *trace, uint64_t count, uint8_t byte)
+{
+        put_event(trace, count, EVENT_OUTPUT);
+        putc(byte, trace->file);
+}
+
+/********** trace_close ********
+ *
+ * Function that records the end of the run and closes the trace
+ *
+ * Parameters:
+ *      struct trace *trace:  the trace
+ *      uint64_t count:       instructions run in all
+ *
+ * Return: void
+ *
+ * Notes:
+ *     exits with status 1 if the file could not be written
+ ************************/
+void trace_close(struct trace *trace, uint64_t count)
+{
+        put_event(trace, count, EVENT_END);
+        bool failed = ferror(trace->file) != 0;
+        if (fclose(trace->file) != 0 || failed) {
+                fprintf(stderr, "um: cannot write trace %s\n", trace->path);
+                exit(EXIT_FAILURE);
+        }
+        trace->file = NULL;
+}
+
+/********** bad_trace ********
+ *
+ * Reports that a trace cannot be replayed, and why, and exits with status 1
+ ************************/
+static void bad_trace(const char *path, const char *why)
+{
+        fprintf(stderr, "um: cannot replay %s: %s\n", path, why);
+        exit(EXIT_FAILURE);
+}
+
+/********** get_number ********
+ *
+ * Reads an unsigned LEB128 number from the bytes from *next to end into
+ * *value and moves *next past it; returns false if it is cut short or too
+ * long
+ ************************/
+static bool get_number(const uint8_t **next, const uint8_t *end,
+                       uint64_t *value)
+{
+        *value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+                if (*next == end) {
+                        return false;
+                }
+                uint8_t byte = *(*next)++;
+                *value |= (uint64_t)(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0) {
+                        return true;
+                }
+        }
+        return false;
+}
+
+/********** read_file ********
+ *
+ * Reads a whole file into memory; returns it, with its size in *size, or
+ * NULL if it cannot be read
+ ************************/
+static uint8_t *read_file(const char *path, size_t *size)
+{
+        FILE *file = fopen(path, "rb");
+        if (file == NULL) {
+                return NULL;
+        }
+        long length = -1;
+        if (fseek(file, 0, SEEK_END) == 0) {
+                length = ftell(file);
+        }
+        uint8_t *bytes = NULL;
+        if (length >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+                bytes = malloc(length > 0 ? (size_t)length : 1);
+                assert(bytes != NULL);
+                if (fread(bytes, 1, length, file) != (size_t)length) {
+                        free(bytes);
+                        bytes = NULL;
+                }
+        }
+        fclose(file);
+        *size = length;
+        return bytes;
+}
+
+/********** replay_load ********
+ *
+ * Function that reads a trace to replay against the program in segment 0
+ *
+ * Parameters:
+ *      struct replay *replay: the replay to set up
+ *      const char *path:     the trace file
+ *      const struct segment_table *table: the segment table, with the
+ *                            program about to run in segment 0
+ *
+ * Return: void
+ *
+ * Notes:
+ *     exits with status 1, saying why, if the file cannot be read, is not
+ *     a whole trace of a version this UM writes, or was recorded from a
+ *     different program
+ ************************/
+void replay_load(struct replay *replay, const char *path,
+                 const struct segment_table *table)
+{
+        size_t size;
+        uint8_t *bytes = read_file(path, &size);
+        if (bytes == NULL) {
+                bad_trace(path, "cannot read it");
+        }
+        const uint8_t *next = bytes + 8;
+        const uint8_t *end = bytes + size;
+        uint64_t version, words, checksum;
+        if (size < 8 || memcmp(bytes, TRACE_MAGIC, 8) != 0 ||
+            !get_number(&next, end, &version)) {
+                bad_trace(path, "not a UM trace");
+        }
+        if (version != TRACE_VERSION) {
+                bad_trace(path, "written by a different version of the UM");
+        }
+        if (!get_number(&next, end, &words) ||
+            !get_number(&next, end, &checksum)) {
+                bad_trace(path, "cut short");
+        }
+        if (words != table->segments[0].size ||
+            checksum != program_checksum(table)) {
+                bad_trace(path, "recorded from a different program");
+        }
+
+        /* every event has a byte at most, so size bounds both arrays */
+        memset(replay, 0, sizeof(*replay));
+        replay->path = path;
+        replay->input = malloc(size);
+        replay->output = malloc(size);
+        assert(replay->input != NULL && replay->output != NULL);
+        bool ended = false;     /* the input */
+        uint64_t count = 0;
+        for (;;) {
+                uint64_t tag;
+                if (!get_number(&next, end, &tag)) {
+                        bad_trace(path, "cut short");
+                }
+                count += tag >> 2;
+                unsigned kind = tag & 3;
+                if (kind == EVENT_END) {
+                        break;
+                } else if (kind == EVENT_EOF) {
+                        ended = true;
+                        continue;
+                } else if (next == end) {
+                        bad_trace(path, "cut short");
+                } else if (kind == EVENT_OUTPUT) {
+                        replay->output[replay->output_size++] = *next++;
+                } else if (ended) {
+                        bad_trace(path, "input recorded after its end");
+                } else {
+                        replay->input[replay->input_size++] = *next++;
+                }
+        }
+        if (next != end) {
+                bad_trace(path, "data after the end of the run");
+        }
+        replay->instructions = count;
+        free(bytes);
+}
+
+/********** replay_read ********
+ *
+ * An input_fn (see io.h) that hands out the recorded input bytes, then
+ * reports the end of the input
+ *
+ * Parameters:
+ *      void *closure:        the struct replay
+ *      uint8_t *buffer:      where to put them
+ *      size_t size:          the most to put there
+ *
+ * Return: how many it put there, 0 once all of them have been handed out
+ ************************/
+size_t replay_read(void *closure, uint8_t *buffer, size_t size)
+{
+        struct replay *replay = closure;
+        size_t left = replay->input_size - replay->input_next;
+        if (size > left) {
+                size = left;
+        }
+        memcpy(buffer, replay->input + replay->input_next, size);
+        replay->input_next += size;
+        return size;
+}
+
+/********** replay_write ********
+ *
+ * An output_fn (see io.h) that checks output against the recording
+ *
+ * Parameters:
+ *      void *closure:        the struct replay
+ *      const uint8_t *bytes: the bytes the program wrote next
+ *      size_t count:         how many
+ *
+ * Return: void
+ *
+ * Notes:
+ *     exits with status 1, saying at which byte, as soon as the output
+ *     differs from the recording or goes past its end
+ ************************/
+void replay_write(void *closure, const uint8_t *bytes, size_t count)
+{
+        struct replay *replay = closure;
+        const uint8_t *expected = replay->output + replay->output_checked;
+        size_t left = replay->output_size - replay->output_checked;
+        size_t same = 0;
+        size_t compare = count < left ? count : left;
+        if (memcmp(bytes, expected, compare) == 0) {
+                same = compare;
+        } else {
+                while (bytes[same] == expected[same]) {
+                        same++;
+                }
+        }
+        if (same < count) {
+                size_t at = replay->output_checked + same;
+                if (at == replay->output_size) {
+                        fprintf(stderr, "um: replay of %s: output goes on "
+                                "past the %zu bytes recorded\n",
+                                replay->path, replay->output_size);
+                } else {
+                        fprintf(stderr, "um: replay of %s: output byte %zu "
+                                "is %u, recorded as %u\n", replay->path, at,
+                                bytes[same], expected[same]);
+                }
+                exit(EXIT_FAILURE);
+        }
+        replay->output_checked += count;
+}
+
+/********** replay_finish ********
+ *
+ * Function that checks the end of a replayed run against the recording,
+ * and frees the replay
+ *
+ * Parameters:
+ *      struct replay *replay: the replay, with all output flushed
+ *      uint64_t count:       instructions run in all
+ *      uint64_t read:        input bytes the program read (the input
+ *                            buffer may hold more)
+ *
+ * Return: void
+ *
+ * Notes:
+ *     exits with status 1, saying how the run differed, if it wrote less
+ *     than was recorded, read less, or ran a different number of
+ *     instructions
+ ************************/
+void replay_finish(struct replay *replay, uint64_t count, uint64_t read)
+{
+        bool same = true;
+        if (replay->output_checked != replay->output_size) {
+                fprintf(stderr, "um: replay of %s: output stopped after %zu "
+                        "of the %zu bytes recorded\n", replay->path,
+                        replay->output_checked, replay->output_size);
+                same = false;
+        }
+        if (read != replay->input_size) {
+                fprintf(stderr, "um: replay of %s: read %llu of the %zu input "
+                        "bytes recorded\n", replay->path,
+                        (unsigned long long)read, replay->input_size);
+                same = false;
+        }
+        if (count != replay->instructions) {
+                fprintf(stderr, "um: replay of %s: ran %llu instructions, "
+                        "recorded %llu\n", replay->path,
+                        (unsigned long long)count,
+                        (unsigned long long)replay->instructions);
+                same = false;
+        }
+        free(replay->input);
+        free(replay->output);
+        if (!same) {
+                exit(EXIT_FAILURE);
+        }
+}
@@ -0,0 +1,73 @@
+/*
+ *     trace.h
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: trace.h defines I/O traces: a record of every byte a run of
+ *              the UM read with an input instruction and wrote with an
+ *              output instruction, each stamped with how many instructions
+ *              had run before it, and of how many ran in all. Replaying a
+ *              trace feeds the recorded input back to the program as fast
+ *              as it asks for it and checks its output, and its
+ *              instruction count, against the recording, so a run that
+ *              needed a person at a terminal can be repeated exactly.
+ *
+ *              The file is the magic "UMTRACE\n" and then a sequence of
+ *              unsigned LEB128 numbers: the version, the size and checksum
+ *              of segment 0 at the start of the run, and one tag per event,
+ *              (instructions since the last event << 2 | kind), followed by
+ *              the byte for an input or output event. The last event is the
+ *              end of the run. A byte and its tag usually take two bytes
+ *              together.
+ */
+
+#ifndef TRACE_INCLUDED
+#define TRACE_INCLUDED
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "memory.h"
+
+#define TRACE_VERSION 1
+
+/* a trace being recorded */
+struct trace {
+        FILE *file;
+        const char *path;
+        uint64_t last;                  /* instruction count of the last
+                                           event */
+        uint64_t events;
+};
+
+/* a recorded trace being replayed */
+struct replay {
+        const char *path;
+        uint8_t *input;                 /* every byte read, in order */
+        size_t input_size;
+        size_t input_next;              /* next one to hand out */
+        uint8_t *output;                /* every byte written, in order */
+        size_t output_size;
+        size_t output_checked;          /* matched so far */
+        uint64_t instructions;          /* run in all */
+};
+
+void trace_create(struct trace *trace, const char *path,
+                  const struct segment_table *table);
+
+void trace_input(struct trace *trace, uint64_t count, uint32_t value);
+
+void trace_output(struct trace *trace, uint64_t count, uint8_t byte);
+
+void trace_close(struct trace *trace, uint64_t count);
+
+void replay_load(struct replay *replay, const char *path,
+                 const struct segment_table *table);
+
+size_t replay_read(void *closure, uint8_t *buffer, size_t size);
+
+void replay_write(void *closure, const uint8_t *bytes, size_t count);
+
+void replay_finish(struct replay *replay, uint64_t count, uint64_t read);
+
+#endif
@@ -6,89 +6,907 @@
  * 
  *     Purpose: um.c emualtes a "Universal Machine" (UM). The executable
  *     takes a single argument (the pathnmae for a file .um) that contains
- *     machine instructions for the emulator to execute. 
+ *     machine instructions for the emulator to execute. By default the
+ *     program runs on the fast interpreter core (engine.c); --reference
+ *     selects the original execute_instruction() loop instead, and --jit
+ *     the tiered engine that compiles hot code (jit.c). --profile runs the
+ *     profiling build of the fast interpreter core and writes a report of
+ *     where the time went (profile.c); --sample samples the ordinary one
+ *     instead (sampler.c). --batch runs the program once per
+ *     input file, on every core (batch.c). --snapshot saves the
+ *     machine at its first input, and --restore starts from such a
+ *     snapshot instead of a .um file (snapshot.c). --safe turns bad
+ *     segment accesses into a clean failure (guard.c), and
+ *     --max-segment-words and --max-segments cap the program's memory.
+ *     --hugepages backs large segments with transparent huge pages
+ *     (pool.c). --record logs the run's input and output to a trace, and
+ *     --replay runs the program against such a trace (trace.c). A fatal
+ *     signal dumps the last instructions run first (flight.c).
+ *     --max-instructions and --timeout stop a runaway program cleanly.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
 #include "Word.h"
 #include "instructions.h"
-#include <assert.h>
-#include "seq.h"
-#include "stack.h"
+#include "engine.h"
+#include "jit.h"
+#include "loader.h"
+#include "memory.h"
+#include "io.h"
+#include "profile.h"
+#include "batch.h"
+#include "snapshot.h"
+#include "guard.h"
+#include "trace.h"
+#include "flight.h"
+#include "sampler.h"
 
-/********** main TO DO!!!!!!! ********
+/********** run_reference ********
  *
- * void function that checks that the given Pnm_ppm image has an even width
- * and height. If it does not, it simply updates the Pnm_ppm image passed in,
- * deleting one row/column to make it even. 
+ * Function that runs the program in segment 0 on the reference engine, one
+ * execute_instruction() call per instruction, until it halts or the program
+ * counter runs off the end of segment 0
  *
  * Parameters:
- *      Pnm_ppm pixmap:         an instance of a Pnm_ppm image to be checked 
- *      Pnm_ppm new_pixmap:     updated in the function, representing the 
-                                Pnm_ppm image that has even dimensions
- * Return: void
+ *      uint32_t *registers:  a pointer to the registers (an array of 8
+ *                            uint32_t values that represent the registers
+ *                            of the UM)
+ *      uint32_t *counter     a pointer to the program counter
+ *      struct segment_table *table: the segment table
+ *      struct input *in:     the input buffer
+ *      struct output *out:   the output buffer
+ *
+ * Return: the number of instructions executed
  *
  * Expects
- *      pixmap and new_pixmap is not NULL. 
+ *     registers and counter are not null, and segment 0 is loaded
+ ************************/
+static uint64_t run_reference(uint32_t *registers, uint32_t *counter,
+                          struct segment_table *table, struct input *in,
+                          struct output *out)
+{
+        uint32_t length = table->segments[0].size;
+        uint64_t count = 0;
+
+        /* iterate through segment 0, executing instructions */
+        while (*counter < length) {
+                count++;
+                uint32_t word = table->segments[0].address[*counter];
+                uint32_t opcode = get_opcode(word);
+
+                if (opcode == 7) {  /* halt instruction */
+                        break;
+                } else {
+                        execute_instruction(opcode, word, registers, table,
+                                            counter, in, out);
+                }
+                if (opcode == 12 ) { /* load program instruction */
+                        length = table->segments[0].size;
+                }
+        }
+        return count;
+}
+
+/********** elapsed_ns ********
+ *
+ * Returns the nanoseconds of monotonic time since start
+ ************************/
+static uint64_t elapsed_ns(const struct timespec *start)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t)(now.tv_sec - start->tv_sec) * 1000000000 +
+               now.tv_nsec - start->tv_nsec;
+}
+
+/********** anon_huge_kb ********
+ *
+ * Returns how many KB of the process's memory the kernel currently backs
+ * with transparent huge pages, or -1 if it does not say
+ ************************/
+static long anon_huge_kb(void)
+{
+        FILE *file = fopen("/proc/self/smaps_rollup", "r");
+        if (file == NULL) {
+                return -1;
+        }
+        char line[128];
+        long kb = -1;
+        while (fgets(line, sizeof(line), file) != NULL) {
+                if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) {
+                        break;
+                }
+        }
+        fclose(file);
+        return kb;
+}
+
+/********** usage ********
+ *
+ * Prints the command-line usage of the UM and exits with status 1
+ ************************/
+static void usage(const char *program)
+{
+        fprintf(stderr,
+                "usage: %s [options] [filename]\n"
+                "  --reference        run on the reference engine\n"
+                "  --jit              compile hot code to machine code\n"
+                "  --jit-check        --jit, checking compiled code against "
+                "the reference\n"
+                "                     engine as it runs\n"
+                "  --batch LIST       run the program once for each input "
+                "file named in LIST\n"
+                "  --threads N        batch threads (default: one per "
+                "CPU)\n"
+                "  --output-dir DIR   where batch outputs go (default: "
+                "next to each input)\n"
+                "  --snapshot FILE    save the machine to FILE at its first "
+                "input\n"
+                "  --restore FILE     start from the snapshot in FILE "
+                "instead of a program\n"
+                "  --verify-snapshot  with --restore, check every word "
+                "against its checksum\n"
+                "  --safe             fail cleanly on out-of-bounds or "
+                "unmapped segment access\n"
+                "  --max-segment-words N  fail if segments hold more than N "
+                "words at once\n"
+                "  --max-segments N   fail if more than N segments are "
+                "mapped at once\n"
+                "  --hugepages        back large segments with "
+                "transparent huge pages\n"
+                "  --record FILE      log the run's input and output to "
+                "FILE\n"
+                "  --replay FILE      feed the program the input recorded "
+                "in FILE and check\n"
+                "                     its output against it\n"
+                "  --max-instructions N  stop the program after about N "
+                "instructions\n"
+                "  --timeout SECONDS  stop the program after about SECONDS "
+                "seconds\n"
+                "  --no-fuse          run without superinstructions\n"
+                "  --stats            print statistics to stderr at exit\n"
+                "  --profile FILE     write an execution profile to FILE "
+                "(- for stderr) at halt\n"
+                "  --sample FILE      write sampled stacks to FILE (- for "
+                "stderr) at halt\n"
+                "  --sample-period US  microseconds between samples "
+                "(default 1000)\n"
+                "  --line-buffered    flush output at every newline (the "
+                "default on a terminal)\n"
+                "  --pool-cap BYTES   most bytes of unmapped segments to "
+                "keep for reuse\n"
+                "  --mmap-threshold WORDS  map segments of at least WORDS "
+                "words lazily from the\n"
+                "                     kernel (0 disables)\n",
+                program);
+        exit(1);
+}
+
+/********** parse_number ********
+ *
+ * Returns the value of a numeric command-line argument, or prints the usage
+ * and exits if it is missing or not a number
+ ************************/
+static uint64_t parse_number(const char *program, const char *text)
+{
+        char *end;
+        if (text == NULL || *text == '\0') {
+                usage(program);
+        }
+        errno = 0;
+        unsigned long long value = strtoull(text, &end, 0);
+        if (*end != '\0' || errno != 0) {
+                usage(program);
+        }
+        return value;
+}
+
+/********** parse_seconds ********
+ *
+ * Returns the value in nanoseconds of a command-line argument giving a
+ * positive number of seconds, or prints the usage and exits if it is
+ * missing or not one
+ ************************/
+static uint64_t parse_seconds(const char *program, const char *text)
+{
+        char *end;
+        if (text == NULL || *text == '\0') {
+                usage(program);
+        }
+        errno = 0;
+        double seconds = strtod(text, &end);
+        if (*end != '\0' || errno != 0 || !(seconds > 0) ||
+            seconds >= 1e9) {
+                usage(program);
+        }
+        return (uint64_t)(seconds * 1e9);
+}
+
+/********** print_stats ********
+ *
+ * Prints key=value statistics about a finished run to stderr
+ *
+ * Parameters:
+ *      struct segment_table *table: the segment table, before free_all()
+ *      struct input *in:     the input buffer
+ *      struct output *out:   the output buffer, already flushed
+ *      const struct jit_stats *jit: what the JIT did, or NULL if it did not
+ *                            run
+ *      uint64_t startup_ns:  time to first instruction
+ *      uint64_t run_ns:      time from the first instruction to halt
+ *      uint64_t count:       the number of instructions executed
+ ************************/
+static void print_stats(struct segment_table *table, struct input *in,
+                        struct output *out, const struct jit_stats *jit,
+                        uint64_t startup_ns, uint64_t run_ns, uint64_t count)
+{
+        fprintf(stderr, "time_to_first_instruction_ns=%llu\n",
+                (unsigned long long)startup_ns);
+        fprintf(stderr, "run_ns=%llu\n", (unsigned long long)run_ns);
+        fprintf(stderr, "instructions=%llu\n", (unsigned long long)count);
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        fprintf(stderr, "max_rss_kb=%ld\n", usage.ru_maxrss);
+        fprintf(stderr, "input_bytes=%llu\n",
+                (unsigned long long)in->bytes);
+        fprintf(stderr, "input_reads=%llu\n",
+                (unsigned long long)in->reads);
+        fprintf(stderr, "input_mapped=%d\n", in->mapping != NULL);
+        fprintf(stderr, "output_bytes=%llu\n",
+                (unsigned long long)out->bytes);
+        fprintf(stderr, "output_writes=%llu\n",
+                (unsigned long long)out->writes);
+        fprintf(stderr, "pool_hits=%llu\n",
+                (unsigned long long)table->pool.hits);
+        fprintf(stderr, "pool_misses=%llu\n",
+                (unsigned long long)table->pool.misses);
+        fprintf(stderr, "pool_large=%llu\n",
+                (unsigned long long)table->pool.large);
+        fprintf(stderr, "pool_retained_bytes=%llu\n",
+                (unsigned long long)table->pool.retained);
+        fprintf(stderr, "pool_mapped=%llu\n",
+                (unsigned long long)table->pool.mapped);
+        fprintf(stderr, "pool_huge=%llu\n",
+                (unsigned long long)table->pool.huge);
+        fprintf(stderr, "anon_huge_kb=%ld\n", anon_huge_kb());
+        const struct memory_stats *memory = &table->memory;
+        fprintf(stderr, "segments_live=%u\n", memory->live_segments);
+        fprintf(stderr, "segment_words_live=%llu\n",
+                (unsigned long long)memory->live_words);
+        fprintf(stderr, "segment_words_peak=%llu\n",
+                (unsigned long long)memory->peak_words);
+        fprintf(stderr, "segment_maps=%llu\n",
+                (unsigned long long)memory->maps);
+        fprintf(stderr, "segment_unmaps=%llu\n",
+                (unsigned long long)memory->unmaps);
+        fprintf(stderr, "segment_largest=%u\n", memory->largest);
+        fprintf(stderr, "segment_refused=%llu\n",
+                (unsigned long long)memory->refused);
+        uint32_t span = table->length; /* up to the highest mapped id */
+        while (span > 0 && !segment_mapped(table, span - 1)) {
+                span--;
+        }
+        fprintf(stderr, "segment_ids=%u\n", table->length);
+        fprintf(stderr, "segment_ids_free=%u\n", table->free_ids.free);
+        fprintf(stderr, "segment_id_span=%u\n", span);
+        static const char *const fusion_names[FUSION_KINDS] = {
+                "not", "load_pair", "jump"
+        };
+        for (int i = 0; i < FUSION_KINDS; i++) {
+                fprintf(stderr, "fused_%s_sites=%llu\n", fusion_names[i],
+                        (unsigned long long)table->fusion.sites[i]);
+                fprintf(stderr, "fused_%s_fired=%llu\n", fusion_names[i],
+                        (unsigned long long)table->fusion.fired[i]);
+        }
+        if (jit != NULL) {
+                fprintf(stderr, "jit_blocks=%llu\n",
+                        (unsigned long long)jit->blocks);
+                fprintf(stderr, "jit_flushes=%llu\n",
+                        (unsigned long long)jit->flushes);
+                fprintf(stderr, "jit_code_bytes=%llu\n",
+                        (unsigned long long)jit->code_bytes);
+                fprintf(stderr, "jit_checked=%llu\n",
+                        (unsigned long long)jit->checked);
+        }
+}
+
+/********** run_batch_command ********
+ *
+ * Function that runs um --batch, printing key=value statistics to stderr
+ * afterwards if asked to
+ *
+ * Parameters:
+ *      const char *path:     the pathname of the .um file
+ *      const char *list:     the file naming the inputs
+ *      const struct batch_options *options: how to run the jobs
+ *      bool stats:           whether to print statistics
+ *      const struct timespec *start: when the UM started
+ *
+ * Return: void
+ ************************/
+static void run_batch_command(const char *path, const char *list,
+                              const struct batch_options *options,
+                              bool stats, const struct timespec *start)
+{
+        struct batch_stats batch;
+        run_batch(path, list, options, &batch);
+        if (!stats) {
+                return;
+        }
+        fprintf(stderr, "run_ns=%llu\n",
+                (unsigned long long)elapsed_ns(start));
+        fprintf(stderr, "batch_threads=%u\n", batch.threads);
+        fprintf(stderr, "batch_jobs=%llu\n", (unsigned long long)batch.jobs);
+        fprintf(stderr, "batch_failed=%llu\n",
+                (unsigned long long)batch.failed);
+        fprintf(stderr, "batch_steals=%llu\n",
+                (unsigned long long)batch.steals);
+        fprintf(stderr, "instructions=%llu\n",
+                (unsigned long long)batch.instructions);
+}
+
+/********** stop_failed ********
+ *
+ * Function that reports a bounded run of the fast interpreter core that
+ * stopped on an instruction it could not run, and exits with status 1;
+ * returns for any other stop
+ *
+ * Parameters:
+ *      enum engine_stop stop: why the run stopped
+ *      const struct segment_table *table: the segment table
+ *      uint32_t counter:     the program counter the run stopped at
+ *      struct output *out:   the output buffer, flushed before reporting
+ *
+ * Return: void
+ ************************/
+static void stop_failed(enum engine_stop stop,
+                        const struct segment_table *table, uint32_t counter,
+                        struct output *out)
+{
+        if (stop == ENGINE_INVALID) {
+                output_flush(out);
+                fprintf(stderr, "um: invalid opcode %u at %u\n",
+                        table->program[counter].opcode, counter);
+                exit(EXIT_FAILURE);
+        } else if (stop == ENGINE_CAP) {
+                output_flush(out);
+                report_cap(table);
+                exit(EXIT_FAILURE);
+        }
+}
+
+/********** run_to_snapshot ********
+ *
+ * Function that runs the program on the fast interpreter core up to its
+ * first input instruction and saves the machine there
+ *
+ * Parameters:
+ *      const char *path:     the snapshot file to write
+ *      the parameters of run_engine, and
+ *      bool *halted:         set to whether the program halted instead,
+ *                            in which case no snapshot is written
+ *
+ * Return: the number of instructions executed
+ *
+ * Notes:
+ *     output is flushed first, so it is not repeated by a restored machine
+ ************************/
+static uint64_t run_to_snapshot(const char *path, uint32_t *registers,
+                                uint32_t *counter,
+                                struct segment_table *table,
+                                struct input *in, struct output *out,
+                                bool *halted)
+{
+        enum engine_stop stop;
+        uint64_t count = run_engine_to_input(registers, counter, table, in,
+                                             out, &stop);
+        output_flush(out);
+        stop_failed(stop, table, *counter, out);
+        *halted = stop != ENGINE_INPUT;
+        if (*halted) {
+                fprintf(stderr, "um: halted before any input; no snapshot "
+                        "written to %s\n", path);
+        } else {
+                snapshot_write(path, registers, *counter, table);
+        }
+        return count;
+}
+
+/********** run_recorded ********
+ *
+ * Function that runs the program on the fast interpreter core until it
+ * halts, recording every byte its input instructions read and its output
+ * instructions write in a trace
+ *
+ * Parameters:
+ *      const char *path:     the trace file to write
+ *      the parameters of run_engine
+ *
+ * Return: the number of instructions executed
+ *
+ * Notes:
+ *     the core stops before every input and output, and this does each one
+ *     itself, so the rest of the program runs at full speed
+ ************************/
+static uint64_t run_recorded(const char *path, uint32_t *registers,
+                             uint32_t *counter, struct segment_table *table,
+                             struct input *in, struct output *out)
+{
+        struct trace trace;
+        trace_create(&trace, path, table);
+        uint64_t count = 0;
+        for (;;) {
+                enum engine_stop stop;
+                count += run_engine_to_io(registers, counter, table, in, out,
+                                          &stop);
+                if (stop != ENGINE_INPUT && stop != ENGINE_OUTPUT) {
+                        stop_failed(stop, table, *counter, out);
+                        break; /* halted */
+                }
+                uint32_t *value = &registers[table->program[*counter].rc];
+                if (stop == ENGINE_INPUT) {
+                        if (in->next == in->end) { /* about to wait */
+                                output_flush(out);
+                        }
+                        *value = input_byte(in);
+                        trace_input(&trace, count, *value);
+                } else if (*value <= 255) {
+                        output_byte(out, *value);
+                        trace_output(&trace, count, *value);
+                }
+                (*counter)++;
+                count++;
+        }
+        trace_close(&trace, count);
+        return count;
+}
+
+/********** run_with_budget ********
+ *
+ * Function that runs the program on the fast interpreter core until it
+ * halts or runs out of its budget of instructions or time, and reports
+ * how far it got if it did not halt
+ *
+ * Parameters:
+ *      the parameters of run_engine, and
+ *      const struct engine_budget *budget: the budget
+ *      uint64_t start_ns:    when the UM started, in the time of
+ *                            profile_now()
+ *      bool *stopped:        set to whether the budget stopped it
+ *
+ * Return: the number of instructions executed
+ *
  * Notes:
- *      funciton is only used internally, so assumes input is valid
+ *     output is flushed before the report, so the program's output so far
+ *     is all there
+ ************************/
+static uint64_t run_with_budget(uint32_t *registers, uint32_t *counter,
+                                struct segment_table *table,
+                                struct input *in, struct output *out,
+                                const struct engine_budget *budget,
+                                uint64_t start_ns, bool *stopped)
+{
+        enum engine_stop stop;
+        uint64_t count = run_engine_budgeted(registers, counter, table, in,
+                                             out, budget, &stop);
+        *stopped = stop != ENGINE_HALT;
+        if (*stopped) {
+                output_flush(out);
+                fprintf(stderr, "um: %s: stopped after %.3f s and %llu "
+                        "instructions, at %u in segment 0\n",
+                        stop == ENGINE_TIMEOUT ? "--timeout" :
+                        "--max-instructions",
+                        (profile_now() - start_ns) / 1e9,
+                        (unsigned long long)count, *counter);
+        }
+        return count;
+}
+
+/********** main ********
+ *
+ * Loads the .um file named on the command line into segment 0 and runs it.
+ *
+ * Usage: um [options] [filename]
+ *
+ *      --reference           run on the reference engine (execute_instruction
+ *                            in instructions.c) instead of the fast
+ *                            interpreter core in engine.c
+ *      --jit                 run on the tiered engine in jit.c, which
+ *                            compiles hot blocks of segment 0 to x86-64
+ *                            machine code
+ *      --jit-check           same as --jit, but every run of a compiled
+ *                            block without side effects is also replayed
+ *                            on the reference engine, and the UM fails if
+ *                            the two disagree
+ *      --stats               at exit, print key=value statistics to stderr:
+ *                            the time to first instruction (loading and
+ *                            decoding segment 0), the run time, the
+ *                            number of instructions executed, the peak
+ *                            resident set size, and the input, output,
+ *                            segment pool, superinstruction and JIT
+ *                            counters
+ *      --profile FILE        run on the profiling build of the fast
+ *                            interpreter core, and at halt write a JSON
+ *                            report to FILE (or stderr, if FILE is -):
+ *                            instruction counts by opcode, the time spent
+ *                            in map, unmap, output, input and load
+ *                            program, the hottest load program
+ *                            instructions and the hottest ranges of
+ *                            segment 0. Cannot be combined with
+ *                            --reference or --jit.
+ *      --sample FILE         sample the fast interpreter core every
+ *                            --sample-period microseconds it runs, and at
+ *                            halt write the samples to FILE (or stderr, if
+ *                            FILE is -) as folded stacks, with the jumps
+ *                            that led to each sample as its stack, and
+ *                            print the hottest instructions and blocks to
+ *                            stderr (sampler.h). Cannot be combined with
+ *                            --reference, --jit, --profile or --batch.
+ *      --sample-period US    the microseconds between samples, from 10
+ *                            (default 1000)
+ *      --batch LIST          run the program once for each input file
+ *                            named in LIST (one per line), in parallel.
+ *                            Each job's output goes to the input's name
+ *                            with .out added. Cannot be combined with
+ *                            --reference, --jit or --profile.
+ *      --threads N           run batch jobs on N threads (default, or 0:
+ *                            one per online CPU)
+ *      --output-dir DIR      put batch outputs in DIR instead of next to
+ *                            their inputs
+ *      --snapshot FILE       run on the fast interpreter core until the
+ *                            first input instruction, save the machine to
+ *                            FILE there, and carry on. Cannot be combined
+ *                            with --reference, --jit, --profile, --batch
+ *                            or --restore.
+ *      --restore FILE        start from the machine saved in the snapshot
+ *                            FILE, on any engine, instead of loading a .um
+ *                            file (so no filename is given)
+ *      --verify-snapshot     with --restore, also check the saved words
+ *                            against their checksum, reading all of them
+ *                            up front
+ *      --safe                give every segment guard pages, so that a
+ *                            load or store past its end, or to an unmapped
+ *                            segment, is reported and fails the UM instead
+ *                            of reaching other memory (guard.c). In-bounds
+ *                            accesses cost the same; mapping and unmapping
+ *                            cost a system call each. Cannot be combined
+ *                            with --batch or --restore.
+ *      --max-segment-words N fail the UM, reporting what it was doing, on a
+ *                            map or load program that would leave more
+ *                            than N words in segments at once (segment 0
+ *                            included); by default there is no cap
+ *      --max-segments N      likewise for more than N segments mapped at
+ *                            once, segment 0 included
+ *      --hugepages           map segments of 2MB or more, and a decoded
+ *                            segment 0 as large, from regions aligned to
+ *                            2MB and advise the kernel to back them with
+ *                            transparent huge pages, so random accesses to
+ *                            them miss the TLB less. Cannot be combined
+ *                            with --safe.
+ *      --record FILE         run on the fast interpreter core, writing
+ *                            every byte read by an input instruction and
+ *                            written by an output instruction, with the
+ *                            number of instructions run before it, to the
+ *                            trace FILE (trace.h). Cannot be combined with
+ *                            --reference, --jit, --profile, --batch,
+ *                            --snapshot or --replay.
+ *      --replay FILE         run the program, on any engine, with the
+ *                            input recorded in the trace FILE in place of
+ *                            stdin and its output checked against the
+ *                            recording in place of stdout; the UM fails,
+ *                            saying where, at the first difference in
+ *                            output, or if it reads or runs more or less
+ *                            than was recorded. Cannot be combined with
+ *                            --batch or --snapshot.
+ *      --max-instructions N  stop the program, flushing its output and
+ *                            reporting how far it got, at its first jump
+ *                            after it has run N instructions; the UM then
+ *                            fails. Cannot be combined with --reference,
+ *                            --jit, --profile, --batch, --snapshot or
+ *                            --record.
+ *      --timeout SECONDS     likewise at its first jump SECONDS seconds
+ *                            after the UM started (fractions allowed).
+ *                            The clock is read once every 2^20
+ *                            instructions, and not while the program
+ *                            waits for input.
+ *      --no-fuse             do not fuse common instruction idioms in
+ *                            segment 0 into superinstructions
+ *      --line-buffered       write output at every newline as well as when
+ *                            the output buffer fills, before waiting for
+ *                            input and at halt; this is the default when
+ *                            stdout is a terminal
+ *      --pool-cap BYTES      keep at most this many bytes of unmapped
+ *                            segments for reuse (default 64MB, 0 disables
+ *                            reuse)
+ *      --mmap-threshold WORDS give segments of at least this many words
+ *                            their own anonymous mapping, so their zero
+ *                            pages are only supplied as they are touched
+ *                            and go back to the kernel on unmap (default
+ *                            2^18 words, 0 disables)
+ *
+ * Return: 0 once the program halts, 1 if --max-instructions or --timeout
+ *         stopped it
+ *
+ * Expects
+ *      the file exists and holds a whole number of 32-bit instructions
  ************************/
 int main (int argc, char* argv[]) {
-        FILE *fp = NULL;
-        long int filesize;
-        
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        const char *path = NULL;
+        bool reference = false;
+        bool jit = false;
+        bool jit_check = false;
+        bool stats = false;
+        const char *profile_path = NULL;
+        const char *sample_path = NULL;
+        uint64_t sample_period = SAMPLE_DEFAULT_US;
+        const char *batch_list = NULL;
+        const char *snapshot_path = NULL;
+        const char *restore_path = NULL;
+        bool verify_snapshot = false;
+        const char *record_path = NULL;
+        const char *replay_path = NULL;
+        struct engine_budget budget = { UINT64_MAX, UINT64_MAX };
+        struct batch_options batch = { 0, NULL,
+                                       { 0, 0, false, false, 0, 0,
+                                         false } };
+        bool line_buffered = isatty(STDOUT_FILENO);
+        struct memory_options options = { POOL_DEFAULT_CAP,
+                                          POOL_DEFAULT_MMAP_THRESHOLD, true,
+                                          false, 0, 0, false };
+
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "--reference") == 0) {
+                        reference = true;
+                } else if (strcmp(argv[i], "--jit") == 0) {
+                        jit = true;
+                } else if (strcmp(argv[i], "--jit-check") == 0) {
+                        jit = true;
+                        jit_check = true;
+                } else if (strcmp(argv[i], "--stats") == 0) {
+                        stats = true;
+                } else if (strcmp(argv[i], "--profile") == 0) {
+                        profile_path = argv[++i];
+                        if (profile_path == NULL) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "--sample") == 0) {
+                        sample_path = argv[++i];
+                        if (sample_path == NULL) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "--sample-period") == 0) {
+                        sample_period = parse_number(argv[0], argv[++i]);
+                        if (sample_period < 10 || sample_period > 1000000) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "--batch") == 0) {
+                        batch_list = argv[++i];
+                        if (batch_list == NULL) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "--threads") == 0) {
+                        uint64_t threads = parse_number(argv[0], argv[++i]);
+                        if (threads > 4096) {
+                                usage(argv[0]);
+                        }
+                        batch.threads = threads;
+                } else if (strcmp(argv[i], "--output-dir") == 0) {
+                        batch.output_dir = argv[++i];
+                        if (batch.output_dir == NULL) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "--snapshot") == 0) {
+                        snapshot_path = argv[++i];
+                        if (snapshot_path == NULL) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "--restore") == 0) {
+                        restore_path = argv[++i];
+                        if (restore_path == NULL) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "--verify-snapshot") == 0) {
+                        verify_snapshot = true;
+                } else if (strcmp(argv[i], "--safe") == 0) {
+                        options.safe = true;
+                } else if (strcmp(argv[i], "--max-segment-words") == 0) {
+                        options.max_words = parse_number(argv[0], argv[++i]);
+                } else if (strcmp(argv[i], "--max-segments") == 0) {
+                        uint64_t segments = parse_number(argv[0], argv[++i]);
+                        if (segments > UINT32_MAX) {
+                                usage(argv[0]);
+                        }
+                        options.max_segments = segments;
+                } else if (strcmp(argv[i], "--hugepages") == 0) {
+                        options.hugepages = true;
+                } else if (strcmp(argv[i], "--record") == 0) {
+                        record_path = argv[++i];
+                        if (record_path == NULL) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "--replay") == 0) {
+                        replay_path = argv[++i];
+                        if (replay_path == NULL) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "--max-instructions") == 0) {
+                        budget.instructions = parse_number(argv[0],
+                                                           argv[++i]);
+                } else if (strcmp(argv[i], "--timeout") == 0) {
+                        budget.deadline_ns = parse_seconds(argv[0],
+                                                           argv[++i]);
+                } else if (strcmp(argv[i], "--no-fuse") == 0) {
+                        options.fuse = false;
+                } else if (strcmp(argv[i], "--line-buffered") == 0) {
+                        line_buffered = true;
+                } else if (strcmp(argv[i], "--pool-cap") == 0) {
+                        options.pool_cap = parse_number(argv[0], argv[++i]);
+                } else if (strcmp(argv[i], "--mmap-threshold") == 0) {
+                        uint64_t words = parse_number(argv[0], argv[++i]);
+                        if (words > UINT32_MAX) {
+                                usage(argv[0]);
+                        }
+                        options.mmap_threshold = words;
+                } else if (path == NULL && argv[i][0] != '-') {
+                        path = argv[i];
+                } else {
+                        usage(argv[0]);
+                }
+        }
+
+        uint64_t start_ns = (uint64_t)start.tv_sec * 1000000000 +
+                            start.tv_nsec;
+        bool budgeted = budget.instructions != UINT64_MAX ||
+                        budget.deadline_ns != UINT64_MAX;
+        if (budget.deadline_ns != UINT64_MAX) { /* it held the timeout */
+                budget.deadline_ns += start_ns;
+        }
+
         /* invalid input */
-        if (argc != 2) {
-                fprintf(stderr, "usage: %s [filename]\n", argv[0]);
-                exit(1);
-        }
-
-        /* open file */
-        fp = fopen(argv[1], "r");
-        assert(fp != NULL);
-       
-        /* get file size */
-        fseek(fp, 0L, SEEK_END);  
-        filesize = ftell(fp); 
-        assert((filesize % 4) == 0); /* make sure that file is properly 
-                                        formatted */
-        int arrsize = filesize / 4; /* number of instructions */
-        fseek(fp, 0L, SEEK_SET);
-      
-        /* Hanson sequence used to "coatcheck" segments in memory */
-        Seq_T ids = make_sequence(); 
-        /* Hanson stack used to track unmapped segments */
-        Stack_T unmapped = make_stack(); 
-        initialize_zero(fp, arrsize, &ids); /* initialize 0th segment */
+        if ((path == NULL) == (restore_path == NULL) ||
+            (profile_path != NULL && (reference || jit)) ||
+            (sample_path != NULL && (reference || jit ||
+                                     profile_path != NULL ||
+                                     batch_list != NULL)) ||
+            (batch_list != NULL && (reference || jit ||
+                                    profile_path != NULL ||
+                                    restore_path != NULL)) ||
+            (snapshot_path != NULL && (reference || jit ||
+                                       profile_path != NULL ||
+                                       batch_list != NULL ||
+                                       restore_path != NULL)) ||
+            (record_path != NULL && (reference || jit ||
+                                     profile_path != NULL ||
+                                     batch_list != NULL ||
+                                     snapshot_path != NULL ||
+                                     replay_path != NULL)) ||
+            (replay_path != NULL && (batch_list != NULL ||
+                                     snapshot_path != NULL)) ||
+            (budgeted && (reference || jit || profile_path != NULL ||
+                          batch_list != NULL || snapshot_path != NULL ||
+                          record_path != NULL)) ||
+            (verify_snapshot && restore_path == NULL) ||
+            (options.safe && (batch_list != NULL || restore_path != NULL ||
+                              options.hugepages))) {
+                usage(argv[0]);
+        }
+        if (batch_list != NULL) {
+                flight_install(NULL);
+                batch.memory = options;
+                run_batch_command(path, batch_list, &batch, stats, &start);
+                return 0;
+        }
 
         uint32_t registers[8] ={ 0 , 0, 0, 0, 0, 0, 0, 0}; /* initialize 
                                                             registers */
-       
         uint32_t counter = 0;
-        struct segment *seg = Seq_get(ids, 0);
-        int length =  seg->size;
-        assert(length == arrsize);
-       
-        /* iterate through segment 0, executing instructions */
-        while (counter < (uint32_t)length) { 
-                struct segment *seg = Seq_get(ids, 0);
-                uint32_t word = seg->address[counter];
-                uint32_t opcode = get_opcode(word);
-              
-                if (opcode == 7) {  /* halt instruction */   
-                        break; 
-                } else {
-                        execute_instruction(opcode, word, registers, ids, 
-                                            unmapped, &counter);  
-                } 
-                if (opcode == 12 ) { /* load program instruction */
-                        struct segment *new_seg = Seq_get(ids, 0);
-                        length = new_seg->size;
+
+        /* segment table used to "coatcheck" segments in memory */
+        struct segment_table *table;
+        if (restore_path != NULL) {
+                table = snapshot_restore(restore_path, &options,
+                                         verify_snapshot, registers,
+                                         &counter);
+        } else {
+                table = make_table(&options);
+
+                /* read the file */
+                uint32_t arrsize; /* number of instructions */
+                uint32_t *words = read_image(path, &arrsize, &table->pool);
+                initialize_zero(words, arrsize, table); /* initialize 0th
+                                                           segment */
+        }
+
+        struct output *out = malloc(sizeof(struct output));
+        assert(out != NULL);
+        struct input *in = malloc(sizeof(struct input));
+        assert(in != NULL);
+        struct replay replay;
+        if (replay_path != NULL) {
+                replay_load(&replay, replay_path, table);
+                output_init_callback(out, replay_write, &replay, false);
+                input_init_callback(in, replay_read, &replay);
+        } else {
+                output_init(out, STDOUT_FILENO, line_buffered);
+                input_init(in, STDIN_FILENO);
+        }
+        flight_install(out);
+        if (options.safe) {
+                guard_install(table, out);
+        }
+
+        uint64_t startup_ns = elapsed_ns(&start);
+        uint64_t count;
+        struct jit_stats jit_stats;
+        struct profile profile;
+        bool stopped = false;
+        struct sampler sampler;
+        if (sample_path != NULL) {
+                sampler_start(&sampler, sample_period);
+        }
+
+        if (profile_path != NULL) {
+                profile_init(&profile);
+                count = run_engine_profiled(registers, &counter, table, in,
+                                            out, &profile);
+        } else if (reference) {
+                count = run_reference(registers, &counter, table, in, out);
+        } else if (jit) {
+                count = run_jit(registers, &counter, table, in, out,
+                                jit_check, &jit_stats);
+        } else if (record_path != NULL) {
+                count = run_recorded(record_path, registers, &counter, table,
+                                     in, out);
+        } else if (budgeted) {
+                count = run_with_budget(registers, &counter, table, in, out,
+                                        &budget, start_ns, &stopped);
+        } else {
+                bool halted = false;
+                count = 0;
+                if (snapshot_path != NULL) {
+                        count = run_to_snapshot(snapshot_path, registers,
+                                                &counter, table, in, out,
+                                                &halted);
                 }
-        }  
-        free_all(ids, unmapped);
-        fclose(fp);
+                if (!halted) {
+                        count += run_engine(registers, &counter, table, in,
+                                            out);
+                }
+        }
+        if (sample_path != NULL) {
+                sampler_stop(&sampler);
+        }
+        output_flush(out);
+        uint64_t run_ns = elapsed_ns(&start) - startup_ns;
+        if (replay_path != NULL && !stopped) {
+                replay_finish(&replay, count, in->bytes);
+        }
+
+        if (profile_path != NULL) {
+                profile_write(&profile, profile_path, count, run_ns);
+                profile_free(&profile);
+        }
+        if (sample_path != NULL) {
+                sampler_write(&sampler, sample_path);
+                sampler_free(&sampler);
+        }
+        if (stats) {
+                print_stats(table, in, out, jit ? &jit_stats : NULL,
+                            startup_ns, run_ns, count);
+        }
+        free_all(table);
+        input_close(in);
+        free(in);
+        free(out);
 
-        return 0;
+        return stopped ? EXIT_FAILURE : 0;
 }
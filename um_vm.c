@@ -0,0 +1,225 @@
+/*
+ *     um_vm.c
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: um_vm.c contains the implementation of libum, defined in
+ *     um_vm.h. A machine is the same registers, counter, segment table and
+ *     I/O buffers main() in um.c keeps on its stack, gathered into one
+ *     allocation; running it is run_engine_bounded() from engine.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "um_vm.h"
+#include "engine.h"
+#include "loader.h"
+
+struct um_vm {
+        uint32_t registers[8];
+        uint32_t counter;
+        struct segment_table *table;    /* NULL until a program is loaded */
+        struct memory_options options;
+        enum um_status status;
+        uint64_t instructions;          /* executed since the last load */
+        struct input in;
+        struct output out;
+};
+
+/********** no_input ********
+ *
+ * The input of a machine created without an input callback: it has ended
+ ************************/
+static size_t no_input(void *closure, uint8_t *buffer, size_t size)
+{
+        (void)closure;
+        (void)buffer;
+        (void)size;
+        return 0;
+}
+
+/********** no_output ********
+ *
+ * The output of a machine created without an output callback: it is
+ * thrown away
+ ************************/
+static void no_output(void *closure, const uint8_t *bytes, size_t count)
+{
+        (void)closure;
+        (void)bytes;
+        (void)count;
+}
+
+/********** um_vm_create ********
+ *
+ * Function that creates a machine with no program loaded
+ *
+ * Parameters:
+ *      const struct memory_options *options: settings for its segments, or
+ *                            NULL for the defaults of the um command
+ *                            (safe is ignored: see guard.h)
+ *      input_fn input:       where its input comes from, or NULL for none
+ *      output_fn output:     where its output goes, or NULL to discard it
+ *      void *closure:        passed to input and output
+ *
+ * Return: the machine, to be freed with um_vm_destroy()
+ *
+ * Notes:
+ *     output reaches the callback when the 64KB output buffer fills, when
+ *     the program is about to wait for input, and at the end of every
+ *     um_vm_run() or um_vm_step()
+ ************************/
+struct um_vm *um_vm_create(const struct memory_options *options,
+                           input_fn input, output_fn output, void *closure)
+{
+        struct um_vm *vm = malloc(sizeof(struct um_vm));
+        assert(vm != NULL);
+        memset(vm->registers, 0, sizeof(vm->registers));
+        vm->counter = 0;
+        vm->table = NULL;
+        if (options != NULL) {
+                vm->options = *options;
+                vm->options.safe = false; /* the handler is the um command's */
+        } else {
+                vm->options.pool_cap = POOL_DEFAULT_CAP;
+                vm->options.mmap_threshold = POOL_DEFAULT_MMAP_THRESHOLD;
+                vm->options.fuse = true;
+                vm->options.safe = false;
+                vm->options.max_words = 0;
+                vm->options.max_segments = 0;
+                vm->options.hugepages = false;
+        }
+        vm->status = UM_HALTED;
+        vm->instructions = 0;
+        input_init_callback(&vm->in, input != NULL ? input : no_input,
+                            closure);
+        output_init_callback(&vm->out, output != NULL ? output : no_output,
+                             closure, false);
+        return vm;
+}
+
+/********** um_vm_load ********
+ *
+ * Function that loads a program into a machine, replacing whatever it was
+ * running, and readies it to run from the first instruction with every
+ * register zero
+ *
+ * Parameters:
+ *      struct um_vm *vm:     the machine
+ *      const uint8_t *image: the contents of a .um file: big-endian words
+ *      size_t size:          the bytes in image
+ *
+ * Return: true, or false (leaving the machine as it was) if size is not a
+ *         whole number of words or the program is too large for a segment
+ *
+ * Notes:
+ *     image is copied; the caller may free it as soon as this returns.
+ *     Input and output buffered for the previous program are kept.
+ ************************/
+bool um_vm_load(struct um_vm *vm, const uint8_t *image, size_t size)
+{
+        assert(vm != NULL && (image != NULL || size == 0));
+        if (size % 4 != 0 || size / 4 > UINT32_MAX) {
+                return false;
+        }
+        if (vm->table != NULL) {
+                free_all(vm->table);
+        }
+        vm->table = make_table(&vm->options);
+        uint32_t length = size / 4;
+        uint32_t *words = pool_alloc(&vm->table->pool, length);
+        swap_words(words, image, length);
+        initialize_zero(words, length, vm->table);
+
+        memset(vm->registers, 0, sizeof(vm->registers));
+        vm->counter = 0;
+        vm->status = UM_RUNNING;
+        vm->instructions = 0;
+        return true;
+}
+
+/********** um_vm_run ********
+ *
+ * Function that runs a machine until its program halts, it reaches an
+ * invalid instruction or a map or load program over its segment caps, or
+ * it has executed limit more instructions
+ *
+ * Parameters:
+ *      struct um_vm *vm:     the machine, with a program loaded
+ *      uint64_t limit:       the most instructions to execute
+ *
+ * Return: UM_RUNNING if it stopped on the limit, otherwise UM_HALTED,
+ *         UM_INVALID or UM_OVER_CAP, which it then keeps returning without
+ *         running anything until another program is loaded
+ *
+ * Expects
+ *     a program has been loaded with um_vm_load()
+ ************************/
+enum um_status um_vm_run(struct um_vm *vm, uint64_t limit)
+{
+        assert(vm != NULL && vm->table != NULL);
+        if (vm->status != UM_RUNNING || limit == 0) {
+                return vm->status;
+        }
+        enum engine_stop stop;
+        vm->instructions += run_engine_bounded(vm->registers, &vm->counter,
+                                               vm->table, &vm->in, &vm->out,
+                                               limit, &stop);
+        output_flush(&vm->out);
+        if (stop == ENGINE_HALT) {
+                vm->status = UM_HALTED;
+        } else if (stop == ENGINE_INVALID) {
+                vm->status = UM_INVALID;
+        } else if (stop == ENGINE_CAP) {
+                vm->status = UM_OVER_CAP;
+        }
+        return vm->status;
+}
+
+/********** um_vm_step ********
+ *
+ * Same as um_vm_run() with a limit of one instruction
+ ************************/
+enum um_status um_vm_step(struct um_vm *vm)
+{
+        return um_vm_run(vm, 1);
+}
+
+/********** um_vm_instructions ********
+ *
+ * Returns how many instructions a machine has executed since its program
+ * was loaded
+ ************************/
+uint64_t um_vm_instructions(const struct um_vm *vm)
+{
+        assert(vm != NULL);
+        return vm->instructions;
+}
+
+/********** um_vm_destroy ********
+ *
+ * Function that frees a machine and all its segments
+ *
+ * Parameters:
+ *      struct um_vm *vm:     the machine, which may be NULL
+ *
+ * Return: void
+ *
+ * Notes:
+ *     output the program has not flushed yet is handed to the output
+ *     callback first
+ ************************/
+void um_vm_destroy(struct um_vm *vm)
+{
+        if (vm == NULL) {
+                return;
+        }
+        output_flush(&vm->out);
+        if (vm->table != NULL) {
+                free_all(vm->table);
+        }
+        input_close(&vm->in);
+        free(vm);
+}
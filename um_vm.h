@@ -0,0 +1,54 @@
+/*
+ *     um_vm.h
+ *     Sophie Zhou (szhou13), Angela Yan (yyan08)
+ *     11/19/2024
+ *     CS40 HW6
+ *
+ *     Purpose: um_vm.h defines libum, the UM as a library. A struct um_vm
+ *              holds everything one machine needs (registers, program
+ *              counter, segments and I/O buffers) and nothing is shared
+ *              between machines, so a program can host any number of them.
+ *              A machine is loaded from a .um image in memory, runs on the
+ *              fast interpreter core a given number of instructions at a
+ *              time (or one at a time), and does its I/O through callbacks
+ *              rather than stdin and stdout.
+ *
+ *              A program that divides by zero or uses a segment it has not
+ *              mapped still fails the whole process, as it does under the
+ *              um command; an invalid opcode, or a segment over the caps
+ *              the machine was created with, only stops its own machine.
+ */
+
+#ifndef UM_VM_INCLUDED
+#define UM_VM_INCLUDED
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "io.h"
+#include "memory.h"
+
+/* what a machine is doing after a call to um_vm_run() or um_vm_step() */
+enum um_status {
+        UM_RUNNING,             /* stopped on its limit; can run again */
+        UM_HALTED,              /* the program halted */
+        UM_INVALID,             /* stopped at an invalid instruction */
+        UM_OVER_CAP             /* stopped at a map or load program that
+                                   would go over the caps of its options */
+};
+
+struct um_vm;
+
+struct um_vm *um_vm_create(const struct memory_options *options,
+                           input_fn input, output_fn output, void *closure);
+
+bool um_vm_load(struct um_vm *vm, const uint8_t *image, size_t size);
+
+enum um_status um_vm_run(struct um_vm *vm, uint64_t limit);
+
+enum um_status um_vm_step(struct um_vm *vm);
+
+uint64_t um_vm_instructions(const struct um_vm *vm);
+
+void um_vm_destroy(struct um_vm *vm);
+
+#endif